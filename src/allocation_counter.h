@@ -0,0 +1,140 @@
+#pragma once
+
+// Per-thread heap allocation counter.
+//
+// Counts every malloc/calloc/realloc/aligned allocation made by the calling thread. operator new and the Eigen
+// aligned allocator behind pcl::PointCloud both end up in malloc, so the count covers C++ containers, clouds and
+// PCL internals alike. The counter interposes glibc's allocator entry points for the whole process (PCL, FLANN
+// and ROS included), so it is a diagnostic build only: it is compiled in when COUNT_HEAP_ALLOCATIONS is defined,
+// e.g. with target_compile_definitions(model_predicting PRIVATE COUNT_HEAP_ALLOCATIONS) for a profiling build,
+// and the interposing definitions then need this header in exactly one translation unit of the executable
+// (every node here is a single file). Without the define, or elsewhere than glibc, it only provides the interface,
+// the counts stay zero and the header can be included anywhere.
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+inline thread_local size_t thread_heap_allocations = 0;
+
+#if defined(__GLIBC__) && defined(COUNT_HEAP_ALLOCATIONS)
+#define ALLOCATION_COUNTER_ENABLED 1
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+
+void* malloc(size_t size) noexcept {
+    thread_heap_allocations++;
+    return __libc_malloc(size);
+}
+void* calloc(size_t count, size_t size) noexcept {
+    thread_heap_allocations++;
+    return __libc_calloc(count, size);
+}
+void* realloc(void* pointer, size_t size) noexcept {
+    thread_heap_allocations++;
+    return __libc_realloc(pointer, size);
+}
+void* memalign(size_t alignment, size_t size) noexcept {
+    thread_heap_allocations++;
+    return __libc_memalign(alignment, size);
+}
+void* aligned_alloc(size_t alignment, size_t size) noexcept {
+    thread_heap_allocations++;
+    return __libc_memalign(alignment, size);
+}
+int posix_memalign(void** pointer, size_t alignment, size_t size) noexcept {
+    // POSIX: a power of two and a multiple of sizeof(void*), or EINVAL with *pointer untouched
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0 || alignment % sizeof(void*) != 0) {
+        return EINVAL;
+    }
+    thread_heap_allocations++;
+    void* allocation = __libc_memalign(alignment, size);
+    if (allocation == nullptr) {
+        return ENOMEM;
+    }
+    *pointer = allocation;
+    return 0;
+}
+}
+#else
+#define ALLOCATION_COUNTER_ENABLED 0
+#endif
+
+// Allocations of the summing region below itself (libgomp allocates a fresh team for single-thread regions)
+inline thread_local size_t counter_overhead = 0;
+
+// Allocations made so far by the calling thread and the OpenMP worker threads it fans out to. The worker pool
+// is persistent, so summing the counters over a parallel region covers everything a frame ran in parallel.
+inline size_t teamHeapAllocations() {
+#if !ALLOCATION_COUNTER_ENABLED
+    return 0; // Nothing is counted, so no parallel region either
+#elif defined(_OPENMP)
+    const size_t before = thread_heap_allocations;
+    size_t sum = 0;
+    #pragma omp parallel reduction(+:sum)
+    {
+        #pragma omp master
+        counter_overhead += thread_heap_allocations - before;
+        sum += thread_heap_allocations;
+    }
+    return sum - counter_overhead;
+#else
+    return thread_heap_allocations;
+#endif
+}
+
+// Allocations of each stage of one frame, on the callback thread and its OpenMP workers
+struct FrameAllocations {
+    static const int MAX_STAGES = 8;
+    const char* stage_names[MAX_STAGES];
+    size_t stage_counts[MAX_STAGES];
+    int num_stages = 0;
+    size_t stage_start = 0;
+
+    void begin() {
+        num_stages = 0;
+        stage_start = teamHeapAllocations();
+    }
+
+    // Closes the stage that started at the previous begin()/endStage(). Stages with the same name add up.
+    void endStage(const char* name) {
+        const size_t now = teamHeapAllocations();
+        int stage = 0;
+        while (stage < num_stages && std::strcmp(stage_names[stage], name) != 0) {
+            ++stage;
+        }
+        if (stage == num_stages && num_stages < MAX_STAGES) {
+            stage_names[num_stages] = name;
+            stage_counts[num_stages] = 0;
+            num_stages++;
+        }
+        if (stage < num_stages) {
+            stage_counts[stage] += now - stage_start;
+        }
+        stage_start = now;
+    }
+
+    size_t total() const {
+        size_t sum = 0;
+        for (int i = 0; i < num_stages; ++i) {
+            sum += stage_counts[i];
+        }
+        return sum;
+    }
+
+    // "stage a, stage b, ..., total" into a caller buffer, so formatting the report does not allocate either
+    void format(char* buffer, size_t size) const {
+        size_t used = 0;
+        for (int i = 0; i < num_stages && used < size; ++i) {
+            used += std::snprintf(buffer + used, size - used, "%s %zu, ", stage_names[i], stage_counts[i]);
+        }
+        if (used < size) {
+            std::snprintf(buffer + used, size - used, "total %zu", total());
+        }
+    }
+};
@@ -344,42 +344,20 @@ void EuclideanClusteringAndDownsampleClusters(
     }
 }
 
+// Covariances of the minPoints-neighbourhoods, kept across frames and solved in one batch (plane_batch.h)
+NormalBatchWorkspace adaptive_normal_batch;
+
 void estimateNormalsAdaptivePCA(
     pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud,
     pcl::PointCloud<pcl::Normal>::Ptr& normals,
     int minPoints = 20) // Minimum number of points for stable estimation
 {
     pcl::search::KdTree<pcl::PointXYZ>::Ptr tree(new pcl::search::KdTree<pcl::PointXYZ>());
-    normals->resize(cloud->size());
-
-    for (size_t i = 0; i < cloud->size(); ++i) {
-        std::vector<int> indices;
-        std::vector<float> sqrDistances;
-        
-        // Dynamically adjust the search radius based on local point density
-        tree->nearestKSearch(cloud->points[i], minPoints, indices, sqrDistances);
-        
-        // Extract the neighborhood
-        pcl::PointCloud<pcl::PointXYZ>::Ptr neighborhood(new pcl::PointCloud<pcl::PointXYZ>);
-        for (int idx : indices) {
-            neighborhood->points.push_back(cloud->points[idx]);
-        }
-
-        // Apply PCA on the neighborhood
-        pcl::PCA<pcl::PointXYZ> pca;
-        pca.setInputCloud(neighborhood);
-        Eigen::Vector3f normal = pca.getEigenVectors().col(2); // The smallest eigenvector
-
-        // Ensure normal is outward by comparing with vector towards sensor origin
-        Eigen::Vector4f point = (*cloud)[i].getVector4fMap();
-        if (normal.dot(point.head<3>()) > 0) {
-            normal = -normal;
-        }
+    tree->setInputCloud(cloud);
 
-        normals->points[i].normal_x = normal(0);
-        normals->points[i].normal_y = normal(1);
-        normals->points[i].normal_z = normal(2);
-    }
+    // Smallest eigenvector of every neighbourhood's covariance, oriented towards the sensor origin: what a
+    // pcl::PCA per point gave, without copying each neighbourhood into its own cloud
+    estimateNormalsBatch(*cloud, *tree, minPoints, 0.0, adaptive_normal_batch, *normals);
 }
 
 
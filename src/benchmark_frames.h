@@ -0,0 +1,45 @@
+#pragma once
+
+// Frame loading and timing shared by the *_benchmark tools.
+//
+// Every benchmark takes recorded frames as PCD files on its command line (BENCHMARKS.md describes how to export
+// them from a bag), skips the ones it cannot read and times each kernel as the mean over a number of repetitions.
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/io/pcd_io.h>
+
+#include <chrono>
+#include <iostream>
+
+// Reads one frame; an unreadable file is reported and the caller skips it
+inline bool loadFrame(const char* path, pcl::PointCloud<pcl::PointXYZ>& cloud) {
+    if (pcl::io::loadPCDFile<pcl::PointXYZ>(path, cloud) == -1) {
+        std::cerr << "Skipping " << path << ": cannot read PCD file" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// False, with the error the benchmarks exit on, when none of the frames could be used
+inline bool anyFramesRead(int frames) {
+    if (frames == 0) {
+        std::cerr << "No frames could be read." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+inline double secondsSince(const std::chrono::steady_clock::time_point& start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Mean seconds per call of kernel() over repetitions calls
+template <typename Kernel>
+double secondsPerCall(int repetitions, Kernel&& kernel) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repetitions; ++r) {
+        kernel();
+    }
+    return secondsSince(start) / repetitions;
+}
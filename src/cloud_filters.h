@@ -0,0 +1,446 @@
+#pragma once
+
+// Fused crop box + voxel grid downsampling.
+//
+// The nodes used to run three pcl::PassThrough passes (z, x, y) and then pcl::VoxelGrid, which copies the cloud
+// three times and walks it four times. cropVoxelDownsample reads every input point once: the crop test is one
+// 4-wide SIMD compare per point (SSE on x86, NEON on the Jetson) and only the survivors are written, as SoA
+// coordinates. The voxel step then follows pcl::VoxelGrid exactly (same grid origin, same index sort, same float
+// centroid sums) over the survivors, so the output is bit-identical to the PassThrough x3 + VoxelGrid chain.
+// The voxel step also takes survivors read straight from a PointCloud2 message (see cloud_ingest.h).
+// parallelVoxelGridDownsample is the multi-threaded variant (same voxels, centroids equal up to summation order).
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Survivor coordinates in structure-of-arrays form. The vectors keep their capacity across frames.
+struct CloudSoA {
+    std::vector<float> x, y, z;
+    std::vector<float> intensity; // Only filled when the source has an intensity field
+    bool has_intensity = false;
+
+    size_t size() const { return x.size(); }
+
+    void clear() {
+        x.clear();
+        y.clear();
+        z.clear();
+        intensity.clear();
+        has_intensity = false;
+    }
+
+    void reserve(size_t num_points) {
+        x.reserve(num_points);
+        y.reserve(num_points);
+        z.reserve(num_points);
+        intensity.reserve(num_points);
+    }
+
+    void push_back(float point_x, float point_y, float point_z) {
+        x.push_back(point_x);
+        y.push_back(point_y);
+        z.push_back(point_z);
+    }
+};
+
+struct CropBox {
+    float min_x, max_x;
+    float min_y, max_y;
+    float min_z, max_z;
+};
+
+// Same test as the PassThrough chain: min <= v <= max on all three axes. NaN coordinates fail every compare.
+inline bool insideCropBox(const pcl::PointXYZ& point, const CropBox& box) {
+    return point.x >= box.min_x && point.x <= box.max_x &&
+           point.y >= box.min_y && point.y <= box.max_y &&
+           point.z >= box.min_z && point.z <= box.max_z;
+}
+
+// Copies the points inside the box, in input order, into the SoA buffers
+inline void cropToSoA(const pcl::PointCloud<pcl::PointXYZ>& input, const CropBox& box, CloudSoA& survivors) {
+    const size_t num_points = input.points.size();
+    survivors.clear();
+    survivors.reserve(num_points);
+
+#if defined(__SSE2__)
+    const __m128 box_min = _mm_setr_ps(box.min_x, box.min_y, box.min_z, 0.0f);
+    const __m128 box_max = _mm_setr_ps(box.max_x, box.max_y, box.max_z, 0.0f);
+    for (size_t i = 0; i < num_points; ++i) {
+        const __m128 point = _mm_loadu_ps(input.points[i].data); // x, y, z, padding
+        const __m128 inside = _mm_and_ps(_mm_cmpge_ps(point, box_min), _mm_cmple_ps(point, box_max));
+        if ((_mm_movemask_ps(inside) & 0x7) == 0x7) {
+            survivors.push_back(input.points[i].x, input.points[i].y, input.points[i].z);
+        }
+    }
+#elif defined(__ARM_NEON)
+    const float box_min_values[4] = {box.min_x, box.min_y, box.min_z, 0.0f};
+    const float box_max_values[4] = {box.max_x, box.max_y, box.max_z, 0.0f};
+    const float32x4_t box_min = vld1q_f32(box_min_values);
+    const float32x4_t box_max = vld1q_f32(box_max_values);
+    for (size_t i = 0; i < num_points; ++i) {
+        const float32x4_t point = vld1q_f32(input.points[i].data); // x, y, z, padding
+        const uint32x4_t inside = vandq_u32(vcgeq_f32(point, box_min), vcleq_f32(point, box_max));
+        if (vgetq_lane_u32(inside, 0) & vgetq_lane_u32(inside, 1) & vgetq_lane_u32(inside, 2)) {
+            survivors.push_back(input.points[i].x, input.points[i].y, input.points[i].z);
+        }
+    }
+#else
+    for (size_t i = 0; i < num_points; ++i) {
+        const pcl::PointXYZ& point = input.points[i];
+        if (insideCropBox(point, box)) {
+            survivors.push_back(point.x, point.y, point.z);
+        }
+    }
+#endif
+}
+
+// Copies the finite points of a cloud into the SoA buffers (pcl::VoxelGrid skips the others too)
+inline void cloudToSoA(const pcl::PointCloud<pcl::PointXYZ>& input, CloudSoA& points) {
+    points.clear();
+    points.reserve(input.points.size());
+    for (const pcl::PointXYZ& point : input.points) {
+        if (std::isfinite(point.x) && std::isfinite(point.y) && std::isfinite(point.z)) {
+            points.push_back(point.x, point.y, point.z);
+        }
+    }
+}
+
+// Grid geometry of pcl::VoxelGrid for one cloud: origin in voxel units and the multipliers of the linear voxel index
+struct VoxelGridLayout {
+    float inverse_x, inverse_y, inverse_z;
+    int min_b_x, min_b_y, min_b_z;
+    int divb_mul_y, divb_mul_z;
+};
+
+// Computes the grid of a non-empty cloud. Returns false when the voxel indices would overflow, in which case
+// pcl::VoxelGrid returns its input unchanged.
+inline bool voxelGridLayout(const CloudSoA& cloud, float leaf_x, float leaf_y, float leaf_z, VoxelGridLayout& layout) {
+    layout.inverse_x = 1.0f / leaf_x;
+    layout.inverse_y = 1.0f / leaf_y;
+    layout.inverse_z = 1.0f / leaf_z;
+
+    const size_t num_points = cloud.size();
+    float min_x = cloud.x[0], max_x = cloud.x[0];
+    float min_y = cloud.y[0], max_y = cloud.y[0];
+    float min_z = cloud.z[0], max_z = cloud.z[0];
+    // Cropped clouds stay out of the parallel region altogether: even a serialized (if-false) region allocates
+    // a thread team in libgomp on every entry
+    if (num_points > 20000) {
+        #pragma omp parallel for reduction(min:min_x, min_y, min_z) reduction(max:max_x, max_y, max_z)
+        for (size_t i = 1; i < num_points; ++i) {
+            min_x = std::min(min_x, cloud.x[i]); max_x = std::max(max_x, cloud.x[i]);
+            min_y = std::min(min_y, cloud.y[i]); max_y = std::max(max_y, cloud.y[i]);
+            min_z = std::min(min_z, cloud.z[i]); max_z = std::max(max_z, cloud.z[i]);
+        }
+    } else {
+        for (size_t i = 1; i < num_points; ++i) {
+            min_x = std::min(min_x, cloud.x[i]); max_x = std::max(max_x, cloud.x[i]);
+            min_y = std::min(min_y, cloud.y[i]); max_y = std::max(max_y, cloud.y[i]);
+            min_z = std::min(min_z, cloud.z[i]); max_z = std::max(max_z, cloud.z[i]);
+        }
+    }
+
+    const int64_t dx = static_cast<int64_t>((max_x - min_x) * layout.inverse_x) + 1;
+    const int64_t dy = static_cast<int64_t>((max_y - min_y) * layout.inverse_y) + 1;
+    const int64_t dz = static_cast<int64_t>((max_z - min_z) * layout.inverse_z) + 1;
+    if (dx * dy * dz > static_cast<int64_t>(std::numeric_limits<int32_t>::max())) {
+        return false;
+    }
+
+    layout.min_b_x = static_cast<int>(std::floor(min_x * layout.inverse_x));
+    layout.min_b_y = static_cast<int>(std::floor(min_y * layout.inverse_y));
+    layout.min_b_z = static_cast<int>(std::floor(min_z * layout.inverse_z));
+    const int max_b_x = static_cast<int>(std::floor(max_x * layout.inverse_x));
+    const int max_b_y = static_cast<int>(std::floor(max_y * layout.inverse_y));
+    const int div_b_x = max_b_x - layout.min_b_x + 1;
+    const int div_b_y = max_b_y - layout.min_b_y + 1;
+    layout.divb_mul_y = div_b_x;
+    layout.divb_mul_z = div_b_x * div_b_y;
+    return true;
+}
+
+// Linear voxel index of a point, computed with the same float operations as pcl::VoxelGrid
+inline unsigned int voxelIndex(const VoxelGridLayout& layout, float x, float y, float z) {
+    const int ijk_x = static_cast<int>(std::floor(x * layout.inverse_x) - static_cast<float>(layout.min_b_x));
+    const int ijk_y = static_cast<int>(std::floor(y * layout.inverse_y) - static_cast<float>(layout.min_b_y));
+    const int ijk_z = static_cast<int>(std::floor(z * layout.inverse_z) - static_cast<float>(layout.min_b_z));
+    return static_cast<unsigned int>(ijk_x + ijk_y * layout.divb_mul_y + ijk_z * layout.divb_mul_z);
+}
+
+inline void copyCloudSoA(const CloudSoA& cloud, pcl::PointCloud<pcl::PointXYZ>& output) {
+    output.points.reserve(cloud.size());
+    for (size_t i = 0; i < cloud.size(); ++i) {
+        output.points.push_back(pcl::PointXYZ(cloud.x[i], cloud.y[i], cloud.z[i]));
+    }
+    output.width = static_cast<uint32_t>(cloud.size());
+}
+
+// Scratch buffer of voxelGridDownsample. Nodes keep one across frames so the sort buffer is not reallocated.
+// After a call it also describes the grid of the last output: output point k is the k-th run of equal voxel
+// indices in index_vector (plane_smoothing.h builds on that).
+struct VoxelGridWorkspace {
+    std::vector<std::pair<unsigned int, unsigned int>> index_vector;
+    VoxelGridLayout layout;
+    bool has_layout = false; // False when the last call returned its input unchanged (empty or overflowing grid)
+};
+
+// pcl::VoxelGrid over already cropped points. The output header is left to the caller.
+inline void voxelGridDownsample(const CloudSoA& cloud, float leaf_x, float leaf_y, float leaf_z, pcl::PointCloud<pcl::PointXYZ>& output,
+                                VoxelGridWorkspace& workspace) {
+    output.points.clear();
+    output.height = 1;
+    output.is_dense = true;
+    workspace.has_layout = false;
+    const size_t num_points = cloud.size();
+    if (num_points == 0) {
+        output.width = 0;
+        return;
+    }
+
+    VoxelGridLayout& layout = workspace.layout;
+    if (!voxelGridLayout(cloud, leaf_x, leaf_y, leaf_z, layout)) {
+        copyCloudSoA(cloud, output);
+        return;
+    }
+    workspace.has_layout = true;
+
+    // (voxel index, point index) pairs, sorted on the voxel index only. pcl::VoxelGrid sorts the same pairs in
+    // the same order with the same comparison, so points are summed into each centroid in the same sequence.
+    std::vector<std::pair<unsigned int, unsigned int>>& index_vector = workspace.index_vector;
+    index_vector.resize(num_points);
+    for (size_t i = 0; i < num_points; ++i) {
+        index_vector[i] = std::make_pair(voxelIndex(layout, cloud.x[i], cloud.y[i], cloud.z[i]), static_cast<unsigned int>(i));
+    }
+    std::sort(index_vector.begin(), index_vector.end(),
+              [](const std::pair<unsigned int, unsigned int>& a, const std::pair<unsigned int, unsigned int>& b) {
+                  return a.first < b.first;
+              });
+
+    // One centroid per run of equal voxel indices
+    size_t begin = 0;
+    while (begin < num_points) {
+        size_t end = begin + 1;
+        while (end < num_points && index_vector[end].first == index_vector[begin].first) {
+            ++end;
+        }
+
+        float sum_x = 0.0f, sum_y = 0.0f, sum_z = 0.0f;
+        for (size_t j = begin; j < end; ++j) {
+            const unsigned int point = index_vector[j].second;
+            sum_x += cloud.x[point];
+            sum_y += cloud.y[point];
+            sum_z += cloud.z[point];
+        }
+        const float count = static_cast<float>(end - begin);
+        output.points.push_back(pcl::PointXYZ(sum_x / count, sum_y / count, sum_z / count));
+
+        begin = end;
+    }
+
+    output.width = static_cast<uint32_t>(output.points.size());
+}
+
+inline void voxelGridDownsample(const CloudSoA& cloud, float leaf_x, float leaf_y, float leaf_z, pcl::PointCloud<pcl::PointXYZ>& output) {
+    VoxelGridWorkspace workspace;
+    voxelGridDownsample(cloud, leaf_x, leaf_y, leaf_z, output, workspace);
+}
+
+// Open-addressing hash map from voxel index to a dense slot number, for thread-local grouping.
+// Voxel indices are below INT32_MAX (see voxelGridLayout), so UINT32_MAX marks an empty bucket.
+struct VoxelHashMap {
+    std::vector<unsigned int> bucket_keys;
+    std::vector<unsigned int> bucket_slots;
+    unsigned int mask = 0;
+
+    void reset(size_t expected_keys) {
+        size_t capacity = 16;
+        while (capacity < 2 * expected_keys) {
+            capacity *= 2;
+        }
+        bucket_keys.assign(capacity, std::numeric_limits<unsigned int>::max());
+        bucket_slots.resize(capacity);
+        mask = static_cast<unsigned int>(capacity - 1);
+    }
+
+    // Slot of the key; a new key gets next_slot, and inserted is set
+    unsigned int findOrInsert(unsigned int key, unsigned int next_slot, bool& inserted) {
+        unsigned int bucket = (key * 2654435761u) & mask; // Knuth multiplicative hash
+        while (true) {
+            if (bucket_keys[bucket] == key) {
+                inserted = false;
+                return bucket_slots[bucket];
+            }
+            if (bucket_keys[bucket] == std::numeric_limits<unsigned int>::max()) {
+                bucket_keys[bucket] = key;
+                bucket_slots[bucket] = next_slot;
+                inserted = true;
+                return next_slot;
+            }
+            bucket = (bucket + 1) & mask;
+        }
+    }
+};
+
+// Parallel voxel grid. Each thread takes a contiguous slice of the points and groups it in a thread-local sparse
+// hash map (voxel index -> slot, see VoxelHashMap). The maps are merged into one voxel list in ascending voxel index, which is the
+// pcl::VoxelGrid output order, and every voxel then lists its points in input order (thread 0's slice first), so
+// the centroids are summed in the same sequence whatever the thread count. The voxels, their order and their
+// point counts match voxelGridDownsample exactly. The centroids can differ from it in the last bit or two:
+// pcl::VoxelGrid sums each voxel in the order its unstable std::sort happens to leave the points in, and that
+// order cannot be reproduced without running the same sequential sort.
+inline void parallelVoxelGridDownsample(const CloudSoA& cloud, float leaf_x, float leaf_y, float leaf_z, pcl::PointCloud<pcl::PointXYZ>& output) {
+    output.points.clear();
+    output.height = 1;
+    output.is_dense = true;
+    const size_t num_points = cloud.size();
+    if (num_points == 0) {
+        output.width = 0;
+        return;
+    }
+
+    VoxelGridLayout layout;
+    if (!voxelGridLayout(cloud, leaf_x, leaf_y, leaf_z, layout)) {
+        copyCloudSoA(cloud, output);
+        return;
+    }
+
+    std::vector<unsigned int> point_slot(num_points);             // Slot of each point in its thread's map
+    std::vector<std::vector<unsigned int>> slot_keys, slot_counts; // Per thread: voxel index and point count of each slot
+    std::vector<std::vector<unsigned int>> slot_offsets;           // Per thread: where each slot's points go in voxel_points
+    std::vector<std::vector<unsigned int>> slot_order;             // Per thread: slots sorted by voxel index
+    std::vector<unsigned int> voxel_keys, voxel_starts;            // Merged voxels and the start of their points
+    std::vector<unsigned int> voxel_points(num_points);            // Point indices grouped by voxel, in input order
+
+    #pragma omp parallel
+    {
+#ifdef _OPENMP
+        const int thread = omp_get_thread_num();
+        const int num_threads = omp_get_num_threads();
+#else
+        const int thread = 0;
+        const int num_threads = 1;
+#endif
+        #pragma omp single
+        {
+            slot_keys.resize(num_threads);
+            slot_counts.resize(num_threads);
+            slot_offsets.resize(num_threads);
+            slot_order.resize(num_threads);
+        }
+
+        const size_t begin = num_points * thread / num_threads;
+        const size_t end = num_points * (thread + 1) / num_threads;
+
+        // Thread-local grouping of this thread's slice
+        VoxelHashMap slots;
+        slots.reset(end - begin);
+        std::vector<unsigned int>& keys = slot_keys[thread];
+        std::vector<unsigned int>& counts = slot_counts[thread];
+        for (size_t i = begin; i < end; ++i) {
+            const unsigned int idx = voxelIndex(layout, cloud.x[i], cloud.y[i], cloud.z[i]);
+            bool inserted;
+            const unsigned int slot = slots.findOrInsert(idx, static_cast<unsigned int>(keys.size()), inserted);
+            if (inserted) {
+                keys.push_back(idx);
+                counts.push_back(0);
+            }
+            counts[slot]++;
+            point_slot[i] = slot;
+        }
+        #pragma omp barrier
+
+        // This thread's slots in ascending voxel index (keys are unique within a thread)
+        std::vector<unsigned int>& order = slot_order[thread];
+        order.resize(keys.size());
+        for (size_t slot = 0; slot < keys.size(); ++slot) {
+            order[slot] = static_cast<unsigned int>(slot);
+        }
+        std::sort(order.begin(), order.end(), [&keys](unsigned int a, unsigned int b) { return keys[a] < keys[b]; });
+        slot_offsets[thread].resize(keys.size());
+        #pragma omp barrier
+
+        // Deterministic merge of the sorted slot lists: voxels in ascending index, and within a voxel the slots of
+        // thread 0 first, then thread 1, ... so each voxel's points end up in input order
+        #pragma omp single
+        {
+            std::vector<size_t> heads(num_threads, 0);
+            while (true) {
+                int next_thread = -1;
+                unsigned int next_key = 0;
+                for (int t = 0; t < num_threads; ++t) {
+                    if (heads[t] < slot_order[t].size()) {
+                        const unsigned int key = slot_keys[t][slot_order[t][heads[t]]];
+                        if (next_thread < 0 || key < next_key) {
+                            next_thread = t;
+                            next_key = key;
+                        }
+                    }
+                }
+                if (next_thread < 0) {
+                    break;
+                }
+                if (voxel_keys.empty() || voxel_keys.back() != next_key) {
+                    voxel_keys.push_back(next_key);
+                    voxel_starts.push_back(voxel_starts.empty() ? 0 : voxel_starts.back());
+                }
+                // voxel_starts.back() is the running end of the current voxel in voxel_points
+                const unsigned int slot = slot_order[next_thread][heads[next_thread]++];
+                slot_offsets[next_thread][slot] = voxel_starts.back();
+                voxel_starts.back() += slot_counts[next_thread][slot];
+            }
+            voxel_starts.insert(voxel_starts.begin(), 0); // voxel_starts[v] .. voxel_starts[v + 1] are the points of voxel v
+            output.points.resize(voxel_keys.size());
+        }
+
+        // Scatter this slice's points to their voxels, keeping input order within each slot
+        std::vector<unsigned int>& offsets = slot_offsets[thread];
+        for (size_t i = begin; i < end; ++i) {
+            voxel_points[offsets[point_slot[i]]++] = static_cast<unsigned int>(i);
+        }
+        #pragma omp barrier
+
+        #pragma omp for
+        for (size_t voxel = 0; voxel < voxel_keys.size(); ++voxel) {
+            float sum_x = 0.0f, sum_y = 0.0f, sum_z = 0.0f;
+            for (unsigned int j = voxel_starts[voxel]; j < voxel_starts[voxel + 1]; ++j) {
+                const unsigned int point = voxel_points[j];
+                sum_x += cloud.x[point];
+                sum_y += cloud.y[point];
+                sum_z += cloud.z[point];
+            }
+            const float count = static_cast<float>(voxel_starts[voxel + 1] - voxel_starts[voxel]);
+            output.points[voxel] = pcl::PointXYZ(sum_x / count, sum_y / count, sum_z / count);
+        }
+    }
+
+    output.width = static_cast<uint32_t>(output.points.size());
+}
+
+// Crops the cloud to the box and downsamples the survivors with a (leaf_x, leaf_y, leaf_z) voxel grid
+inline void cropVoxelDownsample(const pcl::PointCloud<pcl::PointXYZ>& input, const CropBox& box,
+                                float leaf_x, float leaf_y, float leaf_z, pcl::PointCloud<pcl::PointXYZ>& output) {
+    CloudSoA survivors;
+    cropToSoA(input, box, survivors);
+
+    output.header = input.header;
+    output.sensor_origin_ = input.sensor_origin_;
+    output.sensor_orientation_ = input.sensor_orientation_;
+    voxelGridDownsample(survivors, leaf_x, leaf_y, leaf_z, output);
+}
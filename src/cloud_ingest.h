@@ -0,0 +1,166 @@
+#pragma once
+
+// Zero-copy PointCloud2 ingestion.
+//
+// pcl::fromROSMsg copies every point of the message into a pcl::PointCloud before the crop throws most of them
+// away. readPointCloud2 instead reads x/y/z (and intensity, if the message has it) straight from the message
+// buffer through the field offsets, applies the crop box while reading, and writes only the survivors, in
+// message order, into reusable buffers. The survivors are exactly the points PassThrough would have kept.
+// Layouts it cannot read directly (non-float32 coordinates, foreign byte order) go through fromROSMsg instead.
+
+#include <sensor_msgs/PointCloud2.h>
+#include <sensor_msgs/PointField.h>
+#include <pcl_conversions/pcl_conversions.h>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+
+#include "cloud_filters.h"
+
+// Byte offsets of the fields read from a PointCloud2 message
+struct PointCloud2Layout {
+    int x_offset = -1;
+    int y_offset = -1;
+    int z_offset = -1;
+    int intensity_offset = -1;
+    uint8_t intensity_datatype = 0;
+    int ring_offset = -1;      // Laser index of the point, published by the RoboSense driver (range_image.h)
+    uint8_t ring_datatype = 0;
+};
+
+// Crop box that only limits the y axis, for nodes whose first filter is a single PassThrough on y
+inline CropBox cropBoxY(float min_y, float max_y) {
+    const float limit = std::numeric_limits<float>::max();
+    return CropBox{-limit, limit, min_y, max_y, -limit, limit};
+}
+
+inline bool hostIsBigEndian() {
+    const uint16_t probe = 1;
+    uint8_t first_byte;
+    std::memcpy(&first_byte, &probe, 1);
+    return first_byte == 0;
+}
+
+// Finds the x/y/z/intensity offsets. Returns false if the message cannot be read directly.
+inline bool pointCloud2Layout(const sensor_msgs::PointCloud2& msg, PointCloud2Layout& layout) {
+    if (msg.is_bigendian != hostIsBigEndian()) {
+        return false;
+    }
+    for (const sensor_msgs::PointField& field : msg.fields) {
+        if (field.name == "x" && field.datatype == sensor_msgs::PointField::FLOAT32) {
+            layout.x_offset = field.offset;
+        } else if (field.name == "y" && field.datatype == sensor_msgs::PointField::FLOAT32) {
+            layout.y_offset = field.offset;
+        } else if (field.name == "z" && field.datatype == sensor_msgs::PointField::FLOAT32) {
+            layout.z_offset = field.offset;
+        } else if (field.name == "intensity" && (field.datatype == sensor_msgs::PointField::FLOAT32 ||
+                                                 field.datatype == sensor_msgs::PointField::UINT8 ||
+                                                 field.datatype == sensor_msgs::PointField::UINT16)) {
+            layout.intensity_offset = field.offset;
+            layout.intensity_datatype = field.datatype;
+        } else if (field.name == "ring" && (field.datatype == sensor_msgs::PointField::UINT8 ||
+                                            field.datatype == sensor_msgs::PointField::UINT16)) {
+            layout.ring_offset = field.offset;
+            layout.ring_datatype = field.datatype;
+        }
+    }
+    const uint64_t needed = static_cast<uint64_t>(msg.row_step) * msg.height;
+    return layout.x_offset >= 0 && layout.y_offset >= 0 && layout.z_offset >= 0 &&
+           msg.point_step >= 3 * sizeof(float) && msg.data.size() >= needed &&
+           static_cast<uint64_t>(msg.point_step) * msg.width <= msg.row_step;
+}
+
+inline float readIntensity(const uint8_t* point, const PointCloud2Layout& layout) {
+    const uint8_t* field = point + layout.intensity_offset;
+    if (layout.intensity_datatype == sensor_msgs::PointField::UINT8) {
+        return static_cast<float>(*field);
+    }
+    if (layout.intensity_datatype == sensor_msgs::PointField::UINT16) {
+        uint16_t value;
+        std::memcpy(&value, field, sizeof(value));
+        return static_cast<float>(value);
+    }
+    float value;
+    std::memcpy(&value, field, sizeof(value));
+    return value;
+}
+
+inline int readRing(const uint8_t* point, const PointCloud2Layout& layout) {
+    const uint8_t* field = point + layout.ring_offset;
+    if (layout.ring_datatype == sensor_msgs::PointField::UINT8) {
+        return *field;
+    }
+    uint16_t value;
+    std::memcpy(&value, field, sizeof(value));
+    return value;
+}
+
+// Calls visit(x, y, z, point) for every point of the message inside the box, in message order
+template <typename Visitor>
+inline void forEachPointInBox(const sensor_msgs::PointCloud2& msg, const PointCloud2Layout& layout, const CropBox& box, Visitor visit) {
+    for (uint32_t row = 0; row < msg.height; ++row) {
+        const uint8_t* point = msg.data.data() + static_cast<size_t>(row) * msg.row_step;
+        for (uint32_t column = 0; column < msg.width; ++column, point += msg.point_step) {
+            float x, y, z;
+            std::memcpy(&x, point + layout.x_offset, sizeof(float));
+            std::memcpy(&y, point + layout.y_offset, sizeof(float));
+            std::memcpy(&z, point + layout.z_offset, sizeof(float));
+            // Bitwise & so all six compares are evaluated without branches. NaN fails every compare.
+            const bool inside = (x >= box.min_x) & (x <= box.max_x) & (y >= box.min_y) & (y <= box.max_y) &
+                                (z >= box.min_z) & (z <= box.max_z);
+            if (inside) {
+                visit(x, y, z, point);
+            }
+        }
+    }
+}
+
+// Reads the points of the message inside the box into the SoA buffers (intensity too, if the message has it)
+inline void readPointCloud2(const sensor_msgs::PointCloud2& msg, const CropBox& box, CloudSoA& survivors) {
+    survivors.clear();
+
+    PointCloud2Layout layout;
+    if (!pointCloud2Layout(msg, layout)) {
+        pcl::PointCloud<pcl::PointXYZ> cloud;
+        pcl::fromROSMsg(msg, cloud);
+        cropToSoA(cloud, box, survivors);
+        return;
+    }
+
+    survivors.has_intensity = (layout.intensity_offset >= 0);
+    forEachPointInBox(msg, layout, box, [&](float x, float y, float z, const uint8_t* point) {
+        survivors.push_back(x, y, z);
+        if (survivors.has_intensity) {
+            survivors.intensity.push_back(readIntensity(point, layout));
+        }
+    });
+}
+
+// Same as above, for nodes that continue with pcl filters on the cropped cloud
+inline void readPointCloud2(const sensor_msgs::PointCloud2& msg, const CropBox& box, pcl::PointCloud<pcl::PointXYZ>& cloud) {
+    cloud.points.clear();
+    pcl_conversions::toPCL(msg.header, cloud.header);
+
+    PointCloud2Layout layout;
+    if (!pointCloud2Layout(msg, layout)) {
+        pcl::PointCloud<pcl::PointXYZ> full_cloud;
+        pcl::fromROSMsg(msg, full_cloud);
+        for (const pcl::PointXYZ& point : full_cloud.points) {
+            if (insideCropBox(point, box)) {
+                cloud.points.push_back(point);
+            }
+        }
+    } else {
+        forEachPointInBox(msg, layout, box, [&](float x, float y, float z, const uint8_t*) {
+            cloud.points.push_back(pcl::PointXYZ(x, y, z));
+        });
+    }
+
+    cloud.width = static_cast<uint32_t>(cloud.points.size());
+    cloud.height = 1;
+    cloud.is_dense = true;
+}
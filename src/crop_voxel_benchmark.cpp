@@ -0,0 +1,165 @@
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/filters/passthrough.h>
+#include <pcl/filters/voxel_grid.h>
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <algorithm>
+#include <omp.h>
+
+#include "cloud_filters.h"
+#include "benchmark_frames.h" // Frame loading and timing
+
+// Compares the PassThrough x3 + VoxelGrid chain with the fused single-pass kernel (cloud_filters.h) on recorded
+// frames: per-frame time of both, speedup, and whether the downsampled clouds are bit-identical.
+// It then times the parallel voxel grid on the full (uncropped) frames against the sequential one for 1 up to
+// the maximum number of OpenMP threads, with the number of bit-identical centroids.
+// Frames are PCD files of either sensor (see BENCHMARKS.md).
+// Usage: crop_voxel_benchmark <cyglidar|robosense> <frame.pcd> [frame.pcd ...]
+
+// Crop box and leaf sizes used by the nodes for each sensor (terrain.cpp for CygLidar, model_predicting.cpp for RoboSense)
+struct SensorSettings {
+    CropBox box;
+    float leaf_x, leaf_y, leaf_z;
+};
+
+const SensorSettings CYGLIDAR_SETTINGS = {{0.0f, 2.2f, -0.6f, 0.6f, -0.7f, 0.7f}, 0.05f, 0.05f, 0.05f};
+const SensorSettings ROBOSENSE_SETTINGS = {{1.5f, 3.0f, -0.6f, 0.6f, -0.7f, 0.2f}, 0.13f, 0.13f, 0.05f};
+
+const int REPETITIONS = 20;
+
+// The chain the nodes ran before the fused kernel
+void passthroughVoxelChain(const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud, const SensorSettings& settings, pcl::PointCloud<pcl::PointXYZ>& output) {
+    pcl::PassThrough<pcl::PointXYZ> pass;
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_filtered(new pcl::PointCloud<pcl::PointXYZ>);
+
+    pass.setInputCloud(cloud);
+    pass.setFilterFieldName("z");
+    pass.setFilterLimits(settings.box.min_z, settings.box.max_z);
+    pass.filter(*cloud_filtered);
+
+    pass.setInputCloud(cloud_filtered);
+    pass.setFilterFieldName("x");
+    pass.setFilterLimits(settings.box.min_x, settings.box.max_x);
+    pass.filter(*cloud_filtered);
+
+    pass.setInputCloud(cloud_filtered);
+    pass.setFilterFieldName("y");
+    pass.setFilterLimits(settings.box.min_y, settings.box.max_y);
+    pass.filter(*cloud_filtered);
+
+    pcl::VoxelGrid<pcl::PointXYZ> voxel_grid;
+    voxel_grid.setInputCloud(cloud_filtered);
+    voxel_grid.setLeafSize(settings.leaf_x, settings.leaf_y, settings.leaf_z);
+    voxel_grid.filter(output);
+}
+
+bool identicalClouds(const pcl::PointCloud<pcl::PointXYZ>& a, const pcl::PointCloud<pcl::PointXYZ>& b) {
+    if (a.points.size() != b.points.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.points.size(); ++i) {
+        if (std::memcmp(a.points[i].data, b.points[i].data, 3 * sizeof(float)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: crop_voxel_benchmark <cyglidar|robosense> <frame.pcd> [frame.pcd ...]" << std::endl;
+        return 1;
+    }
+
+    std::string sensor = argv[1];
+    SensorSettings settings;
+    if (sensor == "cyglidar") {
+        settings = CYGLIDAR_SETTINGS;
+    } else if (sensor == "robosense") {
+        settings = ROBOSENSE_SETTINGS;
+    } else {
+        std::cerr << "Unknown sensor '" << sensor << "', expected cyglidar or robosense" << std::endl;
+        return 1;
+    }
+
+    int frames = 0, identical_frames = 0;
+    double total_chain_time = 0.0, total_fused_time = 0.0;
+    std::vector<CloudSoA> full_frames;
+
+    for (int f = 2; f < argc; ++f) {
+        pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
+        if (!loadFrame(argv[f], *cloud)) {
+            continue;
+        }
+
+        pcl::PointCloud<pcl::PointXYZ> chain_output, fused_output;
+
+        double chain_time = secondsPerCall(REPETITIONS, [&] { passthroughVoxelChain(cloud, settings, chain_output); });
+        double fused_time = secondsPerCall(REPETITIONS, [&] {
+            cropVoxelDownsample(*cloud, settings.box, settings.leaf_x, settings.leaf_y, settings.leaf_z, fused_output);
+        });
+
+        bool identical = identicalClouds(chain_output, fused_output);
+
+        std::cout << argv[f] << ": " << cloud->points.size() << " -> " << fused_output.points.size() << " points, chain "
+                  << chain_time * 1e3 << " ms, fused " << fused_time * 1e3 << " ms, speedup " << chain_time / fused_time
+                  << "x, " << (identical ? "identical" : "MISMATCH") << std::endl;
+
+        CloudSoA full_frame;
+        cloudToSoA(*cloud, full_frame);
+        full_frames.push_back(full_frame);
+
+        frames++;
+        identical_frames += identical ? 1 : 0;
+        total_chain_time += chain_time;
+        total_fused_time += fused_time;
+    }
+
+    if (!anyFramesRead(frames)) {
+        return 1;
+    }
+
+    std::cout << sensor << ": " << frames << " frames, mean chain " << total_chain_time / frames * 1e3 << " ms, mean fused "
+              << total_fused_time / frames * 1e3 << " ms, speedup " << total_chain_time / total_fused_time << "x, "
+              << identical_frames << "/" << frames << " frames bit-identical" << std::endl;
+
+    // Parallel voxel grid on the full frames
+    std::vector<pcl::PointCloud<pcl::PointXYZ>> sequential_outputs(full_frames.size());
+    double sequential_time = secondsPerCall(REPETITIONS, [&] {
+        for (size_t f = 0; f < full_frames.size(); ++f) {
+            voxelGridDownsample(full_frames[f], settings.leaf_x, settings.leaf_y, settings.leaf_z, sequential_outputs[f]);
+        }
+    }) / frames;
+    std::cout << "Full frames, sequential voxel grid: " << sequential_time * 1e3 << " ms" << std::endl;
+
+    const int max_threads = omp_get_max_threads();
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        omp_set_num_threads(threads);
+        std::vector<pcl::PointCloud<pcl::PointXYZ>> parallel_outputs(full_frames.size());
+        double parallel_time = secondsPerCall(REPETITIONS, [&] {
+            for (size_t f = 0; f < full_frames.size(); ++f) {
+                parallelVoxelGridDownsample(full_frames[f], settings.leaf_x, settings.leaf_y, settings.leaf_z, parallel_outputs[f]);
+            }
+        }) / frames;
+
+        size_t voxels = 0, identical_centroids = 0;
+        bool same_voxels = true;
+        for (size_t f = 0; f < full_frames.size(); ++f) {
+            same_voxels = same_voxels && (parallel_outputs[f].points.size() == sequential_outputs[f].points.size());
+            for (size_t i = 0; i < std::min(parallel_outputs[f].points.size(), sequential_outputs[f].points.size()); ++i) {
+                identical_centroids += (std::memcmp(parallel_outputs[f].points[i].data, sequential_outputs[f].points[i].data, 3 * sizeof(float)) == 0) ? 1 : 0;
+            }
+            voxels += sequential_outputs[f].points.size();
+        }
+        std::cout << "Parallel voxel grid, " << threads << " threads: " << parallel_time * 1e3 << " ms, speedup "
+                  << sequential_time / parallel_time << "x, " << (same_voxels ? "same voxels" : "VOXEL MISMATCH") << ", "
+                  << identical_centroids << "/" << voxels << " centroids bit-identical" << std::endl;
+    }
+    omp_set_num_threads(max_threads);
+
+    return (identical_frames == frames) ? 0 : 2;
+}
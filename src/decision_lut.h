@@ -0,0 +1,37 @@
+#pragma once
+
+// Decision function lookup table over the two normal features.
+//
+// normal_x and normal_y are both bounded in [-1, 1], so the decision function of a two-class model can be baked
+// onto a (resolution + 1)^2 grid over that square and bilinearly interpolated (model_predicting.cpp bakes it).
+// Features outside [-1, 1] are clamped to the border. A non-finite feature (the NaN normal of a point with fewer
+// than three neighbours) has no cell: it gets decision value 0, on the decision boundary, instead of an index
+// computed from NaN.
+
+#include <algorithm>
+#include <cmath>
+
+const double LUT_MIN = -1.0;
+const double LUT_MAX = 1.0;
+
+// Bilinear interpolation of lut, row-major with lut[iy * (resolution + 1) + ix]
+inline double interpolateDecisionLUT(const float* lut, int resolution, double normal_x, double normal_y) {
+    if (!std::isfinite(normal_x) || !std::isfinite(normal_y)) {
+        return 0.0;
+    }
+    const int nodes_per_row = resolution + 1;
+    const double scale = resolution / (LUT_MAX - LUT_MIN);
+
+    double u = (std::min(std::max(normal_x, LUT_MIN), LUT_MAX) - LUT_MIN) * scale;
+    double v = (std::min(std::max(normal_y, LUT_MIN), LUT_MAX) - LUT_MIN) * scale;
+    int ix = std::min(static_cast<int>(u), resolution - 1);
+    int iy = std::min(static_cast<int>(v), resolution - 1);
+    double tx = u - ix;
+    double ty = v - iy;
+
+    const float* row0 = &lut[iy * nodes_per_row + ix];
+    const float* row1 = row0 + nodes_per_row;
+    double top = row0[0] + tx * (row0[1] - row0[0]);
+    double bottom = row1[0] + tx * (row1[1] - row1[0]);
+    return top + ty * (bottom - top);
+}
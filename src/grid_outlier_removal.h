@@ -0,0 +1,180 @@
+#pragma once
+
+// Grid-hash outlier removal.
+//
+// StatisticalOutlierRemoval runs a k-nearest-neighbour query for every point, computes the mean distance to the
+// neighbours and removes the points whose mean distance is above the cloud's mean plus a multiple of its standard
+// deviation. gridOutlierRemoval applies the same rule to local density instead, which takes no search at all:
+// every point is hashed into a cubic cell, the points of each cell and its 26 neighbour cells are counted, and
+// 1 / sqrt(count) stands in for the mean neighbour distance (on a sampled surface the spacing of the points falls
+// with the square root of their density). Cells whose spacing is above mean + stddev_mul * stddev over all points,
+// or with fewer than min_neighbours other points around them, are removed with all their points.
+// Everything is a pass over the points or over the occupied cells, so the cost is O(N). The cell edge sets the
+// neighbourhood scale that mean_k sets for StatisticalOutlierRemoval.
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "voxel_key.h" // Packed cell keys and their hash
+
+struct GridOutlierConfig {
+    float cell_size = 0.1f;  // Edge of the counting cells; a 3x3x3 block of them is the neighbourhood of a point
+    float stddev_mul = 3.0f; // Same meaning as StatisticalOutlierRemoval::setStddevMulThresh
+    int min_neighbours = 2;  // Points with fewer other points in their neighbourhood are always removed
+};
+
+// Hash map and per-cell buffers, kept across frames so their capacity is reused
+struct GridOutlierWorkspace {
+    std::vector<uint64_t> bucket_keys;
+    std::vector<unsigned int> bucket_slots;
+    std::vector<uint64_t> cell_keys;
+    std::vector<unsigned int> cell_counts;          // Points in the cell
+    std::vector<unsigned int> neighbourhood_counts; // Points in the cell and its 26 neighbours
+    std::vector<unsigned char> cell_kept;
+    std::vector<unsigned int> point_cells;          // Cell of every input point, NO_CELL for non-finite points
+    int removed_points = 0;
+
+    static constexpr unsigned int NO_CELL = std::numeric_limits<unsigned int>::max();
+};
+
+// Slot of the cell, NO_CELL if it is not occupied
+inline unsigned int findGridCell(const GridOutlierWorkspace& workspace, uint64_t key) {
+    const uint64_t mask = workspace.bucket_keys.size() - 1;
+    uint64_t bucket = voxelKeyBucket(key, mask);
+    while (workspace.bucket_keys[bucket] != key) {
+        if (workspace.bucket_keys[bucket] == EMPTY_VOXEL_KEY) {
+            return GridOutlierWorkspace::NO_CELL;
+        }
+        bucket = (bucket + 1) & mask;
+    }
+    return workspace.bucket_slots[bucket];
+}
+
+// Marks the points to keep in workspace.cell_kept / workspace.point_cells
+inline void gridOutlierClassify(const pcl::PointCloud<pcl::PointXYZ>& input, const GridOutlierConfig& config, GridOutlierWorkspace& workspace) {
+    // Neighbour keys are formed by adding to the packed key (voxel_key.h), so the outermost cell on each side of
+    // the key range stays unused
+    const float inverse_cell = 1.0f / config.cell_size;
+
+    size_t capacity = 16;
+    while (capacity < 2 * input.points.size()) {
+        capacity *= 2;
+    }
+    const uint64_t mask = capacity - 1;
+    workspace.bucket_keys.assign(capacity, EMPTY_VOXEL_KEY);
+    workspace.bucket_slots.resize(capacity);
+    workspace.cell_keys.clear();
+    workspace.cell_counts.clear();
+    workspace.point_cells.resize(input.points.size());
+
+    // Pass 1: cell of every point and the number of points per cell
+    for (size_t i = 0; i < input.points.size(); ++i) {
+        const pcl::PointXYZ& point = input.points[i];
+        workspace.point_cells[i] = GridOutlierWorkspace::NO_CELL;
+        if (!std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z)) {
+            continue;
+        }
+        const int64_t ix = static_cast<int64_t>(std::floor(point.x * inverse_cell));
+        const int64_t iy = static_cast<int64_t>(std::floor(point.y * inverse_cell));
+        const int64_t iz = static_cast<int64_t>(std::floor(point.z * inverse_cell));
+        uint64_t key;
+        if (!voxelKeyInRange(ix, iy, iz, 1) || !packVoxelKey(ix, iy, iz, key)) {
+            continue; // Kilometres away; dropped like a non-finite point
+        }
+
+        uint64_t bucket = voxelKeyBucket(key, mask);
+        while (workspace.bucket_keys[bucket] != key && workspace.bucket_keys[bucket] != EMPTY_VOXEL_KEY) {
+            bucket = (bucket + 1) & mask;
+        }
+        if (workspace.bucket_keys[bucket] == EMPTY_VOXEL_KEY) {
+            workspace.bucket_keys[bucket] = key;
+            workspace.bucket_slots[bucket] = static_cast<unsigned int>(workspace.cell_keys.size());
+            workspace.cell_keys.push_back(key);
+            workspace.cell_counts.push_back(0);
+        }
+        const unsigned int slot = workspace.bucket_slots[bucket];
+        workspace.cell_counts[slot]++;
+        workspace.point_cells[i] = slot;
+    }
+
+    // Pass 2: points in the 3x3x3 block around every occupied cell, and the spacing statistics over all points
+    const size_t num_cells = workspace.cell_keys.size();
+    workspace.neighbourhood_counts.resize(num_cells);
+    double sum = 0.0, squared_sum = 0.0;
+    size_t num_points = 0;
+    for (size_t cell = 0; cell < num_cells; ++cell) {
+        const uint64_t key = workspace.cell_keys[cell];
+        unsigned int count = 0;
+        for (int64_t dx = -1; dx <= 1; ++dx) {
+            for (int64_t dy = -1; dy <= 1; ++dy) {
+                for (int64_t dz = -1; dz <= 1; ++dz) {
+                    const unsigned int neighbour = findGridCell(workspace, offsetVoxelKey(key, dx, dy, dz));
+                    if (neighbour != GridOutlierWorkspace::NO_CELL) {
+                        count += workspace.cell_counts[neighbour];
+                    }
+                }
+            }
+        }
+        workspace.neighbourhood_counts[cell] = count;
+
+        const double spacing = 1.0 / std::sqrt(static_cast<double>(count));
+        sum += spacing * workspace.cell_counts[cell];
+        squared_sum += spacing * spacing * workspace.cell_counts[cell];
+        num_points += workspace.cell_counts[cell];
+    }
+
+    // Pass 3: keep the cells within the spacing threshold
+    double threshold = std::numeric_limits<double>::max();
+    if (num_points > 1) {
+        const double mean = sum / num_points;
+        const double variance = std::max(0.0, (squared_sum - sum * mean) / (num_points - 1));
+        threshold = mean + config.stddev_mul * std::sqrt(variance);
+    }
+    workspace.cell_kept.resize(num_cells);
+    workspace.removed_points = static_cast<int>(input.points.size() - num_points);
+    for (size_t cell = 0; cell < num_cells; ++cell) {
+        const unsigned int count = workspace.neighbourhood_counts[cell];
+        const bool kept = (1.0 / std::sqrt(static_cast<double>(count)) <= threshold) &&
+                          (static_cast<int>(count) - 1 >= config.min_neighbours);
+        workspace.cell_kept[cell] = kept ? 1 : 0;
+        workspace.removed_points += kept ? 0 : static_cast<int>(workspace.cell_counts[cell]);
+    }
+}
+
+// Drop-in for StatisticalOutlierRemoval::filter: the kept points in input order
+inline void gridOutlierRemoval(const pcl::PointCloud<pcl::PointXYZ>& input, const GridOutlierConfig& config,
+                               GridOutlierWorkspace& workspace, pcl::PointCloud<pcl::PointXYZ>& output) {
+    gridOutlierClassify(input, config, workspace);
+
+    output.header = input.header;
+    output.points.clear();
+    for (size_t i = 0; i < input.points.size(); ++i) {
+        const unsigned int cell = workspace.point_cells[i];
+        if (cell != GridOutlierWorkspace::NO_CELL && workspace.cell_kept[cell]) {
+            output.points.push_back(input.points[i]);
+        }
+    }
+    output.width = static_cast<uint32_t>(output.points.size());
+    output.height = 1;
+    output.is_dense = true;
+}
+
+// Same as above, returning the indices of the kept points instead (like StatisticalOutlierRemoval::filter(indices))
+inline void gridOutlierRemoval(const pcl::PointCloud<pcl::PointXYZ>& input, const GridOutlierConfig& config,
+                               GridOutlierWorkspace& workspace, std::vector<int>& kept_indices) {
+    gridOutlierClassify(input, config, workspace);
+
+    kept_indices.clear();
+    for (size_t i = 0; i < input.points.size(); ++i) {
+        const unsigned int cell = workspace.point_cells[i];
+        if (cell != GridOutlierWorkspace::NO_CELL && workspace.cell_kept[cell]) {
+            kept_indices.push_back(static_cast<int>(i));
+        }
+    }
+}
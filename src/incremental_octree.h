@@ -0,0 +1,96 @@
+#pragma once
+
+// Incremental octree downsampling.
+//
+// OctreePointCloudVoxelCentroid builds its tree from scratch for every scan. IncrementalVoxelCentroidOctree is
+// the same voxel-centroid octree on PCL's double-buffered octree base (the one behind
+// OctreePointCloudChangeDetector). Between frames the buffers are switched instead of deleting the tree:
+// every leaf (and branch) that is occupied again in the new scan is taken over from the previous one and only
+// has its centroid reset and refilled, new voxels get new leaves, and voxels left empty are released at the
+// next switch. For a slow robot most of the tree therefore survives from frame to frame.
+// The bounding box is fixed at construction so that the voxel grid does not move between frames; with a box
+// whose side is a power-of-two multiple of the resolution and whose corner is a multiple of it, the voxels
+// are the same as those of a VoxelGrid with that leaf size.
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/octree/octree_pointcloud.h>
+#include <pcl/octree/octree_pointcloud_voxelcentroid.h>
+#include <pcl/octree/octree2buf_base.h>
+
+#include <vector>
+
+template <typename PointT>
+using VoxelCentroidLeaf = pcl::octree::OctreePointCloudVoxelCentroidContainer<PointT>;
+
+template <typename PointT>
+using DoubleBufferedCentroidOctree = pcl::octree::Octree2BufBase<VoxelCentroidLeaf<PointT>, pcl::octree::OctreeContainerEmpty>;
+
+template <typename PointT>
+class IncrementalVoxelCentroidOctree
+    : public pcl::octree::OctreePointCloud<PointT, VoxelCentroidLeaf<PointT>, pcl::octree::OctreeContainerEmpty,
+                                           DoubleBufferedCentroidOctree<PointT>> {
+public:
+    typedef pcl::octree::OctreePointCloud<PointT, VoxelCentroidLeaf<PointT>, pcl::octree::OctreeContainerEmpty,
+                                          DoubleBufferedCentroidOctree<PointT>> Base;
+    typedef typename Base::LeafNode LeafNode;
+    typedef typename Base::BranchNode BranchNode;
+
+    IncrementalVoxelCentroidOctree(double resolution, double min_x, double min_y, double min_z,
+                                   double max_x, double max_y, double max_z)
+        : Base(resolution) {
+        this->defineBoundingBox(min_x, min_y, min_z, max_x, max_y, max_z);
+    }
+
+    // Replaces the previous scan with the given points (all of cloud when indices is null), reusing every
+    // leaf that is still occupied
+    void update(const typename Base::PointCloudConstPtr& cloud, const typename Base::IndicesConstPtr& indices) {
+        if (frames_ > 0) {
+            this->switchBuffers();
+        }
+        this->setInputCloud(cloud, indices);
+        this->addPointsFromInputCloud();
+
+        new_leaves_.clear();
+        this->serializeNewLeafs(new_leaves_);
+        frames_++;
+    }
+
+    // Leaves created by the last update (the others were taken over from the scan before)
+    size_t newLeafCount() const {
+        return new_leaves_.size();
+    }
+
+    // Centroid of every occupied voxel of the last update
+    void getVoxelCentroids(pcl::PointCloud<PointT>& output) {
+        output.points.clear();
+        output.points.reserve(this->getLeafCount());
+        for (auto leaf = this->leaf_depth_begin(); leaf != this->leaf_depth_end(); ++leaf) {
+            PointT centroid;
+            leaf.getLeafContainer().getCentroid(centroid);
+            output.points.push_back(centroid);
+        }
+        output.width = static_cast<uint32_t>(output.points.size());
+        output.height = 1;
+        output.is_dense = true;
+    }
+
+protected:
+    // Same as OctreePointCloudVoxelCentroid: the leaf accumulates the point itself instead of its index
+    void addPointIdx(const int point_idx) override {
+        const PointT& point = this->input_->points[point_idx];
+        this->adoptBoundingBoxToPoint(point);
+
+        pcl::octree::OctreeKey key;
+        this->genOctreeKeyforPoint(point, key);
+
+        LeafNode* leaf_node;
+        BranchNode* parent_branch;
+        this->createLeafRecursive(key, this->depth_mask_, this->root_node_, leaf_node, parent_branch);
+        leaf_node->getContainer().addPoint(point);
+    }
+
+private:
+    std::vector<VoxelCentroidLeaf<PointT>*> new_leaves_;
+    int frames_ = 0;
+};
@@ -0,0 +1,216 @@
+#pragma once
+
+// Integral image normal estimation on an organized range image (range_image.h).
+//
+// rangeImageNormals visits every pixel of every window, so its cost grows with the window area, and the KdTree
+// normal estimation of the nodes needs a neighbour search per point. Here the sums a covariance is made of (point
+// count, sums of x, y, z and of their six products) are accumulated once into summed-area tables over the image.
+// The moments of any rectangular window are then four lookups per table, so every normal costs the same whatever
+// the size of its window and the whole image is O(N).
+// Empty pixels (NaN in the organized cloud: no return, or outside the crop box) add nothing to the tables, so a
+// window just holds fewer points. A pixel whose window has fewer than three points, or only points of its own ring
+// (a line, not a surface), gets a NaN normal. Columns wrap around behind the sensor: a window across the seam is
+// the sum of two rectangles.
+//
+// Depth-dependent smoothing: the window reaches smoothing_radius + smoothing_per_metre * range metres to each side
+// of the pixel, converted to pixels at the pixel's range. Near pixels, where an azimuth bin is a few millimetres
+// wide, get windows many columns wide, far pixels narrow ones, and the metric size grows with the range to follow
+// the range noise. pcl::IntegralImageNormalEstimation scales its window with z and assumes a pinhole camera looking
+// along z, which a horizontal lidar is not, so it does not apply to these images as it does to depth cameras.
+//
+// Depth discontinuities: a window across an object border blends the normals of both sides. Pixels whose range
+// differs from that of the next pixel in their ring by more than max(min_jump, relative_jump * range) are counted
+// in a further table; a window holding such a jump is halved in columns until it is clean, and the pixel gets NaN
+// when even a three-column window is not. Only jumps along a ring count: across rings the range of the floor itself
+// jumps at grazing angles.
+//
+// The plane fits of all pixels are solved in one batch (plane_batch.h) once the windows are summed.
+//
+// compactNormals gathers the pixels with a finite normal into a dense cloud and normals of equal size, the form
+// predictTerrainType and the feature CSVs take.
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/features/normal_3d.h>
+
+#include <Eigen/Core>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "range_image.h"
+#include "plane_batch.h"
+
+struct IntegralImageNormalConfig {
+    float smoothing_radius = 0.05f;     // Metres to each side of the pixel at zero range ...
+    float smoothing_per_metre = 0.02f;  // ... plus this much per metre of range
+    float ring_spacing = 2.0f;          // Degrees between neighbouring rows (RS-LiDAR-16: 30 degrees over 15 gaps)
+    int max_half_rows = 2;              // Largest window, in pixels to each side
+    int max_half_columns = 40;
+    float min_jump = 0.05f;             // Depth discontinuity: range step to the next pixel of the ring above
+    float relative_jump = 0.03f;        // max(min_jump, relative_jump * range)
+};
+
+// Point count and first and second order sums of the points of a pixel or window
+struct PixelMoments {
+    double count, x, y, z, xx, xy, xz, yy, yz, zz;
+
+    PixelMoments operator+(const PixelMoments& o) const {
+        return {count + o.count, x + o.x, y + o.y, z + o.z, xx + o.xx, xy + o.xy, xz + o.xz, yy + o.yy, yz + o.yz, zz + o.zz};
+    }
+    PixelMoments operator-(const PixelMoments& o) const {
+        return {count - o.count, x - o.x, y - o.y, z - o.z, xx - o.xx, xy - o.xy, xz - o.xz, yy - o.yy, yz - o.yz, zz - o.zz};
+    }
+};
+
+// Summed-area tables of one image, kept across frames. Both are (rows + 1) x (cols + 1) with a zero first row and
+// column: entry (r, c) holds the sum over the pixels above row r and left of column c.
+struct IntegralImageNormalWorkspace {
+    std::vector<PixelMoments> moments;
+    std::vector<int> jumps;  // Depth discontinuities between a pixel and the next one in its ring
+    NormalBatchWorkspace batch;  // Covariance of every pixel's window and its solution
+};
+
+// Sum over rows first_row..last_row and columns first_column..last_column, all inclusive
+template <typename T>
+inline T integralRectangle(const std::vector<T>& table, int stride, int first_row, int last_row, int first_column, int last_column) {
+    const size_t top = static_cast<size_t>(first_row) * stride, bottom = static_cast<size_t>(last_row + 1) * stride;
+    return table[bottom + last_column + 1] - table[top + last_column + 1] - table[bottom + first_column] + table[top + first_column];
+}
+
+// Same over num_columns columns from first_column, wrapping around the last column of the image
+template <typename T>
+inline T integralWindow(const std::vector<T>& table, int cols, int first_row, int last_row, int first_column, int num_columns) {
+    if (first_column < 0) {
+        first_column += cols;
+    }
+    const int stride = cols + 1;
+    const int end = first_column + num_columns;
+    if (end <= cols) {
+        return integralRectangle(table, stride, first_row, last_row, first_column, end - 1);
+    }
+    return integralRectangle(table, stride, first_row, last_row, first_column, cols - 1) +
+           integralRectangle(table, stride, first_row, last_row, 0, end - cols - 1);
+}
+
+inline void buildIntegralImages(const RangeImage& image, const IntegralImageNormalConfig& config, IntegralImageNormalWorkspace& workspace) {
+    const int stride = image.cols + 1;
+    const size_t size = static_cast<size_t>(image.rows + 1) * stride;
+    workspace.moments.assign(size, PixelMoments{0, 0, 0, 0, 0, 0, 0, 0, 0, 0});
+    workspace.jumps.assign(size, 0);
+
+    for (int row = 0; row < image.rows; ++row) {
+        PixelMoments row_moments{0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+        int row_jumps = 0;
+        for (int column = 0; column < image.cols; ++column) {
+            const int index = row * image.cols + column;
+            const float range = image.range[index];
+            if (range > 0.0f) {
+                const pcl::PointXYZ& p = image.cloud->points[index];
+                const double x = p.x, y = p.y, z = p.z;
+                row_moments = row_moments + PixelMoments{1.0, x, y, z, x * x, x * y, x * z, y * y, y * z, z * z};
+
+                const int next = row * image.cols + (column == image.cols - 1 ? 0 : column + 1);
+                const float next_range = image.range[next];
+                if (next_range > 0.0f && std::fabs(next_range - range) > std::max(config.min_jump, config.relative_jump * std::min(range, next_range))) {
+                    row_jumps++;
+                }
+            }
+
+            const size_t entry = static_cast<size_t>(row + 1) * stride + column + 1;
+            workspace.moments[entry] = workspace.moments[entry - stride] + row_moments;
+            workspace.jumps[entry] = workspace.jumps[entry - stride] + row_jumps;
+        }
+    }
+}
+
+// Normal and curvature of every filled pixel from the integral images, oriented towards the sensor. The output is
+// organized like the image; empty pixels and pixels without a valid window get NaN.
+inline void integralImageNormals(const RangeImage& image, const IntegralImageNormalConfig& config, IntegralImageNormalWorkspace& workspace,
+                                 pcl::PointCloud<pcl::Normal>& normals) {
+    const int size = image.rows * image.cols;
+    normals.header = image.cloud->header;
+    normals.points.resize(size);
+    normals.width = image.cloud->width;
+    normals.height = image.cloud->height;
+    normals.is_dense = false;
+    if (size == 0) {
+        return;
+    }
+
+    buildIntegralImages(image, config, workspace);
+    const float column_angle = static_cast<float>(2.0 * M_PI) / static_cast<float>(image.cols);
+    const float row_angle = config.ring_spacing * static_cast<float>(M_PI / 180.0);
+    const int max_half_columns = std::max(1, std::min(config.max_half_columns, (image.cols - 1) / 2));
+    const int max_half_rows = std::max(1, config.max_half_rows);
+    CovarianceBatch& covariances = workspace.batch.covariances;
+    resizeCovarianceBatch(covariances, size);
+
+    #pragma omp parallel for schedule(static)
+    for (int index = 0; index < size; ++index) {
+        setInvalidCovariance(covariances, index);
+        const float range = image.range[index];
+        if (!(range > 0.0f)) {
+            continue;
+        }
+        const int row = index / image.cols, column = index % image.cols;
+
+        // Depth-dependent window: the same metric extent at every range
+        const float extent = config.smoothing_radius + config.smoothing_per_metre * range;
+        const int half_columns = std::max(1, std::min(max_half_columns, static_cast<int>(std::ceil(extent / (range * column_angle)))));
+        const int half_rows = std::max(1, std::min(max_half_rows, static_cast<int>(std::lround(extent / (range * row_angle)))));
+        const int first_row = std::max(0, row - half_rows), last_row = std::min(image.rows - 1, row + half_rows);
+
+        // Narrow the window until no depth discontinuity lies between two of its columns
+        int half = half_columns;
+        while (integralWindow(workspace.jumps, image.cols, first_row, last_row, column - half, 2 * half) > 0 && half > 1) {
+            half /= 2;
+        }
+        if (integralWindow(workspace.jumps, image.cols, first_row, last_row, column - half, 2 * half) > 0) {
+            continue;
+        }
+
+        const PixelMoments window = integralWindow(workspace.moments, image.cols, first_row, last_row, column - half, 2 * half + 1);
+        const PixelMoments ring = integralWindow(workspace.moments, image.cols, row, row, column - half, 2 * half + 1);
+        if (window.count < 3.0 || window.count == ring.count) {
+            continue;
+        }
+
+        const double n = window.count;
+        const Eigen::Vector3d mean(window.x / n, window.y / n, window.z / n);
+        Eigen::Matrix3d second;
+        second << window.xx, window.xy, window.xz,
+                  window.xy, window.yy, window.yz,
+                  window.xz, window.yz, window.zz;
+        setCovariance(covariances, index, (second / n - mean * mean.transpose()).cast<float>());
+    }
+
+    solvePlanesBatch(covariances, workspace.batch.planes);
+    orientedNormals(*image.cloud, workspace.batch.planes, normals);
+}
+
+// The pixels with a finite normal as a dense cloud and normals of equal size, in pixel order. Returns the number
+// of filled pixels left out for want of a normal.
+inline int compactNormals(const RangeImage& image, const pcl::PointCloud<pcl::Normal>& organized_normals,
+                          pcl::PointCloud<pcl::PointXYZ>& cloud, pcl::PointCloud<pcl::Normal>& normals) {
+    cloud.points.clear();
+    normals.points.clear();
+    cloud.header = normals.header = image.cloud->header;
+    int dropped = 0;
+    for (size_t index = 0; index < organized_normals.points.size(); ++index) {
+        const pcl::Normal& normal = organized_normals.points[index];
+        if (std::isfinite(normal.normal_x) && std::isfinite(normal.normal_y) && std::isfinite(normal.normal_z)) {
+            cloud.points.push_back(image.cloud->points[index]);
+            normals.points.push_back(normal);
+        } else if (image.filled(static_cast<int>(index))) {
+            dropped++;
+        }
+    }
+    cloud.width = static_cast<uint32_t>(cloud.points.size());
+    normals.width = static_cast<uint32_t>(normals.points.size());
+    cloud.height = normals.height = 1;
+    cloud.is_dense = normals.is_dense = true;
+    return dropped;
+}
@@ -0,0 +1,200 @@
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/search/kdtree.h>
+#include <pcl/features/normal_3d_omp.h>
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include <svm.h>
+
+#include "cloud_filters.h"
+#include "range_image.h"
+#include "integral_normals.h"
+#include "benchmark_frames.h" // Frame loading and timing
+
+// Compares the integral image normals (integral_normals.h) with the KdTree normals of the nodes on recorded frames:
+//   KdTree:         crop, voxel grid and NormalEstimationOMP with k = N/5, the model_predicting.cpp pipeline
+//   integral image: crop into a range image, integral image normals and compaction of the pixels with a normal
+// For every frame it prints the time and the number of points of both pipelines. For accuracy the KdTree normals
+// are also computed on the integral image points themselves (k = N/5 of those points), and the two sets of normals
+// of the same points are compared: mean angle between them, mean change of normal_x and normal_y (the classifier
+// features) and, with a model file, the share of points whose predicted label is the same.
+// Frames are RoboSense PCD files (see BENCHMARKS.md).
+// Organized frames keep their rows as rings, unorganized ones get their ring from the elevation angle.
+// Usage: integral_normals_benchmark [model_file] <frame.pcd> [frame.pcd ...]
+
+// model_predicting.cpp crop box, leaf size and k rule
+const CropBox BOX = {1.5f, 3.0f, -0.6f, 0.6f, -0.7f, 0.2f};
+const float LEAF_X = 0.13f, LEAF_Y = 0.13f, LEAF_Z = 0.05f;
+const int CLOUD_DIVISOR = 5;
+const int MIN_K = 10;
+
+const int REPETITIONS = 5;
+
+typedef pcl::PointCloud<pcl::PointXYZ> Cloud;
+typedef pcl::PointCloud<pcl::Normal> Normals;
+
+struct Comparison {
+    double angle = 0.0;            // Mean angle between the normals (degrees)
+    double feature_change = 0.0;   // Mean |change| of normal_x and normal_y
+    double label_agreement = 1.0;  // Share of equal labels
+};
+
+void kdTreeNormals(const Cloud::Ptr& cloud, Normals& normals) {
+    pcl::NormalEstimationOMP<pcl::PointXYZ, pcl::Normal> ne;
+    pcl::search::KdTree<pcl::PointXYZ>::Ptr tree(new pcl::search::KdTree<pcl::PointXYZ>);
+    ne.setInputCloud(cloud);
+    ne.setSearchMethod(tree);
+    ne.setKSearch(std::max(MIN_K, static_cast<int>(cloud->points.size() / CLOUD_DIVISOR)));
+    ne.compute(normals);
+}
+
+void predictLabels(const svm_model* model, const Normals& normals, std::vector<double>& labels) {
+    labels.resize(normals.points.size());
+    for (size_t i = 0; i < normals.points.size(); ++i) {
+        svm_node nodes[3];
+        nodes[0].index = 1;
+        nodes[0].value = normals.points[i].normal_x;
+        nodes[1].index = 2;
+        nodes[1].value = normals.points[i].normal_y;
+        nodes[2].index = -1;
+        labels[i] = svm_predict(model, nodes);
+    }
+}
+
+// Angle, feature change and label agreement of two sets of normals of the same points, over the finite ones
+Comparison compareNormals(const svm_model* model, const Normals& reference, const Normals& normals) {
+    Comparison comparison;
+    size_t count = 0, equal = 0;
+    double angle_sum = 0.0, change_sum = 0.0;
+    std::vector<double> reference_labels, labels;
+    if (model != nullptr) {
+        predictLabels(model, reference, reference_labels);
+        predictLabels(model, normals, labels);
+    }
+    for (size_t i = 0; i < reference.points.size() && i < normals.points.size(); ++i) {
+        const pcl::Normal& a = reference.points[i];
+        const pcl::Normal& b = normals.points[i];
+        if (!std::isfinite(a.normal_x) || !std::isfinite(b.normal_x)) {
+            continue;
+        }
+        const double dot = a.normal_x * b.normal_x + a.normal_y * b.normal_y + a.normal_z * b.normal_z;
+        angle_sum += std::acos(std::min(1.0, std::max(-1.0, dot))) * 180.0 / M_PI;
+        change_sum += 0.5 * (std::fabs(a.normal_x - b.normal_x) + std::fabs(a.normal_y - b.normal_y));
+        equal += (model != nullptr && reference_labels[i] == labels[i]) ? 1 : 0;
+        count++;
+    }
+    if (count > 0) {
+        comparison.angle = angle_sum / count;
+        comparison.feature_change = change_sum / count;
+        if (model != nullptr) {
+            comparison.label_agreement = static_cast<double>(equal) / count;
+        }
+    }
+    return comparison;
+}
+
+int main(int argc, char** argv) {
+    svm_model* model = nullptr;
+    int first_frame = 1;
+    if (argc > 1) {
+        const std::string first = argv[1];
+        if (first.size() < 4 || first.compare(first.size() - 4, 4, ".pcd") != 0) {
+            model = svm_load_model(argv[1]);
+            if (model == nullptr) {
+                std::cerr << "Cannot load model " << argv[1] << std::endl;
+                return 1;
+            }
+            first_frame = 2;
+        }
+    }
+    if (argc <= first_frame) {
+        std::cerr << "Usage: integral_normals_benchmark [model_file] <frame.pcd> [frame.pcd ...]" << std::endl;
+        return 1;
+    }
+
+    const RangeImageConfig range_image_config;
+    const IntegralImageNormalConfig integral_config;
+    RangeImage image;
+    IntegralImageNormalWorkspace workspace;
+
+    int frames = 0;
+    double kdtree_time_sum = 0.0, integral_time_sum = 0.0, kdtree_points_sum = 0.0, integral_points_sum = 0.0;
+    double dropped_sum = 0.0, angle_sum = 0.0, change_sum = 0.0, agreement_sum = 0.0;
+    for (int f = first_frame; f < argc; ++f) {
+        Cloud raw;
+        if (!loadFrame(argv[f], raw)) {
+            continue;
+        }
+
+        // KdTree pipeline
+        Cloud::Ptr downsampled(new Cloud);
+        Normals kdtree_normals;
+        CloudSoA survivors;
+        VoxelGridWorkspace voxel_grid;
+        const double kdtree_time = secondsPerCall(REPETITIONS, [&] {
+            cropToSoA(raw, BOX, survivors);
+            voxelGridDownsample(survivors, LEAF_X, LEAF_Y, LEAF_Z, *downsampled, voxel_grid);
+            kdTreeNormals(downsampled, kdtree_normals);
+        });
+
+        // Integral image pipeline
+        Cloud::Ptr pixels(new Cloud);
+        Normals organized_normals, integral_normals;
+        int dropped = 0;
+        const double integral_time = secondsPerCall(REPETITIONS, [&] {
+            buildRangeImage(raw, BOX, range_image_config, image);
+            integralImageNormals(image, integral_config, workspace, organized_normals);
+            dropped = compactNormals(image, organized_normals, *pixels, integral_normals);
+        });
+        if (pixels->points.size() < 3) {
+            std::cerr << "Skipping " << argv[f] << ": fewer than three points with an integral image normal" << std::endl;
+            continue;
+        }
+
+        // KdTree normals of the same points
+        Normals reference;
+        kdTreeNormals(pixels, reference);
+        const Comparison comparison = compareNormals(model, reference, integral_normals);
+
+        std::cout << argv[f] << ": KdTree " << downsampled->points.size() << " points, " << kdtree_time * 1e3 << " ms; integral image "
+                  << pixels->points.size() << " points (" << dropped << " pixels without a normal), " << integral_time * 1e3
+                  << " ms; angle to the KdTree normals " << comparison.angle << " deg, feature change " << comparison.feature_change;
+        if (model != nullptr) {
+            std::cout << ", " << 100.0 * comparison.label_agreement << "% labels unchanged";
+        }
+        std::cout << std::endl;
+
+        frames++;
+        kdtree_time_sum += kdtree_time;
+        integral_time_sum += integral_time;
+        kdtree_points_sum += downsampled->points.size();
+        integral_points_sum += pixels->points.size();
+        dropped_sum += dropped;
+        angle_sum += comparison.angle;
+        change_sum += comparison.feature_change;
+        agreement_sum += comparison.label_agreement;
+    }
+
+    if (!anyFramesRead(frames)) {
+        return 1;
+    }
+
+    std::cout << frames << " frames: mean KdTree " << kdtree_time_sum / frames * 1e3 << " ms for " << kdtree_points_sum / frames
+              << " points, integral image " << integral_time_sum / frames * 1e3 << " ms for " << integral_points_sum / frames
+              << " points (" << dropped_sum / frames << " pixels without a normal); per point "
+              << kdtree_time_sum / kdtree_points_sum * 1e6 << " us vs " << integral_time_sum / integral_points_sum * 1e6
+              << " us; mean angle " << angle_sum / frames << " deg, feature change " << change_sum / frames;
+    if (model != nullptr) {
+        std::cout << ", " << 100.0 * agreement_sum / frames << "% labels unchanged";
+    }
+    std::cout << std::endl;
+
+    if (model != nullptr) {
+        svm_free_and_destroy_model(&model);
+    }
+    return 0;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+// Per-frame latency budget.
+//
+// The leaf size of the voxel grid and the neighbour count of the normal estimation set most of the cost of a
+// frame: a coarser grid leaves fewer points for every later stage, and the normal estimation cost grows with k.
+// updateLatencyBudget is called once per frame with the measured stage times and moves both knobs, within the
+// configured bounds, to keep the frame within the deadline:
+//   - a frame over the deadline lowers the neighbour limit when the (smoothed) normal stage takes at least half
+//     of the frame, and coarsens the leaf otherwise; when a knob is at its bound the other one is used
+//   - when both knobs are at their bounds and the deadline is still missed for fallback_misses frames in a row,
+//     the cheaper model is requested (the node decides what that is)
+//   - relax_frames frames in a row under (1 - headroom) of the deadline undo one step, in the reverse order:
+//     cheaper model first, then the leaf, then the neighbour limit
+// Steps are multiplicative, so the controller settles within a few frames and the headroom keeps it from
+// oscillating around the deadline. Every call reports the adjustment it made (LatencyAdjustment::None if any).
+
+#include <algorithm>
+
+struct LatencyBudgetConfig {
+    double deadline = 0.1;        // Seconds per frame (the lidar's 10 Hz period)
+    double headroom = 0.25;       // Fraction of the deadline that must be left over before a step is undone
+    float min_leaf_scale = 1.0f;  // Bounds of the factor applied to the node's leaf size
+    float max_leaf_scale = 2.0f;
+    float leaf_step = 1.15f;      // Leaf scale factor per step
+    int min_neighbours = 10;      // Bounds of the neighbour limit
+    int max_neighbours = 400;
+    float neighbour_step = 0.75f; // Neighbour limit factor per step
+    int relax_frames = 10;        // Frames under budget before a step is undone
+    int fallback_misses = 3;      // Misses with both knobs at their bounds before the cheaper model is requested
+    double smoothing = 0.3;       // Weight of the newest frame in the smoothed stage times
+};
+
+enum class LatencyAdjustment { None, LowerNeighbours, CoarsenLeaf, CheaperModel, FullModel, RefineLeaf, RaiseNeighbours };
+
+inline const char* latencyAdjustmentName(LatencyAdjustment adjustment) {
+    switch (adjustment) {
+        case LatencyAdjustment::LowerNeighbours: return "lower neighbours";
+        case LatencyAdjustment::CoarsenLeaf: return "coarsen leaf";
+        case LatencyAdjustment::CheaperModel: return "cheaper model";
+        case LatencyAdjustment::FullModel: return "full model";
+        case LatencyAdjustment::RefineLeaf: return "refine leaf";
+        case LatencyAdjustment::RaiseNeighbours: return "raise neighbours";
+        default: return "none";
+    }
+}
+
+// Knob settings for the next frame and the controller's history
+struct LatencyBudgetState {
+    float leaf_scale = 1.0f;
+    int neighbour_limit = 400;    // Upper bound on k; the node's own k rule applies below it
+    bool cheaper_model = false;
+
+    double smoothed_normal_time = 0.0;
+    double smoothed_frame_time = 0.0;
+    int frames_under_budget = 0;
+    int misses_at_bounds = 0;
+    int missed_frames = 0;
+    int frames = 0;
+};
+
+inline void resetLatencyBudget(const LatencyBudgetConfig& config, LatencyBudgetState& state) {
+    state = LatencyBudgetState();
+    state.leaf_scale = config.min_leaf_scale;
+    state.neighbour_limit = config.max_neighbours;
+}
+
+// k for a frame: the node's rule, capped by the current neighbour limit
+inline int budgetedNeighbours(const LatencyBudgetState& state, int k) {
+    return std::max(1, std::min(k, state.neighbour_limit));
+}
+
+// Feeds the stage times of the frame just finished (normal_time is the part of frame_time spent in the
+// normal estimation, neighbours the k it used) and adjusts the knobs for the next frame.
+inline LatencyAdjustment updateLatencyBudget(const LatencyBudgetConfig& config, double frame_time, double normal_time,
+                                             int neighbours, LatencyBudgetState& state) {
+    const double weight = state.frames == 0 ? 1.0 : config.smoothing;
+    state.smoothed_frame_time += weight * (frame_time - state.smoothed_frame_time);
+    state.smoothed_normal_time += weight * (normal_time - state.smoothed_normal_time);
+    state.frames++;
+
+    const bool can_lower_neighbours = std::min(neighbours, state.neighbour_limit) > config.min_neighbours;
+    const bool can_coarsen_leaf = state.leaf_scale < config.max_leaf_scale;
+
+    if (frame_time > config.deadline) {
+        state.missed_frames++;
+        state.frames_under_budget = 0;
+        const bool normals_dominate = state.smoothed_normal_time >= 0.5 * state.smoothed_frame_time;
+        if (can_lower_neighbours && (normals_dominate || !can_coarsen_leaf)) {
+            // Start from the k the frame actually used; the limit may still be far above it
+            const int lowered = static_cast<int>(std::min(neighbours, state.neighbour_limit) * config.neighbour_step);
+            state.neighbour_limit = std::max(config.min_neighbours, lowered);
+            state.misses_at_bounds = 0;
+            return LatencyAdjustment::LowerNeighbours;
+        }
+        if (can_coarsen_leaf) {
+            state.leaf_scale = std::min(config.max_leaf_scale, state.leaf_scale * config.leaf_step);
+            state.misses_at_bounds = 0;
+            return LatencyAdjustment::CoarsenLeaf;
+        }
+        if (!state.cheaper_model && ++state.misses_at_bounds >= config.fallback_misses) {
+            state.cheaper_model = true;
+            state.misses_at_bounds = 0;
+            return LatencyAdjustment::CheaperModel;
+        }
+        return LatencyAdjustment::None;
+    }
+
+    state.misses_at_bounds = 0;
+    if (frame_time > (1.0 - config.headroom) * config.deadline) {
+        state.frames_under_budget = 0;
+        return LatencyAdjustment::None;
+    }
+    if (++state.frames_under_budget < config.relax_frames) {
+        return LatencyAdjustment::None;
+    }
+    state.frames_under_budget = 0;
+    if (state.cheaper_model) {
+        state.cheaper_model = false;
+        return LatencyAdjustment::FullModel;
+    }
+    if (state.leaf_scale > config.min_leaf_scale) {
+        state.leaf_scale = std::max(config.min_leaf_scale, state.leaf_scale / config.leaf_step);
+        return LatencyAdjustment::RefineLeaf;
+    }
+    if (state.neighbour_limit < config.max_neighbours) {
+        const int raised = static_cast<int>(state.neighbour_limit / config.neighbour_step) + 1;
+        state.neighbour_limit = std::min(config.max_neighbours, raised);
+        return LatencyAdjustment::RaiseNeighbours;
+    }
+    return LatencyAdjustment::None;
+}
@@ -0,0 +1,505 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <cstdio>
+#include <cstdlib>
+#include <omp.h>
+#include <svm.h>
+#include <Eigen/Dense>
+
+#include "svm_batch.h"
+
+// Shrinks an existing two-class libsvm model to a support vector budget.
+//
+// Linear models collapse exactly into one weight vector, which is written as a single SV per class.
+// RBF models are compressed with a reduced-set method: the SVs of each class are clustered with weighted
+// k-means, each cluster becomes one SV at its |coef|-weighted centroid with the summed coefficient, and the
+// coefficients are then refit by least squares so the reduced model reproduces the original decision
+// values on the training features. If the held-out accuracy drops by more than the tolerance, the budget is
+// doubled and the compression repeated, up to max_sv and never beyond the rows of the refit (the least-squares
+// system stays overdetermined, and its kernel matrix bounded). If even that budget misses the tolerance,
+// nothing is written and the tool fails. The written model is reloaded through libsvm and checked against the
+// tolerance once more; if the reload misses it, the file is removed and the tool fails as well.
+//
+// Usage: model_compression <input.model> <output.model> [target_sv] [accuracy_tolerance] [plain_csv grass_csv] [max_sv]
+// The output is a standard libsvm model that loadSVMModel in model_predicting.cpp reads unchanged.
+
+struct FeatureData {
+    double normal_x;
+    double normal_y;
+    int label;
+};
+
+struct CompressionReport {
+    double accuracy;
+    double latency_per_point; // Seconds per point with svm_predict on a single thread
+};
+
+// Function to load CSV files
+std::vector<FeatureData> loadCSV(const std::string& filename, int label) {
+    std::vector<FeatureData> data;
+    std::ifstream file(filename);
+    std::string line;
+
+    std::cout << "Loading data from: " << filename << std::endl;
+
+    // Skip header line
+    std::getline(file, line);
+
+    while (std::getline(file, line)) {
+        std::stringstream ss(line);
+        std::string token;
+
+        FeatureData feature;
+
+        // Skip X, Y, Z columns
+        for (int i = 0; i < 3; ++i) {
+            std::getline(ss, token, ',');
+        }
+
+        // Read NormalX and NormalY
+        std::getline(ss, token, ',');
+        feature.normal_x = std::stod(token);
+        std::getline(ss, token, ',');
+        feature.normal_y = std::stod(token);
+
+        // Assign the provided label (0 for plain, 1 for grass)
+        feature.label = label;
+
+        data.push_back(feature);
+    }
+
+    std::cout << "Loaded " << data.size() << " samples from: " << filename << std::endl;
+
+    return data;
+}
+
+// ----------------------------------------------------------------------------------
+// MODEL CONSTRUCTION
+// ----------------------------------------------------------------------------------
+
+// Reduced model owned by this tool (libsvm's svm_free_and_destroy_model is not used on it)
+struct ReducedModel {
+    svm_model model;
+    std::vector<std::vector<svm_node>> nodes;
+    std::vector<svm_node*> sv_pointers;
+    std::vector<double> coef;
+    double* coef_pointer;
+    double rho;
+    int label[2];
+    int n_sv[2];
+};
+
+// svm_save_model writes SV coordinates with %.8g. Centers are rounded the same way before the coefficient
+// refit, so the refit sees exactly the SVs that model_predicting will load.
+double roundToSavedPrecision(double value) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.8g", value);
+    return std::strtod(buffer, nullptr);
+}
+
+// Builds a two-class model with the given SV positions (class 0 first) and coefficients
+void assembleModel(const svm_model* original, const std::vector<Eigen::Vector2d>& centers, const std::vector<double>& coef,
+                   int class0_count, ReducedModel& reduced) {
+    int total = centers.size();
+
+    reduced.nodes.assign(total, std::vector<svm_node>(3));
+    reduced.sv_pointers.resize(total);
+    for (int i = 0; i < total; ++i) {
+        reduced.nodes[i][0].index = 1;
+        reduced.nodes[i][0].value = centers[i].x();
+        reduced.nodes[i][1].index = 2;
+        reduced.nodes[i][1].value = centers[i].y();
+        reduced.nodes[i][2].index = -1;
+        reduced.sv_pointers[i] = reduced.nodes[i].data();
+    }
+
+    reduced.coef = coef;
+    reduced.coef_pointer = reduced.coef.data();
+    reduced.rho = original->rho[0];
+    reduced.label[0] = original->label[0];
+    reduced.label[1] = original->label[1];
+    reduced.n_sv[0] = class0_count;
+    reduced.n_sv[1] = total - class0_count;
+
+    svm_model& model = reduced.model;
+    model = svm_model();
+    model.param = original->param;
+    model.nr_class = 2;
+    model.l = total;
+    model.SV = reduced.sv_pointers.data();
+    model.sv_coef = &reduced.coef_pointer;
+    model.rho = &reduced.rho;
+    model.label = reduced.label;
+    model.nSV = reduced.n_sv;
+    model.probA = nullptr;
+    model.probB = nullptr;
+    model.sv_indices = nullptr;
+    model.free_sv = 0;
+}
+
+// A linear model is exactly w.x - rho: one SV at w/2 for class 0 and one at -w/2 for class 1, both with |coef| = 1
+void compressLinear(const svm_model* original, ReducedModel& reduced) {
+    Eigen::Vector2d weights = Eigen::Vector2d::Zero();
+    for (int i = 0; i < original->l; ++i) {
+        for (const svm_node* node = original->SV[i]; node->index != -1; ++node) {
+            if (node->index == 1 || node->index == 2) {
+                weights(node->index - 1) += original->sv_coef[0][i] * node->value;
+            }
+        }
+    }
+
+    std::vector<Eigen::Vector2d> centers = {0.5 * weights, -0.5 * weights};
+    std::vector<double> coef = {1.0, -1.0};
+    assembleModel(original, centers, coef, 1, reduced);
+}
+
+// Weighted k-means (k-means++ seeding) of 2D support vectors. Returns the centers and writes each SV's cluster.
+std::vector<Eigen::Vector2d> weightedKMeans(const std::vector<Eigen::Vector2d>& points, const std::vector<double>& weights,
+                                            int k, std::vector<int>& assignment, std::mt19937& generator) {
+    int n = points.size();
+    k = std::min(k, n);
+    std::vector<Eigen::Vector2d> centers;
+    centers.reserve(k);
+
+    std::vector<double> min_distance(n, std::numeric_limits<double>::max());
+    std::uniform_int_distribution<int> first(0, n - 1);
+    centers.push_back(points[first(generator)]);
+
+    while (static_cast<int>(centers.size()) < k) {
+        const Eigen::Vector2d& last = centers.back();
+        for (int i = 0; i < n; ++i) {
+            min_distance[i] = std::min(min_distance[i], (points[i] - last).squaredNorm());
+        }
+        std::vector<double> probabilities(n);
+        for (int i = 0; i < n; ++i) {
+            probabilities[i] = weights[i] * min_distance[i];
+        }
+        std::discrete_distribution<int> pick(probabilities.begin(), probabilities.end());
+        centers.push_back(points[pick(generator)]);
+    }
+
+    assignment.assign(n, 0);
+    for (int iteration = 0; iteration < 30; ++iteration) {
+        bool changed = false;
+
+        #pragma omp parallel for reduction(||:changed)
+        for (int i = 0; i < n; ++i) {
+            int best = 0;
+            double best_distance = std::numeric_limits<double>::max();
+            for (int c = 0; c < k; ++c) {
+                double distance = (points[i] - centers[c]).squaredNorm();
+                if (distance < best_distance) {
+                    best_distance = distance;
+                    best = c;
+                }
+            }
+            if (assignment[i] != best) {
+                assignment[i] = best;
+                changed = true;
+            }
+        }
+
+        std::vector<Eigen::Vector2d> sums(k, Eigen::Vector2d::Zero());
+        std::vector<double> totals(k, 0.0);
+        for (int i = 0; i < n; ++i) {
+            sums[assignment[i]] += weights[i] * points[i];
+            totals[assignment[i]] += weights[i];
+        }
+        for (int c = 0; c < k; ++c) {
+            if (totals[c] > 0) {
+                centers[c] = sums[c] / totals[c];
+            }
+        }
+
+        if (!changed && iteration > 0) {
+            break;
+        }
+    }
+
+    return centers;
+}
+
+// Decision values of the original model on the given features, using the batch kernels from svm_batch.h
+std::vector<double> originalDecisionValues(const SVMBatchModel& batch, const std::vector<FeatureData>& samples) {
+    int count = samples.size();
+    std::vector<float> normal_x(count), normal_y(count);
+    for (int i = 0; i < count; ++i) {
+        normal_x[i] = samples[i].normal_x;
+        normal_y[i] = samples[i].normal_y;
+    }
+
+    std::vector<double> values(count), labels(count);
+    predictBatch(batch, normal_x.data(), normal_y.data(), count, 1, values.data(), labels.data());
+    return values;
+}
+
+// Reduced-set compression of an RBF model to roughly sv_budget SVs (split between the classes by SV count)
+void compressRBF(const svm_model* original, int sv_budget, const std::vector<FeatureData>& fit_samples,
+                 const std::vector<double>& fit_targets, ReducedModel& reduced) {
+    std::mt19937 generator(42);
+    std::vector<Eigen::Vector2d> centers;
+    std::vector<double> coef;
+    int class0_count = 0;
+
+    int start = 0;
+    for (int cls = 0; cls < 2; ++cls) {
+        int count = original->nSV[cls];
+        int budget = std::max(1, static_cast<int>(std::round(static_cast<double>(sv_budget) * count / original->l)));
+
+        std::vector<Eigen::Vector2d> points(count, Eigen::Vector2d::Zero());
+        std::vector<double> weights(count);
+        for (int i = 0; i < count; ++i) {
+            for (const svm_node* node = original->SV[start + i]; node->index != -1; ++node) {
+                if (node->index == 1 || node->index == 2) {
+                    points[i](node->index - 1) = node->value;
+                }
+            }
+            weights[i] = std::fabs(original->sv_coef[0][start + i]);
+        }
+
+        std::vector<int> assignment;
+        std::vector<Eigen::Vector2d> class_centers = weightedKMeans(points, weights, budget, assignment, generator);
+        std::vector<double> class_coef(class_centers.size(), 0.0);
+        for (int i = 0; i < count; ++i) {
+            class_coef[assignment[i]] += original->sv_coef[0][start + i];
+        }
+
+        for (size_t c = 0; c < class_centers.size(); ++c) {
+            if (class_coef[c] != 0.0) {
+                centers.push_back(class_centers[c]);
+                coef.push_back(class_coef[c]);
+            }
+        }
+        if (cls == 0) {
+            class0_count = centers.size();
+        }
+        start += count;
+    }
+
+    for (Eigen::Vector2d& center : centers) {
+        center = Eigen::Vector2d(roundToSavedPrecision(center.x()), roundToSavedPrecision(center.y()));
+    }
+
+    // Refit the coefficients: min ||K beta - (f + rho)||^2 over the fit samples. Nearby centers give nearly
+    // collinear kernel columns, so the design matrix is solved by column-pivoted QR (as in svm_random_features.h)
+    // rather than through the normal equations, which square its condition number.
+    const double gamma = original->param.gamma;
+    int rows = fit_samples.size();
+    int cols = centers.size();
+    if (rows > 0 && fit_targets.size() != fit_samples.size()) {
+        std::cerr << "No decision values of the original model to refit against, keeping the aggregated coefficients." << std::endl;
+    } else if (rows > 0) {
+        Eigen::MatrixXd kernel(rows, cols);
+        Eigen::VectorXd target(rows);
+
+        #pragma omp parallel for
+        for (int j = 0; j < rows; ++j) {
+            Eigen::Vector2d sample(fit_samples[j].normal_x, fit_samples[j].normal_y);
+            for (int k = 0; k < cols; ++k) {
+                kernel(j, k) = std::exp(-gamma * (sample - centers[k]).squaredNorm());
+            }
+            target(j) = fit_targets[j] + original->rho[0];
+        }
+
+        Eigen::VectorXd beta = kernel.colPivHouseholderQr().solve(target);
+
+        if (beta.allFinite()) {
+            for (int k = 0; k < cols; ++k) {
+                coef[k] = beta(k);
+            }
+        } else {
+            std::cerr << "Coefficient refit failed, keeping the aggregated coefficients." << std::endl;
+        }
+    }
+
+    assembleModel(original, centers, coef, class0_count, reduced);
+}
+
+// ----------------------------------------------------------------------------------
+// EVALUATION
+// ----------------------------------------------------------------------------------
+
+CompressionReport evaluateModel(const svm_model* model, const std::vector<FeatureData>& test_data, int latency_samples) {
+    CompressionReport report;
+
+    int correct_predictions = 0;
+    SVMBatchModel batch;
+    if (buildSVMBatchModel(model, batch)) {
+        std::vector<double> values = originalDecisionValues(batch, test_data);
+        for (size_t i = 0; i < test_data.size(); ++i) {
+            double label = (values[i] > 0) ? batch.label_positive : batch.label_negative;
+            if (label == test_data[i].label) {
+                correct_predictions++;
+            }
+        }
+    } else {
+        #pragma omp parallel for reduction(+:correct_predictions)
+        for (int i = 0; i < static_cast<int>(test_data.size()); ++i) {
+            svm_node nodes[3];
+            nodes[0].index = 1;
+            nodes[0].value = test_data[i].normal_x;
+            nodes[1].index = 2;
+            nodes[1].value = test_data[i].normal_y;
+            nodes[2].index = -1;
+            if (svm_predict(model, nodes) == test_data[i].label) {
+                correct_predictions++;
+            }
+        }
+    }
+    report.accuracy = test_data.empty() ? 0.0 : static_cast<double>(correct_predictions) / test_data.size();
+
+    // Latency of plain svm_predict, as model_predicting pays it without the batch or lookup table paths
+    int count = std::min(latency_samples, static_cast<int>(test_data.size()));
+    volatile double sink = 0.0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < count; ++i) {
+        svm_node nodes[3];
+        nodes[0].index = 1;
+        nodes[0].value = test_data[i].normal_x;
+        nodes[1].index = 2;
+        nodes[1].value = test_data[i].normal_y;
+        nodes[2].index = -1;
+        sink = sink + svm_predict(model, nodes);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+    report.latency_per_point = (count > 0) ? elapsed.count() / count : 0.0;
+
+    return report;
+}
+
+int main(int argc, char** argv) {
+    std::string input_path = "/home/shovon/Desktop/catkin_ws/src/stat_analysis/model_results/terrain_classification/terrain_classification_cyglidar_model_svm_rbf.model";
+    std::string output_path = "/home/shovon/Desktop/catkin_ws/src/stat_analysis/model_results/terrain_classification/terrain_classification_cyglidar_model_svm_rbf_compressed.model";
+    int target_sv = 256;
+    double tolerance = 0.005; // Allowed held-out accuracy drop (absolute)
+    int max_sv = 4096;        // Largest budget tried before giving up
+    std::string plain_csv = "/home/shovon/Desktop/catkin_ws/src/stat_analysis/features_csv_files/cyglidar_plain_terrain_features.csv";
+    std::string grass_csv = "/home/shovon/Desktop/catkin_ws/src/stat_analysis/features_csv_files/cyglidar_grass_terrain_features.csv";
+
+    if (argc > 1) input_path = argv[1];
+    if (argc > 2) output_path = argv[2];
+    if (argc > 3) target_sv = std::stoi(argv[3]);
+    if (argc > 4) tolerance = std::stod(argv[4]);
+    if (argc > 6) {
+        plain_csv = argv[5];
+        grass_csv = argv[6];
+    }
+    if (argc > 7) max_sv = std::stoi(argv[7]);
+
+    svm_model* original = svm_load_model(input_path.c_str());
+    if (original == nullptr) {
+        std::cerr << "Failed to load model from " << input_path << std::endl;
+        return 1;
+    }
+    if (original->nr_class != 2 || (original->param.kernel_type != LINEAR && original->param.kernel_type != RBF)) {
+        std::cerr << "Only two-class linear and RBF models are supported." << std::endl;
+        svm_free_and_destroy_model(&original);
+        return 1;
+    }
+    std::cout << "Loaded " << input_path << " with " << original->l << " support vectors." << std::endl;
+
+    // Held-out split: 80% of the features drive the coefficient refit, 20% measure accuracy
+    std::vector<FeatureData> all_data = loadCSV(plain_csv, 0);
+    std::vector<FeatureData> grass_data = loadCSV(grass_csv, 1);
+    all_data.insert(all_data.end(), grass_data.begin(), grass_data.end());
+    if (all_data.empty()) {
+        std::cerr << "No feature data loaded, cannot measure held-out accuracy." << std::endl;
+        svm_free_and_destroy_model(&original);
+        return 1;
+    }
+    std::shuffle(all_data.begin(), all_data.end(), std::mt19937{7});
+    size_t split = all_data.size() * 8 / 10;
+    std::vector<FeatureData> fit_data(all_data.begin(), all_data.begin() + split);
+    std::vector<FeatureData> test_data(all_data.begin() + split, all_data.end());
+
+    const size_t max_fit_samples = 20000; // Rows of the least-squares system
+    if (fit_data.size() > max_fit_samples) {
+        fit_data.resize(max_fit_samples);
+    }
+
+    const int latency_samples = 1000;
+    CompressionReport before = evaluateModel(original, test_data, latency_samples);
+    std::cout << "Original:   " << original->l << " SVs, held-out accuracy " << before.accuracy
+              << ", latency " << before.latency_per_point * 1e6 << " us/point" << std::endl;
+
+    std::vector<double> fit_targets;
+    SVMBatchModel original_batch;
+    if (original->param.kernel_type == RBF && buildSVMBatchModel(original, original_batch)) {
+        fit_targets = originalDecisionValues(original_batch, fit_data);
+    }
+
+    if (original->param.kernel_type == RBF && fit_targets.empty()) {
+        std::cerr << "Could not evaluate the original model on the fit samples, the coefficients are not refit." << std::endl;
+    }
+
+    // Budgets beyond the refit rows or the original SV count do not compress anything
+    const int max_budget = std::min({max_sv, static_cast<int>(fit_data.size()), original->l - 1});
+    ReducedModel reduced;
+    CompressionReport after = before;
+    bool within_tolerance = false;
+    for (int budget = std::max(1, std::min(target_sv, max_budget)); ; budget = std::min(2 * budget, max_budget)) {
+        if (original->param.kernel_type == LINEAR) {
+            compressLinear(original, reduced);
+        } else {
+            compressRBF(original, budget, fit_data, fit_targets, reduced);
+        }
+
+        after = evaluateModel(&reduced.model, test_data, latency_samples);
+        std::cout << "Budget " << budget << ": " << reduced.model.l << " SVs, held-out accuracy " << after.accuracy << std::endl;
+
+        within_tolerance = before.accuracy - after.accuracy <= tolerance;
+        // The linear collapse is exact and does not depend on the budget
+        if (within_tolerance || original->param.kernel_type == LINEAR || budget >= max_budget) {
+            break;
+        }
+    }
+
+    if (!within_tolerance) {
+        std::cerr << "No budget up to " << max_budget << " SVs keeps the held-out accuracy within " << tolerance
+                  << " of the original (best " << after.accuracy << " vs " << before.accuracy << "); nothing written." << std::endl;
+        svm_free_and_destroy_model(&original);
+        return 1;
+    }
+
+    if (svm_save_model(output_path.c_str(), &reduced.model) != 0) {
+        std::cerr << "Failed to save compressed model to " << output_path << std::endl;
+        svm_free_and_destroy_model(&original);
+        return 1;
+    }
+
+    // Reload through libsvm to make sure the written file is what model_predicting will see
+    svm_model* reloaded = svm_load_model(output_path.c_str());
+    if (reloaded == nullptr) {
+        std::cerr << "Saved model could not be reloaded: " << output_path << std::endl;
+        svm_free_and_destroy_model(&original);
+        return 1;
+    }
+    after = evaluateModel(reloaded, test_data, latency_samples);
+    if (before.accuracy - after.accuracy > tolerance) {
+        std::cerr << "Reloaded model misses the tolerance (held-out accuracy " << after.accuracy << " vs " << before.accuracy
+                  << "); removing " << output_path << std::endl;
+        std::remove(output_path.c_str());
+        svm_free_and_destroy_model(&reloaded);
+        svm_free_and_destroy_model(&original);
+        return 1;
+    }
+
+    std::cout << "Compressed: " << reloaded->l << " SVs, held-out accuracy " << after.accuracy
+              << ", latency " << after.latency_per_point * 1e6 << " us/point" << std::endl;
+    std::cout << "Accuracy change: " << after.accuracy - before.accuracy
+              << ", speedup: " << before.latency_per_point / after.latency_per_point << "x" << std::endl;
+    std::cout << "Compressed model saved to: " << output_path << std::endl;
+
+    svm_free_and_destroy_model(&reloaded);
+    svm_free_and_destroy_model(&original);
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <svm.h>
+
+#include "svm_batch.h"
+#include "svm_binary_model.h"
+
+// Converts a libsvm text model into the binary format read by model_predicting (svm_binary_model.h) and
+// compares the two formats: load time and the latency of the first frame predicted right after loading.
+// Usage: model_converter <input.model> [output.bin] [points_per_frame]
+
+double secondsSince(const std::chrono::high_resolution_clock::time_point& start) {
+    return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: model_converter <input.model> [output.bin] [points_per_frame]" << std::endl;
+        return 1;
+    }
+
+    std::string input_path = argv[1];
+    std::string output_path = (argc > 2) ? argv[2] : input_path + ".bin";
+    int frame_points = (argc > 3) ? std::stoi(argv[3]) : 1000;
+
+    // Text format: parse with libsvm
+    auto start = std::chrono::high_resolution_clock::now();
+    svm_model* model = svm_load_model(input_path.c_str());
+    if (model == nullptr) {
+        std::cerr << "Failed to load model from " << input_path << std::endl;
+        return 1;
+    }
+    SVMBatchModel text_batch;
+    if (!buildSVMBatchModel(model, text_batch)) {
+        std::cerr << "Only two-class linear/RBF models over normal_x and normal_y can be converted." << std::endl;
+        svm_free_and_destroy_model(&model);
+        return 1;
+    }
+    double text_load_time = secondsSince(start);
+
+    if (!writeBinaryModel(text_batch, model->param.svm_type, output_path)) {
+        std::cerr << "Failed to write binary model to " << output_path << std::endl;
+        svm_free_and_destroy_model(&model);
+        return 1;
+    }
+    std::cout << "Converted " << input_path << " (" << text_batch.num_sv << " SVs) to " << output_path << std::endl;
+
+    // Binary format: mmap, no parse
+    start = std::chrono::high_resolution_clock::now();
+    MappedSVMModel mapping;
+    SVMBatchModel binary_batch;
+    std::string error;
+    if (!mapBinaryModel(output_path, mapping, binary_batch, error)) {
+        std::cerr << "Failed to map " << output_path << ": " << error << std::endl;
+        svm_free_and_destroy_model(&model);
+        return 1;
+    }
+    double binary_load_time = secondsSince(start);
+
+    // One synthetic frame of normals, predicted right after loading each format
+    std::mt19937 generator(42);
+    std::normal_distribution<float> distribution(0.0f, 0.4f);
+    std::vector<float> normal_x(frame_points), normal_y(frame_points);
+    for (int i = 0; i < frame_points; ++i) {
+        normal_x[i] = std::min(1.0f, std::max(-1.0f, distribution(generator)));
+        normal_y[i] = std::min(1.0f, std::max(-1.0f, distribution(generator)));
+    }
+
+    std::vector<double> text_values(frame_points), text_labels(frame_points);
+    start = std::chrono::high_resolution_clock::now();
+    predictBatch(text_batch, normal_x.data(), normal_y.data(), frame_points, 1, text_values.data(), text_labels.data());
+    double text_frame_time = secondsSince(start);
+
+    std::vector<double> binary_values(frame_points), binary_labels(frame_points);
+    start = std::chrono::high_resolution_clock::now();
+    predictBatch(binary_batch, normal_x.data(), normal_y.data(), frame_points, 1, binary_values.data(), binary_labels.data());
+    double binary_frame_time = secondsSince(start);
+
+    int label_mismatches = 0;
+    double max_difference = 0.0;
+    for (int i = 0; i < frame_points; ++i) {
+        max_difference = std::max(max_difference, std::fabs(text_values[i] - binary_values[i]));
+        if (text_labels[i] != binary_labels[i]) {
+            label_mismatches++;
+        }
+    }
+
+    std::cout << "Text model:   load " << text_load_time << " s, first frame (" << frame_points << " points) " << text_frame_time
+              << " s, startup to first result " << text_load_time + text_frame_time << " s" << std::endl;
+    std::cout << "Binary model: load " << binary_load_time << " s, first frame (" << frame_points << " points) " << binary_frame_time
+              << " s, startup to first result " << binary_load_time + binary_frame_time << " s" << std::endl;
+    std::cout << "Load speedup: " << text_load_time / binary_load_time << "x, max decision difference " << max_difference
+              << ", label mismatches " << label_mismatches << std::endl;
+
+    svm_free_and_destroy_model(&model);
+    return 0;
+}
@@ -42,15 +42,31 @@
 #include <iostream>
 #include <sstream>
 #include <fstream> // For file operations
+#include <ctime>
 #include <filesystem> // For checking folder existence
 #include <sys/stat.h> // For checking folder existence on some systems
 #include <chrono> // For timestamps
 #include <random>
+#include <numeric>
 #include <iomanip> // For formatting output
 #include <sys/sysinfo.h> // For CPU/GPU utilization
 
 #include <omp.h> // OpenMP for parallel processing
 #include <svm.h> // SVM Model Library: LibSVM
+#include "svm_batch.h" // SoA + SIMD batch inference for RBF models
+#include "svm_binary_model.h" // Memory-mapped binary model format
+#include "svm_random_features.h" // Explicit random feature approximation of RBF models
+#include "svm_quantized.h" // Float32 and int16 fixed-point RBF inference
+#include "decision_lut.h" // Bilinear decision function lookup table over normal_x/normal_y
+#include "cloud_filters.h" // Fused crop box + voxel grid downsampling
+#include "cloud_ingest.h" // Crop while reading PointCloud2 messages, without fromROSMsg
+#include "allocation_counter.h" // Heap allocations per pipeline stage
+#include "latency_budget.h" // Leaf size and neighbour count adjusted to a per-frame deadline
+#include "normal_neighbourhood.h" // Capped k or leaf-sized radius for normal estimation
+#include "voxel_hash_search.h" // Uniform grid hash neighbour search for voxelized clouds
+#include "range_image.h" // Organized ring x azimuth image of the scan
+#include "integral_normals.h" // Normals from summed-area tables over the range image
+#include <stat_analysis/TerrainGrid.h> // Per-cell terrain class message
 
 
 // ROS Publishers
@@ -61,6 +77,9 @@ ros::Publisher pub_after_combined_passthrough;
 // Parralel Downsampling
 ros::Publisher pub_after_parallel_downsampling;
 
+// Per-cell terrain classes for planners
+ros::Publisher pub_terrain_grid;
+
 // Path to save the results: Asus Laptop Directories
 std::string FOLDER_PATH = "/home/shovon/Desktop/catkin_ws/src/stat_analysis/model_results/terrain_classification/performance_metrics/"; // Path for Asus Laptop
 
@@ -79,6 +98,54 @@ std::ofstream file;  // Declare the file variable
 
 int expected_label = 1; // expected_label for grass = 1, plain = 0
 
+// Crop box of combinedPassthroughFilter; the terrain grid covers its XY extent
+const float CROP_MIN_X = 1.5f, CROP_MAX_X = 3.0f;
+const float CROP_MIN_Y = -0.6f, CROP_MAX_Y = 0.6f;
+const float CROP_MIN_Z = -0.7f, CROP_MAX_Z = 0.2f;
+
+// Leaf size of the voxel grid downsampling
+const float LEAF_SIZE_X = 0.13f, LEAF_SIZE_Y = 0.13f, LEAF_SIZE_Z = 0.05f;
+
+// Crop while reading the message (cloud_ingest.h) and downsample the survivors (cloud_filters.h) instead of
+// fromROSMsg + PassThrough x3 + VoxelGrid. Same output either way.
+bool use_fused_crop_voxel = true;
+
+// Without the fused path: also run the sequential voxel grid and log the parallel one's speedup and agreement
+bool compare_parallel_downsampling = false;
+
+// Startup timing: node start to the first classified frame, to compare text and binary model formats
+std::chrono::high_resolution_clock::time_point node_start_time;
+bool first_frame_logged = false;
+
+// Neighbourhood of the normal estimation (normal_neighbourhood.h). CloudFraction is k = N/5, the normals the
+// model was trained on; switch terrain.cpp to the same mode before retraining with a bounded one.
+NormalNeighbourhoodConfig normal_neighbourhood;
+
+// Neighbour search of the normal estimation: a KdTree, or a uniform grid hash (voxel_hash_search.h) with cells
+// sized to the leaf or the search radius. Both return the exact neighbours, so the normals are the same.
+// KdTree stays the default until search_benchmark numbers on recorded frames back the switch
+// (test/test_voxel_hash_search.cpp checks the exactness).
+enum class NeighbourSearch { KdTree, VoxelHash };
+NeighbourSearch neighbour_search = NeighbourSearch::KdTree;
+
+// Normal estimation method. KdTree: the voxel grid downsampled cloud and a neighbour search (the settings above),
+// which is what the model is trained on. IntegralImage: the crop box is read into a range image (range_image.h)
+// and every pixel gets its normal from integral images (integral_normals.h), with no downsampling and no neighbour
+// search; the pixels with a valid normal are the points classified. terrain.cpp has the same switch for the
+// training features. The latency budget has no knob on this path, the window size is set by integral_normal_config.
+enum class NormalMethod { KdTree, IntegralImage };
+NormalMethod normal_method = NormalMethod::KdTree;
+RangeImageConfig range_image_config;
+IntegralImageNormalConfig integral_normal_config;
+
+// Latency budget (latency_budget.h): the leaf size and the neighbour count of the normal estimation are adjusted
+// after every frame to hold latency_budget_config.deadline. When both are at their bounds and frames still run
+// late, prediction falls back to early-exit classification (see use_early_exit) until the budget has room again.
+// The settings every frame ran with and the adjustment made after it are logged next to the CSV timing columns.
+bool use_latency_budget = false;
+LatencyBudgetConfig latency_budget_config;
+LatencyBudgetState latency_budget;
+
 
 // ----------------------------------------------------------------------------------
 // PREPROCESSING STEPS
@@ -98,18 +165,18 @@ pcl::PointCloud<pcl::PointXYZ>::Ptr combinedPassthroughFilter(const pcl::PointCl
     pass.setInputCloud(cloud);
     
     pass.setFilterFieldName("z");
-    pass.setFilterLimits(-0.7, 0.2);
+    pass.setFilterLimits(CROP_MIN_Z, CROP_MAX_Z);
     pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_filtered(new pcl::PointCloud<pcl::PointXYZ>);
     pass.filter(*cloud_filtered);
 
     pass.setInputCloud(cloud_filtered);
     pass.setFilterFieldName("x");
-    pass.setFilterLimits(1.5, 3);
+    pass.setFilterLimits(CROP_MIN_X, CROP_MAX_X);
     pass.filter(*cloud_filtered);
 
     pass.setInputCloud(cloud_filtered);
     pass.setFilterFieldName("y");
-    pass.setFilterLimits(-0.6, 0.6);
+    pass.setFilterLimits(CROP_MIN_Y, CROP_MAX_Y);
     pass.filter(*cloud_filtered);
 
     return cloud_filtered;
@@ -128,22 +195,45 @@ pcl::PointCloud<pcl::PointXYZ>::Ptr voxelGridDownsampling(const pcl::PointCloud<
     return cloud_downsampled;
 }
 
-// Parallelize Downsampling using OpenMP
+// Parallelize Downsampling using OpenMP: thread-local voxel maps merged in voxel order (cloud_filters.h)
 pcl::PointCloud<pcl::PointXYZ>::Ptr parallelVoxelGridDownsampling(const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud, float leaf_size_x, float leaf_size_y, float leaf_size_z) {
-    pcl::VoxelGrid<pcl::PointXYZ> voxel_grid;
-    
-    voxel_grid.setInputCloud(cloud);
-    voxel_grid.setLeafSize(leaf_size_x, leaf_size_y, leaf_size_z);
+    CloudSoA points;
+    cloudToSoA(*cloud, points);
 
     pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_downsampled(new pcl::PointCloud<pcl::PointXYZ>);
-    
-    #pragma omp parallel
-    {
-        voxel_grid.filter(*cloud_downsampled);
-    }
+    cloud_downsampled->header = cloud->header;
+    parallelVoxelGridDownsample(points, leaf_size_x, leaf_size_y, leaf_size_z, *cloud_downsampled);
+
     return cloud_downsampled;
 }
 
+// Voxel count and largest centroid difference between the normal and parallel downsampling of one frame
+void logDownsamplingAgreement(const pcl::PointCloud<pcl::PointXYZ>::Ptr& normal, const pcl::PointCloud<pcl::PointXYZ>::Ptr& parallel) {
+    if (normal->points.size() != parallel->points.size()) {
+        ROS_WARN("Parallel Downsampling: %ld voxels, normal: %ld", parallel->points.size(), normal->points.size());
+        return;
+    }
+    float max_difference = 0.0f;
+    int identical = 0;
+    for (size_t i = 0; i < normal->points.size(); ++i) {
+        float difference = (normal->points[i].getVector3fMap() - parallel->points[i].getVector3fMap()).cwiseAbs().maxCoeff();
+        max_difference = std::max(max_difference, difference);
+        identical += (difference == 0.0f) ? 1 : 0;
+    }
+    ROS_INFO("Parallel Downsampling: %d/%ld centroids bit-identical, max difference %g m", identical, normal->points.size(), max_difference);
+}
+
+// Crop box applied while reading the message, then voxel grid over the survivors only.
+// Survivors, sort buffer and output are the caller's, so they keep their capacity from frame to frame.
+void cropVoxelGridDownsampling(const sensor_msgs::PointCloud2ConstPtr& input_msg, float leaf_size_x, float leaf_size_y, float leaf_size_z,
+                               CloudSoA& survivors, VoxelGridWorkspace& workspace, pcl::PointCloud<pcl::PointXYZ>& cloud_downsampled) {
+    const CropBox crop_box = {CROP_MIN_X, CROP_MAX_X, CROP_MIN_Y, CROP_MAX_Y, CROP_MIN_Z, CROP_MAX_Z};
+    readPointCloud2(*input_msg, crop_box, survivors);
+
+    pcl_conversions::toPCL(input_msg->header, cloud_downsampled.header);
+    voxelGridDownsample(survivors, leaf_size_x, leaf_size_y, leaf_size_z, cloud_downsampled, workspace);
+}
+
 // ----------------------------------------------------------------------------------
 // NORMAL EXTRACTION
 // ----------------------------------------------------------------------------------
@@ -197,6 +287,42 @@ pcl::PointCloud<pcl::Normal>::Ptr computeNormalsParallel(const pcl::PointCloud<p
     return normals;
 }
 
+// Same, with a normal estimator and search tree that live across frames: the estimator keeps its index buffer
+// and the normals keep their capacity. The search structure (KdTree or VoxelHashSearch) is rebuilt here on every
+// call: the estimator itself only rebuilds it when the cloud pointer changes, and the pipeline passes the same
+// cloud every frame.
+// The neighbourhood is a k or a radius (normal_neighbourhood.h); radius searches that leave a point with too
+// few neighbours get that normal from its min_k nearest neighbours.
+void computeNormalsParallel(const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud, const NormalNeighbourhood& neighbourhood, int min_k,
+                            pcl::NormalEstimationOMP<pcl::PointXYZ, pcl::Normal>& ne,
+                            const pcl::search::Search<pcl::PointXYZ>::Ptr& tree, pcl::PointCloud<pcl::Normal>& normals) {
+    normals.points.clear();
+    if (neighbourhood.k <= 0 && neighbourhood.radius <= 0.0) {
+        ROS_ERROR("Invalid neighbourhood: k %d, radius %f", neighbourhood.k, neighbourhood.radius);
+        return;
+    }
+
+    tree->setInputCloud(cloud);
+    ne.setInputCloud(cloud);
+    ne.setSearchMethod(tree);
+    setNormalNeighbourhood(ne, neighbourhood);
+    ne.compute(normals);
+    if (neighbourhood.radius > 0.0) {
+        fillIsolatedNormals(*cloud, *tree, min_k, normals);
+    }
+
+    ROS_INFO("Computed Normals (Parallel): %ld", normals.points.size());
+}
+
+// Same from the integral images of a range image (integral_normals.h). cloud and normals receive the pixels that
+// got a normal, so like the outputs above they have the same size and no NaN normal.
+void computeNormals(const RangeImage& image, const IntegralImageNormalConfig& config, IntegralImageNormalWorkspace& workspace,
+                    pcl::PointCloud<pcl::Normal>& organized_normals, pcl::PointCloud<pcl::PointXYZ>& cloud, pcl::PointCloud<pcl::Normal>& normals) {
+    integralImageNormals(image, config, workspace, organized_normals);
+    int dropped = compactNormals(image, organized_normals, cloud, normals);
+
+    ROS_INFO("Computed Normals (Integral Image): %ld of %d pixels, %d without a valid window", normals.points.size(), image.filled_pixels, dropped);
+}
 
 
 // Normal Visualization
@@ -223,51 +349,680 @@ struct FeatureData {
     double normal_y;
 };
 
-svm_model* model; // Model Initialization
+svm_model* model = nullptr; // Model Initialization (stays null when a binary model is mapped)
+MappedSVMModel binary_model_mapping; // Mapping of a binary model (*.bin written by model_converter)
+
+// Linear kernel fast path: a linear SVM reduces to w.x - rho, so the support vectors are
+// collapsed into a single weight vector once at load time instead of walked for every normal
+bool use_linear_fast_path = false;
+std::vector<double> linear_weights; // linear_weights[i] is the weight of feature index i + 1
+double linear_rho = 0.0;
+
+// Collapses the support vectors of a two-class linear model into a weight vector
+bool buildLinearWeights(const svm_model* svm) {
+    if (svm->param.kernel_type != LINEAR || svm->nr_class != 2 ||
+        (svm->param.svm_type != C_SVC && svm->param.svm_type != NU_SVC)) {
+        return false;
+    }
+
+    linear_weights.clear();
+    for (int i = 0; i < svm->l; ++i) {
+        double coef = svm->sv_coef[0][i];
+        for (const svm_node* node = svm->SV[i]; node->index != -1; ++node) {
+            if (node->index > static_cast<int>(linear_weights.size())) {
+                linear_weights.resize(node->index, 0.0);
+            }
+            linear_weights[node->index - 1] += coef * node->value;
+        }
+    }
+    linear_rho = svm->rho[0];
+
+    return true;
+}
+
+// Batch inference: RBF models are copied into SoA form and evaluated a block of points at a time with SIMD.
+// The SoA model also feeds the lookup table bake. Binary models are always served by the batch model,
+// whose arrays point straight into the mapping.
+bool use_batch_inference = true;
+bool batch_model_ready = false;
+SVMBatchModel batch_model;
+
+// Reduced precision for embedded (Jetson) deployments: the RBF batch model is converted to float32 or
+// int16 fixed point (svm_quantized.h) and served by that kernel instead of the double one. Selecting Float32 or
+// Int16 skips the lookup table, so the validated precision is the one that serves; random features, when enabled,
+// still take precedence.
+SVMPrecision model_precision = SVMPrecision::Double;
+bool validate_model_precision = true; // Compare every precision against the double reference on the feature CSVs at load
+bool quantized_model_ready = false;
+SVMFloatModel float_model;
+SVMInt16Model int16_model;
+
+// Batch decision values and labels with the kernel of the selected precision (strided like predictBatch)
+void predictBatchSelected(const float* normal_x, const float* normal_y, int count, int stride, double* decision_values, double* labels) {
+    if (quantized_model_ready && model_precision == SVMPrecision::Float32) {
+        predictFloat(float_model, normal_x, normal_y, count, stride, decision_values, labels);
+    } else if (quantized_model_ready && model_precision == SVMPrecision::Int16) {
+        predictInt16(int16_model, normal_x, normal_y, count, stride, decision_values, labels);
+    } else {
+        predictBatch(batch_model, normal_x, normal_y, count, stride, decision_values, labels);
+    }
+}
+
+// SV count and rho of the loaded model, whichever format it came from
+int modelNumSV() {
+    return (model != nullptr) ? model->l : batch_model.num_sv;
+}
+
+double modelRho() {
+    return (model != nullptr) ? model->rho[0] : batch_model.rho;
+}
+
+// Two-class label for a decision value: the first label wins when it is positive, as in svm_predict_values
+double labelFromDecision(double decision_value) {
+    if (model != nullptr) {
+        return (decision_value > 0) ? model->label[0] : model->label[1];
+    }
+    return (decision_value > 0) ? batch_model.label_positive : batch_model.label_negative;
+}
+
+// Maps a binary model: no text parsing, the SV arrays are used in place
+void loadBinarySVMModel(const std::string& model_path) {
+    std::string error;
+    if (!mapBinaryModel(model_path, binary_model_mapping, batch_model, error)) {
+        ROS_ERROR("Failed to map binary model from %s: %s", model_path.c_str(), error.c_str());
+        exit(EXIT_FAILURE);
+    }
+    batch_model_ready = true;
+
+    use_linear_fast_path = (batch_model.kernel_type == LINEAR);
+    if (use_linear_fast_path) {
+        linear_weights = {batch_model.weight_x, batch_model.weight_y};
+        linear_rho = batch_model.rho;
+    }
+
+    ROS_INFO("Binary SVM model mapped from %s: %d support vectors, %s kernel", model_path.c_str(),
+             batch_model.num_sv, svmBatchISAName(batch_model.isa));
+}
 
 // Function to load the SVM model
 void loadSVMModel(const std::string& model_path) {
     ROS_INFO("Attempting to load SVM model from: %s", model_path.c_str());
 
-    model = svm_load_model(model_path.c_str());
-    
-    if (model == nullptr) {
-        ROS_ERROR("Failed to load model from %s", model_path.c_str());
-        exit(EXIT_FAILURE);
+    auto load_start = std::chrono::high_resolution_clock::now();
+
+    if (isBinaryModelPath(model_path)) {
+        loadBinarySVMModel(model_path);
     } else {
-        ROS_INFO("SVM model loaded successfully from: %s", model_path.c_str());
+        model = svm_load_model(model_path.c_str());
+
+        if (model == nullptr) {
+            ROS_ERROR("Failed to load model from %s", model_path.c_str());
+            exit(EXIT_FAILURE);
+        } else {
+            ROS_INFO("SVM model loaded successfully from: %s", model_path.c_str());
+        }
+
+        use_linear_fast_path = buildLinearWeights(model);
+        if (use_linear_fast_path) {
+            ROS_INFO("Linear kernel detected: collapsed %d support vectors into %ld weights (rho = %f)",
+                     model->l, linear_weights.size(), linear_rho);
+        }
+
+        batch_model_ready = model->param.kernel_type == RBF && buildSVMBatchModel(model, batch_model);
+        if (batch_model_ready && use_batch_inference) {
+            ROS_INFO("RBF batch inference enabled: %d support vectors, %s kernel", batch_model.num_sv, svmBatchISAName(batch_model.isa));
+        }
     }
+
+    std::chrono::duration<double> load_time = std::chrono::high_resolution_clock::now() - load_start;
+    ROS_INFO("Model load time: %f seconds", load_time.count());
 }
 
+// Predicts the label of one feature vector with the exact model and optionally returns its decision value.
+// The linear fast path reproduces svm_predict_values for two-class models: the first label
+// wins when the decision value is positive, the second one otherwise.
+double predictLabelExact(const svm_node* nodes, double* decision_value = nullptr) {
+    if (use_linear_fast_path) {
+        double sum = 0.0;
+        for (const svm_node* node = nodes; node->index != -1; ++node) {
+            if (node->index <= static_cast<int>(linear_weights.size())) {
+                sum += linear_weights[node->index - 1] * node->value;
+            }
+        }
+        sum -= linear_rho;
 
-// Function to extract features and predict the terrain type
-double predictTerrainType(const pcl::PointCloud<pcl::Normal>::Ptr& cloud_normals, int expected_label) {
-    int correct_predictions = 0;
-    int total_points = cloud_normals->points.size();
+        if (decision_value != nullptr) {
+            *decision_value = sum;
+        }
+        return labelFromDecision(sum);
+    }
 
-    // auto start = std::chrono::high_resolution_clock::now();
+    // Reduced-precision models and binary models (which carry no libsvm model) evaluate their own SV arrays
+    if (quantized_model_ready || model == nullptr) {
+        double features[2] = {0.0, 0.0};
+        for (const svm_node* node = nodes; node->index != -1; ++node) {
+            if (node->index == 1 || node->index == 2) {
+                features[node->index - 1] = node->value;
+            }
+        }
 
-    #pragma omp parallel for reduction(+:correct_predictions)
-    for (int i = 0; i < total_points; ++i) {
+        double value = 0.0;
+        if (quantized_model_ready && model_precision == SVMPrecision::Float32) {
+            value = decisionValueFloat(float_model, features[0], features[1]);
+        } else if (quantized_model_ready && model_precision == SVMPrecision::Int16) {
+            value = decisionValueInt16(int16_model, features[0], features[1]);
+        } else {
+            value = decisionValueSingle(batch_model, features[0], features[1]);
+        }
+        if (decision_value != nullptr) {
+            *decision_value = value;
+        }
+        return labelFromDecision(value);
+    }
+
+    if (decision_value == nullptr) {
+        return svm_predict(model, nodes);
+    }
+
+    std::vector<double> decision_values(model->nr_class * (model->nr_class - 1) / 2);
+    double label = svm_predict_values(model, nodes, decision_values.data());
+    *decision_value = decision_values[0];
+    return label;
+}
+
+
+// ----------------------------------------------------------------------------------
+// DECISION FUNCTION LOOKUP TABLE
+// ----------------------------------------------------------------------------------
+
+// The only features are normal_x and normal_y, both bounded in [-1, 1]. The decision function of a
+// two-class model is baked onto a (resolution + 1)^2 grid over that square and bilinearly interpolated,
+// so a prediction costs four table loads instead of one kernel evaluation per support vector.
+// Prediction paths, first ready one wins: random features > lookup table > reduced precision (model_precision)
+// > double SIMD batch > libsvm. The table is approximate and hides every path after it, so it is off by default
+// and not built when model_precision asks for Float32 or Int16.
+bool use_decision_lut = false;      // Bake and use the lookup table for RBF (and other non-linear) models
+int lut_resolution = 256;           // Grid cells per axis (257 x 257 floats = 264 KB)
+int lut_validation_samples = 20000; // Max CSV samples compared against the exact model (0 = all)
+
+// Feature CSVs (saved by terrain.cpp) used to report the lookup table error against the exact model
+std::vector<std::string> lut_validation_csvs = {
+    "/home/shovon/Desktop/catkin_ws/src/stat_analysis/features_csv_files/cyglidar_plain_terrain_features.csv",
+    "/home/shovon/Desktop/catkin_ws/src/stat_analysis/features_csv_files/cyglidar_grass_terrain_features.csv"
+};
+
+bool decision_lut_ready = false;
+std::vector<float> decision_lut; // Row-major, decision_lut[iy * (lut_resolution + 1) + ix]
+
+// Bilinear interpolation of the baked decision function (decision_lut.h). Features outside [-1, 1] are clamped,
+// non-finite features (NaN normals) get decision value 0.
+inline double lookupDecisionValue(double normal_x, double normal_y) {
+    return interpolateDecisionLUT(decision_lut.data(), lut_resolution, normal_x, normal_y);
+}
+
+// True if every support vector only uses feature 1 (normal_x) and feature 2 (normal_y)
+bool usesOnlyNormalFeatures(const svm_model* svm) {
+    for (int i = 0; i < svm->l; ++i) {
+        for (const svm_node* node = svm->SV[i]; node->index != -1; ++node) {
+            if (node->index != 1 && node->index != 2) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Bakes the exact decision function onto the grid nodes.
+// For RBF kernels exp(-g|x - s|^2) = exp(-g(x1 - s1)^2) * exp(-g(x2 - s2)^2), so the whole grid is
+// G = (A * diag(coef)) * B^T with A and B holding the per-axis factors. That turns the bake into a
+// blocked matrix product over the support vectors instead of grid_nodes x SVs exponentials.
+// RBF models are baked from the SoA batch model; other kernels go through predictLabelExact.
+void bakeDecisionLUT() {
+    const int nodes_per_row = lut_resolution + 1;
+    const double step = (LUT_MAX - LUT_MIN) / lut_resolution;
+
+    Eigen::VectorXd grid(nodes_per_row);
+    for (int i = 0; i < nodes_per_row; ++i) {
+        grid(i) = LUT_MIN + i * step;
+    }
+
+    // values(ix, iy) is the decision value at (grid(ix), grid(iy))
+    Eigen::MatrixXd values = Eigen::MatrixXd::Zero(nodes_per_row, nodes_per_row);
+
+    if (batch_model_ready && batch_model.kernel_type == RBF) {
+        const int block_size = 4096; // Support vectors per block, keeps A and B at ~8 MB each
+        const double gamma = batch_model.gamma;
+
+        for (int start = 0; start < batch_model.num_sv; start += block_size) {
+            int count = std::min(block_size, batch_model.num_sv - start);
+            Eigen::MatrixXd factors_x(nodes_per_row, count);
+            Eigen::MatrixXd factors_y(nodes_per_row, count);
+
+            #pragma omp parallel for
+            for (int k = 0; k < count; ++k) {
+                double coef = batch_model.coef[start + k];
+                double sv_x = batch_model.sv_x[start + k];
+                double sv_y = batch_model.sv_y[start + k];
+                for (int i = 0; i < nodes_per_row; ++i) {
+                    double dx = grid(i) - sv_x;
+                    double dy = grid(i) - sv_y;
+                    factors_x(i, k) = coef * std::exp(-gamma * dx * dx);
+                    factors_y(i, k) = std::exp(-gamma * dy * dy);
+                }
+            }
+
+            values.noalias() += factors_x * factors_y.transpose();
+        }
+        values.array() -= batch_model.rho;
+    } else {
+        #pragma omp parallel for collapse(2)
+        for (int iy = 0; iy < nodes_per_row; ++iy) {
+            for (int ix = 0; ix < nodes_per_row; ++ix) {
+                svm_node nodes[3];
+                nodes[0].index = 1;
+                nodes[0].value = grid(ix);
+                nodes[1].index = 2;
+                nodes[1].value = grid(iy);
+                nodes[2].index = -1;
+                predictLabelExact(nodes, &values(ix, iy));
+            }
+        }
+    }
+
+    decision_lut.resize(nodes_per_row * nodes_per_row);
+    for (int iy = 0; iy < nodes_per_row; ++iy) {
+        for (int ix = 0; ix < nodes_per_row; ++ix) {
+            decision_lut[iy * nodes_per_row + ix] = static_cast<float>(values(ix, iy));
+        }
+    }
+}
+
+// The baked table is cached next to the model so that it is only computed once per model
+struct DecisionLUTHeader {
+    char magic[8];
+    int resolution;
+    int total_sv;
+    double rho;
+};
+
+bool loadDecisionLUTCache(const std::string& cache_path) {
+    std::ifstream cache(cache_path, std::ios::binary);
+    if (!cache) {
+        return false;
+    }
+
+    DecisionLUTHeader header;
+    cache.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!cache || std::string(header.magic, 7) != "SVMLUT1" || header.resolution != lut_resolution ||
+        header.total_sv != modelNumSV() || header.rho != modelRho()) {
+        return false;
+    }
+
+    decision_lut.resize((lut_resolution + 1) * (lut_resolution + 1));
+    cache.read(reinterpret_cast<char*>(decision_lut.data()), decision_lut.size() * sizeof(float));
+    return static_cast<bool>(cache);
+}
+
+void saveDecisionLUTCache(const std::string& cache_path) {
+    std::ofstream cache(cache_path, std::ios::binary | std::ios::trunc);
+    if (!cache) {
+        ROS_WARN("Could not write lookup table cache to %s", cache_path.c_str());
+        return;
+    }
+
+    DecisionLUTHeader header = {{'S', 'V', 'M', 'L', 'U', 'T', '1', '\0'}, lut_resolution, modelNumSV(), modelRho()};
+    cache.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    cache.write(reinterpret_cast<const char*>(decision_lut.data()), decision_lut.size() * sizeof(float));
+}
+
+// Loads NormalX and NormalY from a feature CSV written by terrain.cpp (X,Y,Z,NormalX,NormalY,NormalZ,...)
+std::vector<FeatureData> loadFeatureCSV(const std::string& filename) {
+    std::vector<FeatureData> data;
+    std::ifstream csv(filename);
+    std::string line;
+
+    if (!csv) {
+        ROS_WARN("Feature CSV not found: %s", filename.c_str());
+        return data;
+    }
+
+    // Skip header line
+    std::getline(csv, line);
+
+    while (std::getline(csv, line)) {
+        std::stringstream ss(line);
+        std::string token;
+
+        // Skip X, Y, Z columns
+        for (int i = 0; i < 3; ++i) {
+            std::getline(ss, token, ',');
+        }
+
+        FeatureData feature;
+        std::getline(ss, token, ',');
+        feature.normal_x = std::stod(token);
+        std::getline(ss, token, ',');
+        feature.normal_y = std::stod(token);
+
+        data.push_back(feature);
+    }
+
+    return data;
+}
+
+// Reports the maximum decision value error and label flip rate of the table against the exact model
+void validateDecisionLUT() {
+    std::vector<FeatureData> samples;
+    for (const auto& csv_path : lut_validation_csvs) {
+        std::vector<FeatureData> csv_samples = loadFeatureCSV(csv_path);
+        samples.insert(samples.end(), csv_samples.begin(), csv_samples.end());
+    }
+
+    if (samples.empty()) {
+        ROS_WARN("No feature CSVs available, skipping lookup table validation.");
+        return;
+    }
+
+    if (lut_validation_samples > 0 && static_cast<int>(samples.size()) > lut_validation_samples) {
+        std::shuffle(samples.begin(), samples.end(), std::mt19937{42});
+        samples.resize(lut_validation_samples);
+    }
+
+    int total_samples = samples.size();
+    int label_flips = 0;
+    double max_error = 0.0;
+    double total_error = 0.0;
+
+    #pragma omp parallel for reduction(+:label_flips, total_error) reduction(max:max_error)
+    for (int i = 0; i < total_samples; ++i) {
         svm_node nodes[3];
         nodes[0].index = 1;
-        nodes[0].value = cloud_normals->points[i].normal_x;
+        nodes[0].value = samples[i].normal_x;
         nodes[1].index = 2;
-        nodes[1].value = cloud_normals->points[i].normal_y;
-        nodes[2].index = -1; // End of features
+        nodes[1].value = samples[i].normal_y;
+        nodes[2].index = -1;
 
-        double label = svm_predict(model, nodes);
+        double exact_value = 0.0;
+        double exact_label = predictLabelExact(nodes, &exact_value);
+        double lut_value = lookupDecisionValue(samples[i].normal_x, samples[i].normal_y);
+        double lut_label = labelFromDecision(lut_value);
 
-        if (label == expected_label) {
-            correct_predictions++;
+        double error = fabs(exact_value - lut_value);
+        total_error += error;
+        max_error = std::max(max_error, error);
+        if (exact_label != lut_label) {
+            label_flips++;
+        }
+    }
+
+    ROS_INFO("Lookup table validation on %d samples: max decision error %f, mean decision error %f, label flip rate %f%%",
+             total_samples, max_error, total_error / total_samples, 100.0 * label_flips / total_samples);
+}
+
+// Bakes (or loads from cache) the lookup table for kernel models with the two normal features.
+// Linear models already have the weight vector fast path and skip the table.
+void buildDecisionLUT(const std::string& model_path) {
+    decision_lut_ready = false;
+
+    if (!use_decision_lut || use_linear_fast_path) {
+        return;
+    }
+    if (model_precision != SVMPrecision::Double) {
+        ROS_INFO("model_precision is %s, serving that kernel instead of the lookup table", svmPrecisionName(model_precision));
+        return;
+    }
+
+    // Binary models are always two-class over normal_x/normal_y; libsvm models are checked here
+    if (model != nullptr) {
+        if (model->param.kernel_type == PRECOMPUTED || model->nr_class != 2 ||
+            (model->param.svm_type != C_SVC && model->param.svm_type != NU_SVC)) {
+            return;
+        }
+        if (!usesOnlyNormalFeatures(model)) {
+            ROS_WARN("Model uses features other than normal_x/normal_y, lookup table disabled.");
+            return;
+        }
+    }
+
+    std::string cache_path = model_path + ".lut";
+    if (loadDecisionLUTCache(cache_path)) {
+        ROS_INFO("Loaded %dx%d decision lookup table from %s", lut_resolution, lut_resolution, cache_path.c_str());
+    } else {
+        auto bake_start = std::chrono::high_resolution_clock::now();
+        bakeDecisionLUT();
+        std::chrono::duration<double> bake_time = std::chrono::high_resolution_clock::now() - bake_start;
+        ROS_INFO("Baked %dx%d decision lookup table in %f seconds", lut_resolution, lut_resolution, bake_time.count());
+        saveDecisionLUTCache(cache_path);
+    }
+
+    decision_lut_ready = true;
+    validateDecisionLUT();
+}
+
+
+// ----------------------------------------------------------------------------------
+// RANDOM FEATURE APPROXIMATION
+// ----------------------------------------------------------------------------------
+
+// RBF models can be replaced by an explicit linear model over random_feature_dimension random Fourier
+// (or Nystroem) features, see svm_random_features.h. A prediction then costs random_feature_dimension
+// cos/exp evaluations regardless of the SV count. Takes precedence over the lookup table when enabled.
+bool use_random_features = false;
+RandomFeatureMethod random_feature_method = RandomFeatureMethod::Fourier;
+int random_feature_dimension = 256;
+int random_feature_fit_samples = 8000; // Points (from the SVs and the feature square) the weights are fit on
+
+bool random_features_ready = false;
+RandomFeatureModel random_feature_model;
+
+// Reports the approximation per model on the feature CSVs: decision error, accuracy delta against the
+// exact model (plain CSV = label 0, grass CSV = label 1, as in model_training.cpp) and the speedup
+void validateRandomFeatures() {
+    std::vector<float> normal_x, normal_y;
+    std::vector<int> true_labels;
+    for (size_t c = 0; c < lut_validation_csvs.size(); ++c) {
+        for (const auto& feature : loadFeatureCSV(lut_validation_csvs[c])) {
+            normal_x.push_back(feature.normal_x);
+            normal_y.push_back(feature.normal_y);
+            true_labels.push_back(static_cast<int>(c));
+        }
+    }
+
+    if (normal_x.empty()) {
+        ROS_WARN("No feature CSVs available, skipping random feature validation.");
+        return;
+    }
+
+    int total_samples = normal_x.size();
+    std::vector<double> exact_values(total_samples), exact_labels(total_samples), approx_values(total_samples);
+
+    auto exact_start = std::chrono::high_resolution_clock::now();
+    predictBatch(batch_model, normal_x.data(), normal_y.data(), total_samples, 1, exact_values.data(), exact_labels.data());
+    std::chrono::duration<double> exact_time = std::chrono::high_resolution_clock::now() - exact_start;
+
+    auto approx_start = std::chrono::high_resolution_clock::now();
+    #pragma omp parallel for
+    for (int i = 0; i < total_samples; ++i) {
+        approx_values[i] = randomFeatureDecision(random_feature_model, normal_x[i], normal_y[i]);
+    }
+    std::chrono::duration<double> approx_time = std::chrono::high_resolution_clock::now() - approx_start;
+
+    int exact_correct = 0, approx_correct = 0;
+    double max_error = 0.0;
+    #pragma omp parallel for reduction(+:exact_correct, approx_correct) reduction(max:max_error)
+    for (int i = 0; i < total_samples; ++i) {
+        max_error = std::max(max_error, fabs(exact_values[i] - approx_values[i]));
+        if (exact_labels[i] == true_labels[i]) {
+            exact_correct++;
+        }
+        if (randomFeatureLabel(random_feature_model, approx_values[i]) == true_labels[i]) {
+            approx_correct++;
+        }
+    }
+
+    double exact_accuracy = static_cast<double>(exact_correct) / total_samples;
+    double approx_accuracy = static_cast<double>(approx_correct) / total_samples;
+    ROS_INFO("Random features (%s, D = %d) on %d samples: max decision error %g, accuracy %f vs exact %f (delta %+f), "
+             "speedup %.1fx over the exact batch model",
+             randomFeatureMethodName(random_feature_model.method), random_feature_model.dimension, total_samples, max_error,
+             approx_accuracy, exact_accuracy, approx_accuracy - exact_accuracy, exact_time.count() / approx_time.count());
+}
+
+// Fits the random feature model for RBF models (needs the batch model for the exact decision values)
+void buildRandomFeatures() {
+    random_features_ready = false;
+
+    if (!use_random_features) {
+        return;
+    }
+    if (!batch_model_ready || batch_model.kernel_type != RBF) {
+        ROS_WARN("Random features need a two-class RBF model over normal_x/normal_y, using the exact model.");
+        return;
+    }
+
+    auto fit_start = std::chrono::high_resolution_clock::now();
+    if (!buildRandomFeatureModel(batch_model, random_feature_method, random_feature_dimension, random_feature_fit_samples, 42,
+                                 random_feature_model)) {
+        ROS_WARN("Random feature fit failed, using the exact model.");
+        return;
+    }
+    std::chrono::duration<double> fit_time = std::chrono::high_resolution_clock::now() - fit_start;
+    ROS_INFO("Fitted %d %s features to %d support vectors in %f seconds", random_feature_dimension,
+             randomFeatureMethodName(random_feature_method), batch_model.num_sv, fit_time.count());
+
+    random_features_ready = true;
+    validateRandomFeatures();
+}
+
+// Predicts the label of one feature vector and optionally returns its decision value.
+// Uses the random feature model or the lookup table when one of them is ready, otherwise the exact model.
+double predictLabel(const svm_node* nodes, double* decision_value = nullptr) {
+    if (!random_features_ready && !decision_lut_ready) {
+        return predictLabelExact(nodes, decision_value);
+    }
+
+    double features[2] = {0.0, 0.0};
+    for (const svm_node* node = nodes; node->index != -1; ++node) {
+        if (node->index == 1 || node->index == 2) {
+            features[node->index - 1] = node->value;
+        }
+    }
+
+    double value = random_features_ready ? randomFeatureDecision(random_feature_model, features[0], features[1])
+                                         : lookupDecisionValue(features[0], features[1]);
+    if (decision_value != nullptr) {
+        *decision_value = value;
+    }
+    return labelFromDecision(value);
+}
+
+
+// ----------------------------------------------------------------------------------
+// REDUCED PRECISION INFERENCE
+// ----------------------------------------------------------------------------------
+
+int precision_validation_samples = 2000; // CSV samples per precision check (the libsvm reference is slow)
+
+// Compares float32 and int16 inference against the double-precision reference (libsvm when the text model is
+// loaded, the double batch model otherwise) on the feature CSVs: decision error, label flips, memory and throughput
+void validateModelPrecisions() {
+    std::vector<FeatureData> samples;
+    for (const auto& csv_path : lut_validation_csvs) {
+        std::vector<FeatureData> csv_samples = loadFeatureCSV(csv_path);
+        samples.insert(samples.end(), csv_samples.begin(), csv_samples.end());
+    }
+
+    if (samples.empty()) {
+        ROS_WARN("No feature CSVs available, skipping precision validation.");
+        return;
+    }
+
+    if (precision_validation_samples > 0 && static_cast<int>(samples.size()) > precision_validation_samples) {
+        std::shuffle(samples.begin(), samples.end(), std::mt19937{42});
+        samples.resize(precision_validation_samples);
+    }
+
+    int total_samples = samples.size();
+    std::vector<float> normal_x(total_samples), normal_y(total_samples);
+    std::vector<double> reference_values(total_samples), reference_labels(total_samples);
+    for (int i = 0; i < total_samples; ++i) {
+        normal_x[i] = samples[i].normal_x;
+        normal_y[i] = samples[i].normal_y;
+    }
+
+    if (model != nullptr) {
+        #pragma omp parallel for
+        for (int i = 0; i < total_samples; ++i) {
+            svm_node nodes[3];
+            nodes[0].index = 1;
+            nodes[0].value = samples[i].normal_x;
+            nodes[1].index = 2;
+            nodes[1].value = samples[i].normal_y;
+            nodes[2].index = -1;
+            reference_labels[i] = svm_predict_values(model, nodes, &reference_values[i]);
         }
+    } else {
+        predictBatch(batch_model, normal_x.data(), normal_y.data(), total_samples, 1, reference_values.data(), reference_labels.data());
     }
 
-    // auto end = std::chrono::high_resolution_clock::now();
-    // std::chrono::duration<double> diff = end - start;
-    // std::cout << "Time taken for prediction: " << diff.count() << " seconds" << std::endl;
+    SVMFloatModel float_check;
+    SVMInt16Model int16_check;
+    buildSVMFloatModel(batch_model, float_check);
+    buildSVMInt16Model(batch_model, int16_check);
+
+    for (SVMPrecision precision : {SVMPrecision::Double, SVMPrecision::Float32, SVMPrecision::Int16}) {
+        std::vector<double> values(total_samples), labels(total_samples);
+        size_t model_bytes = 0;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        if (precision == SVMPrecision::Float32) {
+            predictFloat(float_check, normal_x.data(), normal_y.data(), total_samples, 1, values.data(), labels.data());
+            model_bytes = svmModelBytes(float_check);
+        } else if (precision == SVMPrecision::Int16) {
+            predictInt16(int16_check, normal_x.data(), normal_y.data(), total_samples, 1, values.data(), labels.data());
+            model_bytes = svmModelBytes(int16_check);
+        } else {
+            predictBatch(batch_model, normal_x.data(), normal_y.data(), total_samples, 1, values.data(), labels.data());
+            model_bytes = svmModelBytes(batch_model);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+        int label_flips = 0;
+        double max_error = 0.0;
+        for (int i = 0; i < total_samples; ++i) {
+            max_error = std::max(max_error, fabs(values[i] - reference_values[i]));
+            if (labels[i] != reference_labels[i]) {
+                label_flips++;
+            }
+        }
 
-    return static_cast<double>(correct_predictions) / total_points;
+        ROS_INFO("Precision %s: model %.2f MB, %.0f points/s, max decision error %g, label flips %d of %d",
+                 svmPrecisionName(precision), model_bytes / (1024.0 * 1024.0), total_samples / elapsed.count(),
+                 max_error, label_flips, total_samples);
+    }
+}
+
+// Converts the RBF batch model to the selected reduced precision
+void buildReducedPrecisionModel() {
+    quantized_model_ready = false;
+
+    if (!batch_model_ready || batch_model.kernel_type != RBF) {
+        return;
+    }
+
+    if (validate_model_precision) {
+        validateModelPrecisions();
+    }
+
+    if (model_precision == SVMPrecision::Float32) {
+        quantized_model_ready = buildSVMFloatModel(batch_model, float_model);
+    } else if (model_precision == SVMPrecision::Int16) {
+        quantized_model_ready = buildSVMInt16Model(batch_model, int16_model);
+    }
+
+    if (quantized_model_ready) {
+        ROS_INFO("Serving the RBF model in %s precision", svmPrecisionName(model_precision));
+    }
 }
 
 
@@ -296,6 +1051,7 @@ double predictTerrainType(const pcl::PointCloud<pcl::Normal>::Ptr& cloud_normals
 // Structure to store the computed metrics
 struct Metrics {
     int num_normals;
+    double accuracy;
     double model_confidence;
     double precision;
     double recall;
@@ -304,44 +1060,16 @@ struct Metrics {
     int false_positives;
     int false_negatives;
     int true_negatives;
+    int points_evaluated; // Normals actually classified (fewer than num_normals after an early exit)
+    bool early_exit;      // Frame label decided by the sequential test before all normals were classified
+    int frame_label;      // Frame-level label: sequential test decision, or the majority of the classified normals
 };
 
-// Function to compute the required metrics
-Metrics computeMetrics(const pcl::PointCloud<pcl::Normal>::Ptr& cloud_normals, int expected_label) {
-    int total_points = cloud_normals->points.size();
-    int true_positives = 0, false_positives = 0, false_negatives = 0, true_negatives = 0;
-    double total_confidence = 0.0;
-
-    for (int i = 0; i < total_points; ++i) {
-        svm_node nodes[3];
-        nodes[0].index = 1;
-        nodes[0].value = cloud_normals->points[i].normal_x;
-        nodes[1].index = 2;
-        nodes[1].value = cloud_normals->points[i].normal_y;
-        nodes[2].index = -1;
-
-        double predicted_label = svm_predict(model, nodes);
-        double decision_values[1];
-        svm_predict_values(model, nodes, decision_values);
-        double confidence = fabs(decision_values[0]);
-
-        total_confidence += confidence;
-
-        // Calculate true positives, false positives, etc.
-        if (predicted_label == 1 && expected_label == 1) {
-            true_positives++;
-        } else if (predicted_label == 1 && expected_label == 0) {
-            false_positives++;
-        } else if (predicted_label == 0 && expected_label == 1) {
-            false_negatives++;
-        } else if (predicted_label == 0 && expected_label == 0) {
-            true_negatives++;
-        }
-    }
-
-    Metrics metrics;
-    metrics.num_normals = total_points;
-    metrics.model_confidence = total_confidence / total_points;
+// Function to compute precision, recall and F1 score from the confusion counts of the inference pass
+void computeMetrics(Metrics& metrics) {
+    int true_positives = metrics.true_positives;
+    int false_positives = metrics.false_positives;
+    int false_negatives = metrics.false_negatives;
 
     // Compute Precision, Recall, and F1 Score
     if ((true_positives + false_positives) > 0) {
@@ -361,6 +1089,302 @@ Metrics computeMetrics(const pcl::PointCloud<pcl::Normal>::Ptr& cloud_normals, i
     } else {
         metrics.f1_score = 0;
     }
+}
+
+
+// Per-point output of the inference pass
+struct Predictions {
+    std::vector<double> labels;
+    std::vector<double> decision_values;
+};
+
+// Terrain grid: classified normals are binned into XY cells over the crop region and each cell
+// gets the majority label, so planners get a label map instead of a per-frame accuracy
+bool publish_terrain_grid = true;
+float terrain_grid_resolution = 0.1f; // Cell edge length in meters (15 x 12 cells over the crop)
+
+// Vote counts of one frame, filled by predictTerrainType in the inference pass
+struct TerrainGridVotes {
+    int width = 0;
+    int height = 0;
+    std::vector<int> counts;      // Normals classified in each cell
+    std::vector<int> grass_votes; // Normals classified as grass (label 1) in each cell
+};
+
+void resetTerrainGrid(TerrainGridVotes& grid) {
+    grid.width = static_cast<int>(std::ceil((CROP_MAX_X - CROP_MIN_X) / terrain_grid_resolution - 1e-4f));
+    grid.height = static_cast<int>(std::ceil((CROP_MAX_Y - CROP_MIN_Y) / terrain_grid_resolution - 1e-4f));
+    grid.counts.assign(grid.width * grid.height, 0);
+    grid.grass_votes.assign(grid.width * grid.height, 0);
+}
+
+// Row-major cell index of a point, -1 outside the crop region
+inline int terrainGridCell(const TerrainGridVotes& grid, float x, float y) {
+    int col = static_cast<int>(std::floor((x - CROP_MIN_X) / terrain_grid_resolution));
+    int row = static_cast<int>(std::floor((y - CROP_MIN_Y) / terrain_grid_resolution));
+    if (col < 0 || row < 0 || col > grid.width || row > grid.height) {
+        return -1;
+    }
+    // Points on the far crop edge belong to the last cell
+    return std::min(row, grid.height - 1) * grid.width + std::min(col, grid.width - 1);
+}
+
+// Majority label and its vote share per cell
+stat_analysis::TerrainGrid buildTerrainGridMsg(const TerrainGridVotes& grid, const std_msgs::Header& header) {
+    stat_analysis::TerrainGrid msg;
+    msg.header = header;
+    msg.origin_x = CROP_MIN_X;
+    msg.origin_y = CROP_MIN_Y;
+    msg.resolution = terrain_grid_resolution;
+    msg.width = grid.width;
+    msg.height = grid.height;
+
+    int num_cells = grid.width * grid.height;
+    msg.labels.resize(num_cells);
+    msg.confidence.resize(num_cells);
+    msg.counts.resize(num_cells);
+    for (int cell = 0; cell < num_cells; ++cell) {
+        int count = grid.counts[cell];
+        msg.counts[cell] = std::min(count, 65535);
+        if (count == 0) {
+            msg.labels[cell] = -1;
+            msg.confidence[cell] = 0;
+            continue;
+        }
+        int grass_votes = grid.grass_votes[cell];
+        bool grass = 2 * grass_votes > count;
+        int majority_votes = grass ? grass_votes : count - grass_votes;
+        msg.labels[cell] = grass ? 1 : 0;
+        msg.confidence[cell] = static_cast<uint8_t>(std::lround(255.0 * majority_votes / count));
+    }
+    return msg;
+}
+
+// Early-exit frame classification: when only the frame label (grass or plain) is needed, normals are classified
+// in random order a chunk at a time and a sequential probability ratio test on the signs of their decision values
+// stops as soon as the frame label is decided. The test separates a grass share of 0.5 + indifference from
+// 0.5 - indifference, with error rates of 1 - early_exit_confidence for both labels.
+bool use_early_exit = false;
+double early_exit_confidence = 0.99;
+double early_exit_indifference = 0.1;
+int early_exit_chunk = 32; // Normals classified (in parallel) between test updates
+
+// Frame counts behind the early-exit rate logged to the CSV
+int frames_classified = 0;
+int frames_exited_early = 0;
+
+std::mt19937 early_exit_generator(42);
+std::vector<int> early_exit_order;
+
+// Sequential variant of predictTerrainType. Only the classified normals enter the metrics and the grid;
+// the others keep a NaN label and decision value in predictions.
+Metrics predictTerrainTypeEarlyExit(const pcl::PointCloud<pcl::Normal>::Ptr& cloud_normals, int expected_label, Predictions& predictions,
+                                    const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud, TerrainGridVotes* grid) {
+    int total_points = cloud_normals->points.size();
+    int correct_predictions = 0;
+    int true_positives = 0, false_positives = 0, false_negatives = 0, true_negatives = 0;
+    double total_confidence = 0.0;
+
+    predictions.labels.assign(total_points, std::numeric_limits<double>::quiet_NaN());
+    predictions.decision_values.assign(total_points, std::numeric_limits<double>::quiet_NaN());
+
+    bool fill_grid = (grid != nullptr && cloud != nullptr && static_cast<int>(cloud->points.size()) == total_points);
+    if (grid != nullptr) {
+        resetTerrainGrid(*grid);
+    }
+
+    // Wald's SPRT: each grass vote adds vote_weight to the log likelihood ratio, each plain vote subtracts it
+    const double vote_weight = std::log((0.5 + early_exit_indifference) / (0.5 - early_exit_indifference));
+    const double decision_bound = std::log(early_exit_confidence / (1.0 - early_exit_confidence));
+    double log_likelihood_ratio = 0.0;
+
+    bool batch_inference = use_batch_inference && batch_model_ready && batch_model.kernel_type == RBF &&
+                           !decision_lut_ready && !random_features_ready;
+    std::vector<float> chunk_x(early_exit_chunk), chunk_y(early_exit_chunk);
+    std::vector<double> chunk_values(early_exit_chunk), chunk_labels(early_exit_chunk);
+
+    early_exit_order.resize(total_points);
+    std::iota(early_exit_order.begin(), early_exit_order.end(), 0);
+
+    int evaluated = 0;
+    bool decided = false;
+    while (evaluated < total_points && !decided) {
+        int count = std::min(early_exit_chunk, total_points - evaluated);
+
+        // Partial Fisher-Yates: draws the next chunk of the random order without shuffling the whole frame
+        for (int k = evaluated; k < evaluated + count; ++k) {
+            std::uniform_int_distribution<int> pick(k, total_points - 1);
+            std::swap(early_exit_order[k], early_exit_order[pick(early_exit_generator)]);
+            const pcl::Normal& normal = cloud_normals->points[early_exit_order[k]];
+            chunk_x[k - evaluated] = normal.normal_x;
+            chunk_y[k - evaluated] = normal.normal_y;
+        }
+
+        if (batch_inference) {
+            predictBatchSelected(chunk_x.data(), chunk_y.data(), count, 1, chunk_values.data(), chunk_labels.data());
+        } else {
+            #pragma omp parallel for
+            for (int c = 0; c < count; ++c) {
+                svm_node nodes[3];
+                nodes[0].index = 1;
+                nodes[0].value = chunk_x[c];
+                nodes[1].index = 2;
+                nodes[1].value = chunk_y[c];
+                nodes[2].index = -1; // End of features
+
+                chunk_labels[c] = predictLabel(nodes, &chunk_values[c]);
+            }
+        }
+
+        for (int c = 0; c < count; ++c) {
+            int i = early_exit_order[evaluated + c];
+            double label = chunk_labels[c];
+            predictions.labels[i] = label;
+            predictions.decision_values[i] = chunk_values[c];
+            total_confidence += fabs(chunk_values[c]);
+
+            if (label == expected_label) {
+                correct_predictions++;
+            }
+
+            if (label == 1 && expected_label == 1) {
+                true_positives++;
+            } else if (label == 1 && expected_label == 0) {
+                false_positives++;
+            } else if (label == 0 && expected_label == 1) {
+                false_negatives++;
+            } else if (label == 0 && expected_label == 0) {
+                true_negatives++;
+            }
+
+            if (fill_grid) {
+                int cell = terrainGridCell(*grid, cloud->points[i].x, cloud->points[i].y);
+                if (cell >= 0) {
+                    grid->counts[cell]++;
+                    if (label == 1) {
+                        grid->grass_votes[cell]++;
+                    }
+                }
+            }
+
+            log_likelihood_ratio += (label == 1) ? vote_weight : -vote_weight;
+        }
+
+        evaluated += count;
+        decided = std::fabs(log_likelihood_ratio) >= decision_bound;
+    }
+
+    Metrics metrics;
+    metrics.num_normals = total_points;
+    metrics.accuracy = (evaluated > 0) ? static_cast<double>(correct_predictions) / evaluated : 0.0;
+    metrics.model_confidence = (evaluated > 0) ? total_confidence / evaluated : 0.0;
+
+    metrics.true_positives = true_positives;
+    metrics.false_positives = false_positives;
+    metrics.false_negatives = false_negatives;
+    metrics.true_negatives = true_negatives;
+
+    metrics.points_evaluated = evaluated;
+    metrics.early_exit = decided && evaluated < total_points;
+    metrics.frame_label = decided ? (log_likelihood_ratio > 0 ? 1 : 0)
+                                  : (true_positives + false_positives > false_negatives + true_negatives ? 1 : 0);
+
+    computeMetrics(metrics);
+
+    return metrics;
+}
+
+// Function to extract features and predict the terrain type.
+// Runs a single parallel inference pass that stores the label and decision value of every normal and
+// reduces the accuracy, confidence and confusion counts on the way, so the metrics need no second pass.
+// With a grid (and the cloud the normals were computed on) the per-cell votes are reduced in the same pass.
+Metrics predictTerrainType(const pcl::PointCloud<pcl::Normal>::Ptr& cloud_normals, int expected_label, Predictions& predictions,
+                           const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud = nullptr, TerrainGridVotes* grid = nullptr) {
+    if (use_early_exit || latency_budget.cheaper_model) {
+        return predictTerrainTypeEarlyExit(cloud_normals, expected_label, predictions, cloud, grid);
+    }
+
+    int total_points = cloud_normals->points.size();
+    int correct_predictions = 0;
+    int true_positives = 0, false_positives = 0, false_negatives = 0, true_negatives = 0;
+    double total_confidence = 0.0;
+
+    bool fill_grid = (grid != nullptr && cloud != nullptr && static_cast<int>(cloud->points.size()) == total_points);
+    if (grid != nullptr) {
+        resetTerrainGrid(*grid);
+    }
+    // The array reduction needs valid storage even without a grid, so it then reduces into one unused cell
+    int unused_cell[2] = {0, 0};
+    int num_cells = fill_grid ? grid->width * grid->height : 1;
+    int* cell_counts = fill_grid ? grid->counts.data() : &unused_cell[0];
+    int* cell_grass_votes = fill_grid ? grid->grass_votes.data() : &unused_cell[1];
+
+    predictions.labels.resize(total_points);
+    predictions.decision_values.resize(total_points);
+
+    // Exact RBF models are evaluated by the SIMD batch kernel up front; the loop below then only reduces
+    bool batch_inference = use_batch_inference && batch_model_ready && batch_model.kernel_type == RBF &&
+                           !decision_lut_ready && !random_features_ready;
+    if (batch_inference && total_points > 0) {
+        const int stride = sizeof(pcl::Normal) / sizeof(float);
+        predictBatchSelected(&cloud_normals->points[0].normal_x, &cloud_normals->points[0].normal_y, total_points, stride,
+                             predictions.decision_values.data(), predictions.labels.data());
+    }
+
+    #pragma omp parallel for reduction(+:correct_predictions, true_positives, false_positives, false_negatives, true_negatives, total_confidence) \
+                             reduction(+:cell_counts[:num_cells], cell_grass_votes[:num_cells])
+    for (int i = 0; i < total_points; ++i) {
+        double decision_value = 0.0;
+        double label = 0.0;
+
+        if (batch_inference) {
+            label = predictions.labels[i];
+            decision_value = predictions.decision_values[i];
+        } else {
+            svm_node nodes[3];
+            nodes[0].index = 1;
+            nodes[0].value = cloud_normals->points[i].normal_x;
+            nodes[1].index = 2;
+            nodes[1].value = cloud_normals->points[i].normal_y;
+            nodes[2].index = -1; // End of features
+
+            label = predictLabel(nodes, &decision_value);
+            predictions.labels[i] = label;
+            predictions.decision_values[i] = decision_value;
+        }
+
+        total_confidence += fabs(decision_value);
+
+        if (label == expected_label) {
+            correct_predictions++;
+        }
+
+        // Calculate true positives, false positives, etc.
+        if (label == 1 && expected_label == 1) {
+            true_positives++;
+        } else if (label == 1 && expected_label == 0) {
+            false_positives++;
+        } else if (label == 0 && expected_label == 1) {
+            false_negatives++;
+        } else if (label == 0 && expected_label == 0) {
+            true_negatives++;
+        }
+
+        if (fill_grid) {
+            int cell = terrainGridCell(*grid, cloud->points[i].x, cloud->points[i].y);
+            if (cell >= 0) {
+                cell_counts[cell]++;
+                if (label == 1) {
+                    cell_grass_votes[cell]++;
+                }
+            }
+        }
+    }
+
+    Metrics metrics;
+    metrics.num_normals = total_points;
+    metrics.accuracy = (total_points > 0) ? static_cast<double>(correct_predictions) / total_points : 0.0;
+    metrics.model_confidence = (total_points > 0) ? total_confidence / total_points : 0.0;
 
     // Save confusion matrix components for later use
     metrics.true_positives = true_positives;
@@ -368,28 +1392,77 @@ Metrics computeMetrics(const pcl::PointCloud<pcl::Normal>::Ptr& cloud_normals, i
     metrics.false_negatives = false_negatives;
     metrics.true_negatives = true_negatives;
 
+    metrics.points_evaluated = total_points;
+    metrics.early_exit = false;
+    metrics.frame_label = (true_positives + false_positives > false_negatives + true_negatives) ? 1 : 0;
+
+    computeMetrics(metrics);
+
     return metrics;
 }
 
 
+// Column names of logResultsToCSV, in the order the values are written
+const std::string RESULTS_CSV_HEADER = "Preprocessing Time (s),Feature Extraction Time (s),Prediction Time (s),Frame Time (s),Deadline Missed,Leaf X (m),Leaf Y (m),Leaf Z (m),K Neighbors,Cheaper Model,Latency Adjustment,Accuracy,Num Normals,CPU Utilization (%),Model Confidence,Precision,Recall,F1 Score,True Positives,False Positives,False Negatives,True Negatives,Points Evaluated,Early Exit Rate";
+
+// A non-empty results file whose header is not RESULTS_CSV_HEADER (e.g. written by an older build with fewer
+// columns) is renamed to <file>.<unix time>.old, so rows are never appended under the wrong columns. Returns
+// false when such a file could not be moved aside and must not be appended to.
+bool rotateMismatchedResultsCSV(const std::string& file_path) {
+    std::ifstream existing(file_path);
+    std::string first_line;
+    if (!existing || !std::getline(existing, first_line)) {
+        return true;
+    }
+    existing.close();
+    if (!first_line.empty() && first_line.back() == '\r') {
+        first_line.pop_back();
+    }
+    if (first_line == RESULTS_CSV_HEADER) {
+        return true;
+    }
+
+    const std::string rotated_path = file_path + "." + std::to_string(std::time(nullptr)) + ".old";
+    if (std::rename(file_path.c_str(), rotated_path.c_str()) != 0) {
+        ROS_ERROR_THROTTLE(5.0, "%s has different columns and could not be moved aside; not appending to it", file_path.c_str());
+        return false;
+    }
+    ROS_WARN("%s has different columns; moved it to %s and starting a new file", file_path.c_str(), rotated_path.c_str());
+    return true;
+}
+
 // Function to log results to CSV, ensuring the file is fresh each time
-void logResultsToCSV(const std::string& file_path, double pre_process_time, double feature_extraction_time, double prediction_time, double accuracy, int num_normals, double model_confidence, double cpu_utilization, double precision, double recall, double f1_score, int true_positives, int false_positives, int false_negatives, int true_negatives) {
+void logResultsToCSV(const std::string& file_path, double pre_process_time, double feature_extraction_time, double prediction_time, double frame_time, bool deadline_missed, float leaf_x, float leaf_y, float leaf_z, int k_neighbors, bool cheaper_model, const char* latency_adjustment, double accuracy, int num_normals, double model_confidence, double cpu_utilization, double precision, double recall, double f1_score, int true_positives, int false_positives, int false_negatives, int true_negatives, int points_evaluated, double early_exit_rate) {
 
-    // Check if the file exists and is not empty
+    // Check if the file exists and is not empty (after moving aside a file with other columns)
     struct stat buffer;
     bool file_exists = (stat(file_path.c_str(), &buffer) == 0);
+    if (file_exists && buffer.st_size > 0) {
+        if (!rotateMismatchedResultsCSV(file_path)) {
+            return;
+        }
+        file_exists = (stat(file_path.c_str(), &buffer) == 0);
+    }
 
     // Open the file in append mode
     file.open(file_path, std::ios::app);
 
     // If the file does not exist or is empty, write the header
     if (!file_exists || buffer.st_size == 0) {
-        file << "Preprocessing Time (s),Feature Extraction Time (s),Prediction Time (s),Accuracy,Num Normals,CPU Utilization (%),Model Confidence,Precision,Recall,F1 Score,True Positives,False Positives,False Negatives,True Negatives\n";
+        file << RESULTS_CSV_HEADER << "\n";
     }
     // Write the data
     file << pre_process_time << "," 
          << feature_extraction_time << "," 
          << prediction_time << "," 
+         << frame_time << ","
+         << deadline_missed << ","
+         << leaf_x << ","
+         << leaf_y << ","
+         << leaf_z << ","
+         << k_neighbors << ","
+         << cheaper_model << ","
+         << latency_adjustment << ","
          << accuracy << "," 
          << num_normals << "," 
          << cpu_utilization << ","
@@ -400,7 +1473,9 @@ void logResultsToCSV(const std::string& file_path, double pre_process_time, doub
          << true_positives << "," 
          << false_positives << "," 
          << false_negatives << "," 
-         << true_negatives << "\n";
+         << true_negatives << ","
+         << points_evaluated << ","
+         << early_exit_rate << "\n";
 
     file.close();
     std::cout << "Performance Metrics and Confusion Matrix Components Saved" << std::endl;
@@ -416,6 +1491,37 @@ void logResultsToCSV(const std::string& file_path, double pre_process_time, doub
 
 
 
+// ----------------------------------------------------------------------------------
+// PIPELINE CONTEXT
+// ----------------------------------------------------------------------------------
+
+// Everything the fused path used to create per frame, created once: clouds and buffers keep their capacity, the
+// normal estimator and search tree are reused. After the first few frames have grown the buffers, the crop,
+// downsampling and prediction stages run without heap allocations. The remaining ones come from PCL internals
+// (per-query buffers in normal estimation, and the FLANN index build when the KdTree search is selected) and
+// from publishing and CSV logging.
+struct PipelineContext {
+    CloudSoA survivors;                   // Crop survivors read from the message
+    VoxelGridWorkspace voxel_grid;        // Voxel index sort buffer
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_downsampled{new pcl::PointCloud<pcl::PointXYZ>};
+    pcl::PointCloud<pcl::Normal>::Ptr normals{new pcl::PointCloud<pcl::Normal>};
+    pcl::search::Search<pcl::PointXYZ>::Ptr tree{new pcl::search::KdTree<pcl::PointXYZ>};
+    pcl::search::Search<pcl::PointXYZ>::Ptr voxel_hash{new VoxelHashSearch<pcl::PointXYZ>(0.26f)};
+    pcl::NormalEstimationOMP<pcl::PointXYZ, pcl::Normal> normal_estimation;
+    RangeImage range_image;               // Integral image normals: the cropped scan ...
+    IntegralImageNormalWorkspace integral_normals;
+    pcl::PointCloud<pcl::Normal> organized_normals; // ... and the normal of every pixel
+    Predictions predictions;
+    TerrainGridVotes terrain_grid;
+};
+
+PipelineContext pipeline;
+
+// Log the heap allocations of every pipeline stage once per frame (allocation_counter.h). A diagnostic: the
+// counts are only non-zero in a build with COUNT_HEAP_ALLOCATIONS defined.
+bool log_frame_allocations = false;
+FrameAllocations frame_allocations;
+
 // ----------------------------------------------------------------------------------
 // POINTCLOUD CALLBACK
 // ----------------------------------------------------------------------------------
@@ -427,47 +1533,77 @@ void pointcloud_callback(const sensor_msgs::PointCloud2ConstPtr& input_msg, ros:
     // PREPROCESSING
     // ------------------------------------------------------------------------------
     auto pre_process_start = std::chrono::high_resolution_clock::now();
+    if (log_frame_allocations) {
+        frame_allocations.begin();
+    }
 
-    // Convert ROS PointCloud2 message to PCL PointCloud
-    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
-    
-    pcl::fromROSMsg(*input_msg, *cloud);
-    // ROS_INFO("Raw PointCloud: %ld points", cloud->points.size());
-    
-    // Combined Passthrough Filtering to reduce function calls
+    // Leaf size of this frame, coarsened by the latency budget when frames run late
+    const float leaf_scale = use_latency_budget ? latency_budget.leaf_scale : 1.0f;
+    const float leaf_x = LEAF_SIZE_X * leaf_scale, leaf_y = LEAF_SIZE_Y * leaf_scale, leaf_z = LEAF_SIZE_Z * leaf_scale;
+
+    // Crop box + Voxel Grid Downsampling
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_after_parallel_downsampling;
+    if (normal_method == NormalMethod::IntegralImage) {
+        // Crop box + Range Image, no downsampling: the points come out of the normal estimation
+        const CropBox crop_box = {CROP_MIN_X, CROP_MAX_X, CROP_MIN_Y, CROP_MAX_Y, CROP_MIN_Z, CROP_MAX_Z};
+        buildRangeImage(*input_msg, crop_box, range_image_config, pipeline.range_image);
+        cloud_after_parallel_downsampling = pipeline.cloud_downsampled;
+    } else if (use_fused_crop_voxel) {
+        cropVoxelGridDownsampling(input_msg, leaf_x, leaf_y, leaf_z, pipeline.survivors, pipeline.voxel_grid, *pipeline.cloud_downsampled);
+        cloud_after_parallel_downsampling = pipeline.cloud_downsampled;
+    } else {
+        // Convert ROS PointCloud2 message to PCL PointCloud
+        pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
+        
+        pcl::fromROSMsg(*input_msg, *cloud);
+        // ROS_INFO("Raw PointCloud: %ld points", cloud->points.size());
+        
+        // Combined Passthrough Filtering to reduce function calls
     
-    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_after_combined_passthrough = combinedPassthroughFilter(cloud);
-    // publishProcessedCloud(cloud_after_combined_passthrough, pub_after_combined_passthrough, input_msg);
-    // ROS_INFO("After Combined Passthough filter: %ld points", cloud_after_combined_passthrough->points.size());
+        pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_after_combined_passthrough = combinedPassthroughFilter(cloud);
+        // publishProcessedCloud(cloud_after_combined_passthrough, pub_after_combined_passthrough, input_msg);
+        // ROS_INFO("After Combined Passthough filter: %ld points", cloud_after_combined_passthrough->points.size());
     
-    // ------------------------------------------------------------------------------
-    // // Normal Voxel Grid Downsampling
-    // auto normal_downsampling_start = std::chrono::high_resolution_clock::now();
-
-    // pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_after_normal_downsampling = voxelGridDownsampling(cloud_after_combined_passthrough, 0.13f, 0.13f, 0.05f);
-
-    // auto normal_downsampling_end = std::chrono::high_resolution_clock::now();
-    // std::chrono::duration<double> normal_downsampling_time = normal_downsampling_end - normal_downsampling_start;
-    // ROS_INFO("Normal Downsampling Time: %f seconds", normal_downsampling_time.count());
-    // ------------------------------------------------------------------------------
+        // ------------------------------------------------------------------------------
+        // Normal Voxel Grid Downsampling (only run to time the parallel version against it)
+        pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_after_normal_downsampling;
+        std::chrono::duration<double> normal_downsampling_time(0.0);
+        if (compare_parallel_downsampling) {
+            auto normal_downsampling_start = std::chrono::high_resolution_clock::now();
+
+            cloud_after_normal_downsampling = voxelGridDownsampling(cloud_after_combined_passthrough, leaf_x, leaf_y, leaf_z);
+
+            auto normal_downsampling_end = std::chrono::high_resolution_clock::now();
+            normal_downsampling_time = normal_downsampling_end - normal_downsampling_start;
+            ROS_INFO("Normal Downsampling Time: %f seconds", normal_downsampling_time.count());
+        }
+        // ------------------------------------------------------------------------------
 
-    // Parallel Voxel Grid Downsampling
-    // auto parallel_downsampling_start = std::chrono::high_resolution_clock::now();
+        // Parallel Voxel Grid Downsampling
+        auto parallel_downsampling_start = std::chrono::high_resolution_clock::now();
 
-    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_after_parallel_downsampling = parallelVoxelGridDownsampling(cloud_after_combined_passthrough, 0.13f, 0.13f, 0.05f);
-    // publishProcessedCloud(cloud_after_parallel_downsampling, pub_after_parallel_downsampling, input_msg);
-    // ROS_INFO("After Parallel Downsampling: %ld points", cloud_after_parallel_downsampling->points.size());
+        cloud_after_parallel_downsampling = parallelVoxelGridDownsampling(cloud_after_combined_passthrough, leaf_x, leaf_y, leaf_z);
+        // publishProcessedCloud(cloud_after_parallel_downsampling, pub_after_parallel_downsampling, input_msg);
+        // ROS_INFO("After Parallel Downsampling: %ld points", cloud_after_parallel_downsampling->points.size());
     
-    // auto parallel_downsampling_end = std::chrono::high_resolution_clock::now();
-    // std::chrono::duration<double> parallel_downsampling_time = parallel_downsampling_end - parallel_downsampling_start;
-    // ROS_INFO("Parallel Downsampling Time: %f seconds", parallel_downsampling_time.count());
+        auto parallel_downsampling_end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> parallel_downsampling_time = parallel_downsampling_end - parallel_downsampling_start;
 
-    // double speedup_dw = normal_downsampling_time.count() / parallel_downsampling_time.count();
-    // ROS_INFO("Speedup with Parallel Downsampling: %f", speedup_dw);
+        if (compare_parallel_downsampling) {
+            ROS_INFO("Parallel Downsampling Time: %f seconds (%d threads)", parallel_downsampling_time.count(), omp_get_max_threads());
+
+            double speedup_dw = normal_downsampling_time.count() / parallel_downsampling_time.count();
+            ROS_INFO("Speedup with Parallel Downsampling: %f", speedup_dw);
+            logDownsamplingAgreement(cloud_after_normal_downsampling, cloud_after_parallel_downsampling);
+        }
+    }
 
     // End of Pre-processing steps. Calculate time required for this segment
     auto pre_process_end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> pre_process_time = pre_process_end - pre_process_start;
+    if (log_frame_allocations) {
+        frame_allocations.endStage("preprocessing");
+    }
     // std::cout << "Time taken for preprocessing (filters to downsampling): " << pre_process_time.count() << " seconds" << std::endl;
     // ------------------------------------------------------------------------------
     
@@ -477,7 +1613,7 @@ void pointcloud_callback(const sensor_msgs::PointCloud2ConstPtr& input_msg, ros:
     // // Normal Estimation and Visualization
     auto feature_extraction_start = std::chrono::high_resolution_clock::now();
     
-    int k_neighbors = std::max(10, static_cast<int>(cloud_after_parallel_downsampling->points.size() / 5));
+    int k_neighbors = 0; // 0 for a radius neighbourhood and for integral image normals
     // ROS_INFO("Using %d neighbors for normal estimation.", k_neighbors);
 
     // pcl::PointCloud<pcl::Normal>::Ptr cloud_normals = computeNormals(cloud_after_parallel_downsampling, k_neighbors);
@@ -520,7 +1656,26 @@ void pointcloud_callback(const sensor_msgs::PointCloud2ConstPtr& input_msg, ros:
     // Parallel Normal Computation
     // auto parallel_start = std::chrono::high_resolution_clock::now();
 
-    pcl::PointCloud<pcl::Normal>::Ptr normals_parallel = computeNormalsParallel(cloud_after_parallel_downsampling, k_neighbors);
+    if (normal_method == NormalMethod::IntegralImage) {
+        computeNormals(pipeline.range_image, integral_normal_config, pipeline.integral_normals, pipeline.organized_normals,
+                       *cloud_after_parallel_downsampling, *pipeline.normals);
+    } else {
+        NormalNeighbourhood neighbourhood = normalNeighbourhood(normal_neighbourhood, cloud_after_parallel_downsampling->points.size(),
+                                                                std::max({leaf_x, leaf_y, leaf_z}));
+        if (use_latency_budget && neighbourhood.k > 0) {
+            neighbourhood.k = budgetedNeighbours(latency_budget, neighbourhood.k);
+        }
+        k_neighbors = neighbourhood.k;
+
+        pcl::search::Search<pcl::PointXYZ>::Ptr normal_search = pipeline.tree;
+        if (neighbour_search == NeighbourSearch::VoxelHash) {
+            static_cast<VoxelHashSearch<pcl::PointXYZ>&>(*pipeline.voxel_hash).setCellSize(
+                voxelHashCellSize(neighbourhood.radius, std::max({leaf_x, leaf_y, leaf_z})));
+            normal_search = pipeline.voxel_hash;
+        }
+        computeNormalsParallel(cloud_after_parallel_downsampling, neighbourhood, normal_neighbourhood.min_k, pipeline.normal_estimation, normal_search, *pipeline.normals);
+    }
+    pcl::PointCloud<pcl::Normal>::Ptr normals_parallel = pipeline.normals;
 
     // auto parallel_end = std::chrono::high_resolution_clock::now();
 
@@ -533,6 +1688,9 @@ void pointcloud_callback(const sensor_msgs::PointCloud2ConstPtr& input_msg, ros:
     auto feature_extraction_end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> feature_extraction_time = feature_extraction_end - feature_extraction_start;
     // std::cout << "Time taken for feature extraction: " << feature_extraction_time.count() << " seconds" << std::endl;
+    if (log_frame_allocations) {
+        frame_allocations.endStage("normals");
+    }
 
 
     // Normal Visualization
@@ -544,14 +1702,52 @@ void pointcloud_callback(const sensor_msgs::PointCloud2ConstPtr& input_msg, ros:
     // ------------------------------------------------------------------------------
     auto prediction_start = std::chrono::high_resolution_clock::now();
 
-    // Predict the terrain type using the saved SVM model.
-    double accuracy = predictTerrainType(normals_parallel, expected_label); 
+    // Predict the terrain type using the saved SVM model. Metrics are reduced in the same pass.
+    Predictions& predictions = pipeline.predictions;
+    TerrainGridVotes& terrain_grid = pipeline.terrain_grid;
+    Metrics metrics = predictTerrainType(normals_parallel, expected_label, predictions, cloud_after_parallel_downsampling,
+                                         publish_terrain_grid ? &terrain_grid : nullptr);
+    double accuracy = metrics.accuracy;
+
+    frames_classified++;
+    if (metrics.early_exit) {
+        frames_exited_early++;
+    }
 
     auto prediction_end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> prediction_time = prediction_end - prediction_start;
+    if (log_frame_allocations) {
+        frame_allocations.endStage("prediction");
+    }
 
     std::cout << "Prediction accuracy for this frame: " << accuracy << std::endl;
+    if (use_early_exit || latency_budget.cheaper_model) {
+        std::cout << "Frame label: " << metrics.frame_label << " after " << metrics.points_evaluated << " of "
+                  << metrics.num_normals << " normals" << (metrics.early_exit ? " (early exit)" : "") << std::endl;
+    }
     std::cout << "Time taken for prediction: " << prediction_time.count() << " seconds" << std::endl;
+
+    if (publish_terrain_grid) {
+        pub_terrain_grid.publish(buildTerrainGridMsg(terrain_grid, input_msg->header));
+    }
+    // ------------------------------------------------------------------------------
+
+    // LATENCY BUDGET
+    // ------------------------------------------------------------------------------
+    // Settings for the next frame from the stage times of this one
+    double frame_time = pre_process_time.count() + feature_extraction_time.count() + prediction_time.count();
+    bool deadline_missed = frame_time > latency_budget_config.deadline;
+    bool cheaper_model = latency_budget.cheaper_model;
+    LatencyAdjustment latency_adjustment = LatencyAdjustment::None;
+    if (use_latency_budget) {
+        latency_adjustment = updateLatencyBudget(latency_budget_config, frame_time, feature_extraction_time.count(),
+                                                 k_neighbors, latency_budget);
+        if (latency_adjustment != LatencyAdjustment::None) {
+            ROS_INFO("Latency budget: frame took %f s of %f s, %s (leaf scale %.2f, neighbour limit %d%s)", frame_time,
+                     latency_budget_config.deadline, latencyAdjustmentName(latency_adjustment), latency_budget.leaf_scale,
+                     latency_budget.neighbour_limit, latency_budget.cheaper_model ? ", early-exit model" : "");
+        }
+    }
     // ------------------------------------------------------------------------------
 
     // LOGGING PERFORMANCE METRICS
@@ -564,9 +1760,6 @@ void pointcloud_callback(const sensor_msgs::PointCloud2ConstPtr& input_msg, ros:
     sysinfo(&sys_info);
     double cpu_utilization = 100.0 * (sys_info.loads[0] / static_cast<double>(1 << SI_LOAD_SHIFT));
 
-    // Calculate additional metrics (model confidence, precision, recall, F1-score, etc.)
-    Metrics metrics = computeMetrics(normals_parallel, expected_label);
-
     // // Log the results to CSV, including all the new metrics
     // logResultsToCSV(file_path, pre_process_time.count(), feature_extraction_time.count(), prediction_time.count(), accuracy, 
     //             metrics.num_normals, metrics.model_confidence, cpu_utilization,
@@ -577,6 +1770,14 @@ void pointcloud_callback(const sensor_msgs::PointCloud2ConstPtr& input_msg, ros:
                     pre_process_time.count(), 
                     feature_extraction_time.count(), 
                     prediction_time.count(), 
+                    frame_time,
+                    deadline_missed,
+                    leaf_x,
+                    leaf_y,
+                    leaf_z,
+                    k_neighbors,
+                    cheaper_model,
+                    latencyAdjustmentName(latency_adjustment),
                     accuracy, 
                     metrics.num_normals, 
                     metrics.model_confidence, 
@@ -587,7 +1788,24 @@ void pointcloud_callback(const sensor_msgs::PointCloud2ConstPtr& input_msg, ros:
                     metrics.true_positives, 
                     metrics.false_positives, 
                     metrics.false_negatives, 
-                    metrics.true_negatives);
+                    metrics.true_negatives,
+                    metrics.points_evaluated,
+                    static_cast<double>(frames_exited_early) / frames_classified);
+
+    if (log_frame_allocations) {
+        frame_allocations.endStage("output");
+        char allocation_report[256];
+        frame_allocations.format(allocation_report, sizeof(allocation_report));
+        ROS_INFO("Heap allocations this frame: %s", allocation_report);
+    }
+
+    // Startup cost of the model format shows up as the delay before the first classified frame
+    if (!first_frame_logged) {
+        std::chrono::duration<double> since_start = std::chrono::high_resolution_clock::now() - node_start_time;
+        std::chrono::duration<double> first_frame_latency = std::chrono::high_resolution_clock::now() - pre_process_start;
+        ROS_INFO("First classified frame: %f seconds after node start, frame latency %f seconds", since_start.count(), first_frame_latency.count());
+        first_frame_logged = true;
+    }
 }
 
 
@@ -604,8 +1822,15 @@ int main(int argc, char** argv) {
 
     // Initialize the ROS node
     ros::init(argc, argv, "terrain_classification_node");
+    node_start_time = std::chrono::high_resolution_clock::now();
     ros::NodeHandle nh;
 
+    resetLatencyBudget(latency_budget_config, latency_budget);
+
+    if (log_frame_allocations && !ALLOCATION_COUNTER_ENABLED) {
+        ROS_WARN("Heap allocation counting needs glibc and a build with COUNT_HEAP_ALLOCATIONS defined; the per-frame allocation counts will read 0.");
+    }
+
     // Check if the folder exists
     struct stat info;
     if (stat(FOLDER_PATH.c_str(), &info) != 0) {
@@ -626,10 +1851,18 @@ int main(int argc, char** argv) {
     // std::string model_path = "/home/shovon/Desktop/catkin_ws/src/stat_analysis/model_results/terrain_classification/terrain_classification_cyglidar_model_svm_rbf.model"; // Model Path for ASUS Laptop
     // std::string model_path = "/home/shovon/Desktop/catkin_ws/src/stat_analysis/model_results/terrain_classification/terrain_classification_cyglidar_model_90_linear.model"; // Model Path for ASUS Laptop
 
+    // Binary models converted with model_converter are mapped instead of parsed (any path ending in .bin)
+    // std::string model_path = "/home/shovon/Desktop/catkin_ws/src/stat_analysis/model_results/terrain_classification/terrain_classification_cyglidar_model_svm_rbf.model.bin"; // Model Path for ASUS Laptop
+
     // std::string model_path = "/home/jetson/catkin_ws/src/stat_analysis/model_results/terrain_classification/terrain_classification_model.model"; // Model Path for Jetson Nano
     // std::string model_path = "/home/jetson/catkin_ws/src/stat_analysis/model_results/terrain_classification/terrain_classification_cyglidar_model_90.model"; // Model Path for Jetson Nano
     
     loadSVMModel(model_path);
+    buildReducedPrecisionModel();
+    buildRandomFeatures();
+    if (!random_features_ready) {
+        buildDecisionLUT(model_path);
+    }
     
     ROS_INFO("Expected label is: %d", expected_label);
 
@@ -639,6 +1872,7 @@ int main(int argc, char** argv) {
     
     pub_after_combined_passthrough = nh.advertise<sensor_msgs::PointCloud2>("/combined_passthrough", 1);
     pub_after_parallel_downsampling = nh.advertise<sensor_msgs::PointCloud2>("/parallel_downsampled_cloud", 1);
+    pub_terrain_grid = nh.advertise<stat_analysis::TerrainGrid>("/terrain_grid", 1);
 
     // Subscribing to Lidar Sensor topic
     // ros::Subscriber sub = nh.subscribe<sensor_msgs::PointCloud2>("/scan_3D", 1, boost::bind(pointcloud_callback, _1, boost::ref(nh))); // CygLidar D1 subscriber
@@ -212,9 +212,12 @@
 #include <pcl/point_types.h>
 #include <pcl/filters/passthrough.h>
 #include <pcl/features/normal_3d_omp.h>
-#include <pcl/kdtree/kdtree_flann.h>
+#include <pcl/search/kdtree.h>
 #include <pcl/visualization/pcl_visualizer.h>
 #include <vector>
+#include <chrono> // For timing the two estimators
+
+#include "plane_batch.h" // Batched plane solver for the adaptive radius normals
 
 // Global visualizer pointers
 boost::shared_ptr<pcl::visualization::PCLVisualizer> fixed_viewer;
@@ -269,43 +272,35 @@ pcl::PointCloud<pcl::Normal>::Ptr computeNormals(const pcl::PointCloud<pcl::Poin
     return normals;
 }
 
-// Function to dynamically estimate the radius based on the k-nearest neighbors
-double adaptiveRadius(pcl::PointXYZ point, pcl::KdTreeFLANN<pcl::PointXYZ>& kdtree, int k) {
-    std::vector<int> indices(k);
-    std::vector<float> squared_distances(k);
-    
-    if (kdtree.nearestKSearch(point, k, indices, squared_distances) > 0) {
-        // The radius can be adjusted based on your application needs
-        // Here we use the distance to the farthest point in the k-nearest neighbors
-        double radius = sqrt(squared_distances.back());
-        return std::max(radius, 0.01); // Ensure minimum radius of 1 cm
+// Covariances of the adaptive neighbourhoods, kept across frames
+NormalBatchWorkspace adaptive_normal_batch;
+
+// Function to estimate normals with adaptive radius: each point's radius is the distance to its k-th nearest
+// neighbour, so its neighbourhood is exactly its k nearest points and one kNN search per point gathers it. One pass
+// over the points in the same KdTree, then one batched plane solve (plane_batch.h). Normals face the sensor, NaN
+// below three neighbours.
+pcl::PointCloud<pcl::Normal>::Ptr estimateNormalsAdaptive(const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud, int k) {
+    pcl::search::KdTree<pcl::PointXYZ> tree;
+    tree.setInputCloud(cloud);
+
+    const int size = static_cast<int>(cloud->points.size());
+    resizeCovarianceBatch(adaptive_normal_batch.covariances, size);
+
+    #pragma omp parallel
+    {
+        std::vector<int> indices;
+        std::vector<float> squared_distances;
+        #pragma omp for schedule(static)
+        for (int i = 0; i < size; ++i) {
+            const int found = tree.nearestKSearch(cloud->points[i], k, indices, squared_distances);
+            setNeighbourhoodCovariance(*cloud, i, indices, found, adaptive_normal_batch.covariances);
+        }
     }
-    return 0.1; // Default radius if the search fails
-}
-
-// Function to estimate normals with adaptive radius
-void estimateNormalsAdaptive(pcl::PointCloud<pcl::PointXYZ>::Ptr cloud, pcl::PointCloud<pcl::Normal>::Ptr normals, int k) {
-    pcl::NormalEstimationOMP<pcl::PointXYZ, pcl::Normal> ne;
-    ne.setInputCloud(cloud);
-    pcl::search::KdTree<pcl::PointXYZ>::Ptr tree(new pcl::search::KdTree<pcl::PointXYZ>());
-    tree->setInputCloud(cloud);
-    ne.setSearchMethod(tree);
 
-    // Debugging output
-    std::cerr << "Starting normal estimation with " << cloud->points.size() << " points.\n";
-
-    pcl::KdTreeFLANN<pcl::PointXYZ> kdtree;
-    kdtree.setInputCloud(cloud);
-
-    normals->resize(cloud->size());
-    for (size_t i = 0; i < cloud->points.size(); ++i) {
-        double radius = adaptiveRadius(cloud->points[i], kdtree, k);
-        std::cerr << "Using radius: " << radius << " for point " << i << "\n";
-        ne.setRadiusSearch(radius);
-        pcl::PointCloud<pcl::Normal> local_normals;
-        ne.compute(local_normals);
-        (*normals)[i] = local_normals.points[0];
-    }
+    solvePlanesBatch(adaptive_normal_batch.covariances, adaptive_normal_batch.planes);
+    pcl::PointCloud<pcl::Normal>::Ptr normals(new pcl::PointCloud<pcl::Normal>);
+    orientedNormals(*cloud, adaptive_normal_batch.planes, *normals);
+    return normals;
 }
 
 // Initialize viewers
@@ -349,13 +344,19 @@ void pointcloud_callback(const sensor_msgs::PointCloud2ConstPtr& input_msg, ros:
     publishProcessedCloud(cloud_z, pub_after_passthrough_z, input_msg);
 
     // Compute normals
+    auto fixed_start = std::chrono::high_resolution_clock::now();
     pcl::PointCloud<pcl::Normal>::Ptr cloud_normals = computeNormals(cloud_z);
+    std::chrono::duration<double> fixed_time = std::chrono::high_resolution_clock::now() - fixed_start;
     visualizeNormals(cloud_z, cloud_normals, fixed_viewer, "fixed_normals");
 
     // Adaptive normals computation and visualization
-    pcl::PointCloud<pcl::Normal>::Ptr adaptive_normals(new pcl::PointCloud<pcl::Normal>);
+    auto adaptive_start = std::chrono::high_resolution_clock::now();
     pcl::PointCloud<pcl::Normal>::Ptr adaptive_normals = estimateNormalsAdaptive(cloud_z, 50); // Adaptive estimation
+    std::chrono::duration<double> adaptive_time = std::chrono::high_resolution_clock::now() - adaptive_start;
     visualizeNormals(cloud_z, adaptive_normals, adaptive_viewer, "adaptive_normals");
+
+    ROS_INFO("%zu points: fixed k normals %.2f ms, adaptive radius normals %.2f ms", cloud_z->points.size(),
+             fixed_time.count() * 1e3, adaptive_time.count() * 1e3);
 }
 
 int main(int argc, char** argv) {
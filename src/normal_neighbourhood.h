@@ -0,0 +1,100 @@
+#pragma once
+
+// Neighbourhood of the normal estimation.
+//
+// The nodes size k to the cloud (k = N/5 in model_predicting and terrain, N/10 in plane_prob), so every normal
+// is fitted to a fixed share of the cloud and the estimation is O(N^2): both the k-nearest search and the
+// covariance of every point grow with N. After voxel grid downsampling there is at most one point per leaf, so a
+// neighbourhood of fixed metric size holds a bounded number of points whatever the size of the cloud, and the
+// estimation becomes O(N log N) for the tree and O(N) for the normals:
+//   CloudFraction: k = max(min_k, N / cloud_divisor), the original behaviour
+//   CappedK:       the same k, capped at max_k
+//   LeafRadius:    every point within radius_leaves times the largest leaf edge (a radius search)
+// On a surface sampled at the leaf size a radius of 2.5 leaves holds about 20 points, close to max_k. A point with
+// fewer than three neighbours in the radius gets a NaN normal from PCL; fillIsolatedNormals fits those to their
+// min_k nearest neighbours instead, so the classifier never sees a NaN feature.
+// The SVM is trained on the normals terrain.cpp computes, so terrain and model_predicting must use the same
+// mode; normal_neighbourhood_benchmark measures how far the normals and the predicted labels of the bounded
+// modes are from CloudFraction before switching.
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/features/normal_3d.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+enum class NeighbourhoodMode { CloudFraction, CappedK, LeafRadius };
+
+struct NormalNeighbourhoodConfig {
+    NeighbourhoodMode mode = NeighbourhoodMode::CloudFraction;
+    int cloud_divisor = 5;        // CloudFraction and CappedK: k = N / cloud_divisor ...
+    int min_k = 10;               // ... but at least min_k
+    int max_k = 30;               // CappedK: and at most max_k
+    float radius_leaves = 2.5f;   // LeafRadius: search radius in leaf edges
+};
+
+// Either a k (radius 0) or a radius (k 0), as NormalEstimation wants them
+struct NormalNeighbourhood {
+    int k;
+    double radius;
+};
+
+// Neighbourhood for a cloud of num_points points downsampled with leaf_size (the largest leaf edge)
+inline NormalNeighbourhood normalNeighbourhood(const NormalNeighbourhoodConfig& config, size_t num_points, float leaf_size) {
+    if (config.mode == NeighbourhoodMode::LeafRadius) {
+        return {0, static_cast<double>(config.radius_leaves * leaf_size)};
+    }
+    int k = std::max(config.min_k, static_cast<int>(num_points / config.cloud_divisor));
+    if (config.mode == NeighbourhoodMode::CappedK) {
+        k = std::min(k, std::max(config.min_k, config.max_k));
+    }
+    return {k, 0.0};
+}
+
+// Sets the neighbourhood on a pcl::NormalEstimation or NormalEstimationOMP. Both parameters are always set,
+// since the estimator refuses to compute with both a k and a radius left over from an earlier frame.
+template <typename NormalEstimator>
+inline void setNormalNeighbourhood(NormalEstimator& ne, const NormalNeighbourhood& neighbourhood) {
+    ne.setKSearch(neighbourhood.k);
+    ne.setRadiusSearch(neighbourhood.radius);
+}
+
+// Replaces the non-finite normals of a radius search with k-nearest fits. The tree must still index the cloud the
+// normals were computed on (the estimator's search method after compute). Returns the number of normals replaced.
+template <typename Search>
+inline int fillIsolatedNormals(const pcl::PointCloud<pcl::PointXYZ>& cloud, Search& tree, int k,
+                               pcl::PointCloud<pcl::Normal>& normals) {
+    std::vector<int> indices;
+    std::vector<float> distances;
+    int filled = 0;
+    for (size_t i = 0; i < normals.points.size() && i < cloud.points.size(); ++i) {
+        pcl::Normal& normal = normals.points[i];
+        if (std::isfinite(normal.normal_x) && std::isfinite(normal.normal_y) && std::isfinite(normal.normal_z)) {
+            continue;
+        }
+        if (tree.nearestKSearch(cloud.points[i], k, indices, distances) < 3) {
+            continue; // Fewer than three points in the whole cloud: nothing to fit
+        }
+        Eigen::Vector4f plane;
+        float curvature;
+        pcl::computePointNormal(cloud, indices, plane, curvature);
+        pcl::flipNormalTowardsViewpoint(cloud.points[i], 0.0f, 0.0f, 0.0f, plane);
+        normal.normal_x = plane[0];
+        normal.normal_y = plane[1];
+        normal.normal_z = plane[2];
+        normal.curvature = curvature;
+        filled++;
+    }
+    return filled;
+}
+
+inline const char* neighbourhoodModeName(NeighbourhoodMode mode) {
+    switch (mode) {
+        case NeighbourhoodMode::CappedK: return "capped k";
+        case NeighbourhoodMode::LeafRadius: return "leaf radius";
+        default: return "cloud fraction";
+    }
+}
@@ -0,0 +1,226 @@
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/search/kdtree.h>
+#include <pcl/features/normal_3d_omp.h>
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include <svm.h>
+
+#include "cloud_filters.h"
+#include "normal_neighbourhood.h"
+#include "benchmark_frames.h" // Frame loading and timing
+
+// Accuracy and scaling study of the normal estimation neighbourhoods (normal_neighbourhood.h) on recorded frames:
+//   cloud fraction: k = N/5, what model_predicting and terrain use and what the model is trained on
+//   capped k:       the same k, at most 30
+//   leaf radius:    all points within 2.5 leaf edges
+// Frames are cropped and downsampled like model_predicting.cpp, once at its leaf size and at two finer ones, so
+// the same frame gives clouds of growing size: the cloud fraction time grows with N^2, the bounded ones with N.
+// For every frame and leaf size it prints the time of each mode and, for the bounded modes, how close their
+// normals are to the cloud fraction normals: the mean angle between them and the mean change of normal_x and
+// normal_y, the two classifier features. With a model file it also predicts every normal with the model and
+// prints the share of labels the bounded modes leave unchanged.
+// Frames are RoboSense PCD files (see BENCHMARKS.md).
+// Usage: normal_neighbourhood_benchmark [model_file] <frame.pcd> [frame.pcd ...]
+
+// model_predicting.cpp crop box and leaf size
+const CropBox BOX = {1.5f, 3.0f, -0.6f, 0.6f, -0.7f, 0.2f};
+const float LEAF_X = 0.13f, LEAF_Y = 0.13f, LEAF_Z = 0.05f;
+const float LEAF_SCALES[] = {1.0f, 0.5f, 0.25f};
+const int NUM_SCALES = 3;
+
+const NeighbourhoodMode MODES[] = {NeighbourhoodMode::CloudFraction, NeighbourhoodMode::CappedK, NeighbourhoodMode::LeafRadius};
+const int NUM_MODES = 3;
+
+const int REPETITIONS = 5;
+
+typedef pcl::PointCloud<pcl::PointXYZ> Cloud;
+typedef pcl::PointCloud<pcl::Normal> Normals;
+
+struct ModeResult {
+    double time = 0.0;
+    double angle = 0.0;            // Mean angle to the cloud fraction normals (degrees)
+    double feature_change = 0.0;   // Mean |change| of normal_x and normal_y
+    double label_agreement = 0.0;  // Share of labels equal to the cloud fraction labels
+    int neighbours = 0;            // k, or 0 for the radius search
+};
+
+struct ScaleTotals {
+    int frames = 0;
+    double points = 0.0;
+    ModeResult modes[NUM_MODES];
+};
+
+double computeNormals(const Cloud::Ptr& cloud, const NormalNeighbourhood& neighbourhood, int min_k, Normals& normals) {
+    pcl::NormalEstimationOMP<pcl::PointXYZ, pcl::Normal> ne;
+    pcl::search::KdTree<pcl::PointXYZ>::Ptr tree(new pcl::search::KdTree<pcl::PointXYZ>);
+    return secondsPerCall(REPETITIONS, [&] {
+        ne.setInputCloud(cloud);
+        ne.setSearchMethod(tree);
+        setNormalNeighbourhood(ne, neighbourhood);
+        ne.compute(normals);
+        if (neighbourhood.radius > 0.0) {
+            fillIsolatedNormals(*cloud, *tree, min_k, normals);
+        }
+    });
+}
+
+void predictLabels(const svm_model* model, const Normals& normals, std::vector<double>& labels) {
+    labels.resize(normals.points.size());
+    for (size_t i = 0; i < normals.points.size(); ++i) {
+        svm_node nodes[3];
+        nodes[0].index = 1;
+        nodes[0].value = normals.points[i].normal_x;
+        nodes[1].index = 2;
+        nodes[1].value = normals.points[i].normal_y;
+        nodes[2].index = -1;
+        labels[i] = svm_predict(model, nodes);
+    }
+}
+
+// Angle and feature change of the normals against the reference, over the points finite in both
+void compareNormals(const Normals& reference, const Normals& normals, ModeResult& result) {
+    size_t count = 0;
+    double angle_sum = 0.0, change_sum = 0.0;
+    for (size_t i = 0; i < reference.points.size() && i < normals.points.size(); ++i) {
+        const pcl::Normal& a = reference.points[i];
+        const pcl::Normal& b = normals.points[i];
+        if (!std::isfinite(a.normal_x) || !std::isfinite(b.normal_x)) {
+            continue;
+        }
+        const double dot = a.normal_x * b.normal_x + a.normal_y * b.normal_y + a.normal_z * b.normal_z;
+        angle_sum += std::acos(std::min(1.0, std::max(-1.0, dot))) * 180.0 / M_PI;
+        change_sum += 0.5 * (std::fabs(a.normal_x - b.normal_x) + std::fabs(a.normal_y - b.normal_y));
+        count++;
+    }
+    result.angle = count > 0 ? angle_sum / count : 0.0;
+    result.feature_change = count > 0 ? change_sum / count : 0.0;
+}
+
+int main(int argc, char** argv) {
+    svm_model* model = nullptr;
+    int first_frame = 1;
+    if (argc > 1) {
+        const std::string first = argv[1];
+        if (first.size() < 4 || first.compare(first.size() - 4, 4, ".pcd") != 0) {
+            model = svm_load_model(argv[1]);
+            if (model == nullptr) {
+                std::cerr << "Cannot load model " << argv[1] << std::endl;
+                return 1;
+            }
+            first_frame = 2;
+        }
+    }
+    if (argc <= first_frame) {
+        std::cerr << "Usage: normal_neighbourhood_benchmark [model_file] <frame.pcd> [frame.pcd ...]" << std::endl;
+        return 1;
+    }
+
+    NormalNeighbourhoodConfig configs[NUM_MODES];
+    for (int m = 0; m < NUM_MODES; ++m) {
+        configs[m].mode = MODES[m];
+    }
+
+    ScaleTotals totals[NUM_SCALES];
+    for (int f = first_frame; f < argc; ++f) {
+        Cloud raw;
+        if (!loadFrame(argv[f], raw)) {
+            continue;
+        }
+        CloudSoA survivors;
+        cropToSoA(raw, BOX, survivors);
+
+        for (int s = 0; s < NUM_SCALES; ++s) {
+            const float scale = LEAF_SCALES[s];
+            Cloud::Ptr cloud(new Cloud);
+            VoxelGridWorkspace voxel_grid;
+            voxelGridDownsample(survivors, LEAF_X * scale, LEAF_Y * scale, LEAF_Z * scale, *cloud, voxel_grid);
+            if (cloud->points.size() < 3) {
+                continue;
+            }
+
+            Normals normals[NUM_MODES];
+            std::vector<double> labels[NUM_MODES];
+            ModeResult results[NUM_MODES];
+            for (int m = 0; m < NUM_MODES; ++m) {
+                const NormalNeighbourhood neighbourhood = normalNeighbourhood(configs[m], cloud->points.size(), LEAF_X * scale);
+                results[m].neighbours = neighbourhood.k;
+                results[m].time = computeNormals(cloud, neighbourhood, configs[m].min_k, normals[m]);
+                if (model != nullptr) {
+                    predictLabels(model, normals[m], labels[m]);
+                }
+            }
+
+            std::cout << argv[f] << ", leaf x" << scale << ": " << cloud->points.size() << " points";
+            for (int m = 0; m < NUM_MODES; ++m) {
+                ModeResult& result = results[m];
+                if (m > 0) {
+                    compareNormals(normals[0], normals[m], result);
+                    if (model != nullptr) {
+                        size_t equal = 0;
+                        for (size_t i = 0; i < labels[0].size(); ++i) {
+                            equal += labels[0][i] == labels[m][i] ? 1 : 0;
+                        }
+                        result.label_agreement = static_cast<double>(equal) / labels[0].size();
+                    }
+                } else {
+                    result.label_agreement = 1.0;
+                }
+
+                std::cout << "; " << neighbourhoodModeName(MODES[m]);
+                if (result.neighbours > 0) {
+                    std::cout << " (k " << result.neighbours << ")";
+                }
+                std::cout << " " << result.time * 1e3 << " ms";
+                if (m > 0) {
+                    std::cout << ", angle " << result.angle << " deg, feature change " << result.feature_change;
+                    if (model != nullptr) {
+                        std::cout << ", " << 100.0 * result.label_agreement << "% labels unchanged";
+                    }
+                }
+
+                totals[s].modes[m].time += result.time;
+                totals[s].modes[m].angle += result.angle;
+                totals[s].modes[m].feature_change += result.feature_change;
+                totals[s].modes[m].label_agreement += result.label_agreement;
+            }
+            std::cout << std::endl;
+            totals[s].frames++;
+            totals[s].points += cloud->points.size();
+        }
+    }
+
+    if (!anyFramesRead(totals[0].frames)) {
+        return 1;
+    }
+
+    // Per leaf size: mean cloud size and time per point of every mode. Constant time per point is linear growth.
+    for (int s = 0; s < NUM_SCALES; ++s) {
+        const ScaleTotals& total = totals[s];
+        if (total.frames == 0) {
+            continue;
+        }
+        std::cout << "Leaf x" << LEAF_SCALES[s] << ", " << total.frames << " frames, mean " << total.points / total.frames << " points:";
+        for (int m = 0; m < NUM_MODES; ++m) {
+            const ModeResult& mode = total.modes[m];
+            std::cout << (m > 0 ? ";" : "") << " " << neighbourhoodModeName(MODES[m]) << " " << mode.time / total.frames * 1e3
+                      << " ms (" << mode.time / total.points * 1e6 << " us/point)";
+            if (m > 0) {
+                std::cout << ", angle " << mode.angle / total.frames << " deg, feature change " << mode.feature_change / total.frames;
+                if (model != nullptr) {
+                    std::cout << ", " << 100.0 * mode.label_agreement / total.frames << "% labels unchanged";
+                }
+            }
+        }
+        std::cout << std::endl;
+    }
+
+    if (model != nullptr) {
+        svm_free_and_destroy_model(&model);
+    }
+    return 0;
+}
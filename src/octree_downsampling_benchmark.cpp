@@ -0,0 +1,185 @@
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/filters/voxel_grid.h>
+#include <pcl/octree/octree_pointcloud_voxelcentroid.h>
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <algorithm>
+
+#include "incremental_octree.h"
+#include "voxel_key.h"
+#include "benchmark_frames.h" // Frame loading and timing
+
+// Compares the axis downsampling of stat_mod.cpp on a sequence of recorded frames:
+//   voxel grid:         downsamplingAlongAxis (pcl::VoxelGrid with x limits)
+//   octree:             OctreePointCloudVoxelCentroid built from scratch every frame
+//   incremental octree: IncrementalVoxelCentroidOctree kept across the sequence
+// It prints per-frame latency, how many octree leaves were reused from the previous frame, and how the octree
+// output agrees with the voxel grid (voxels present in both, largest centroid difference).
+// Frames must be consecutive CygLidar scans (PCD files, see BENCHMARKS.md).
+// Usage: octree_downsampling_benchmark <frame.pcd> [frame.pcd ...]   (in recording order)
+
+// stat_mod.cpp settings: y passthrough, x limits and leaf size of downsamplingAlongAxis, octree bounding box
+const float MIN_Y = -0.2f, MAX_Y = 0.5f;
+const float MIN_X = 0.0f, MAX_X = 2.3f;
+const float LEAF_SIZE = 0.05f;
+const double BOX_MIN[3] = {0.0, -1.6, -1.6};
+const double BOX_MAX[3] = {3.2, 1.6, 1.6};
+
+const int REPETITIONS = 10;
+
+typedef pcl::PointCloud<pcl::PointXYZ> Cloud;
+
+void voxelGridAlongX(const Cloud::Ptr& cloud, Cloud& output) {
+    pcl::VoxelGrid<pcl::PointXYZ> voxel_grid;
+    voxel_grid.setInputCloud(cloud);
+    voxel_grid.setLeafSize(LEAF_SIZE, LEAF_SIZE, LEAF_SIZE);
+    voxel_grid.setFilterFieldName("x");
+    voxel_grid.setFilterLimits(MIN_X, MAX_X);
+    voxel_grid.filter(output);
+}
+
+void xLimitIndices(const Cloud& cloud, std::vector<int>& indices) {
+    indices.clear();
+    for (int i = 0; i < static_cast<int>(cloud.points.size()); ++i) {
+        if (cloud.points[i].x >= MIN_X && cloud.points[i].x <= MAX_X) {
+            indices.push_back(i);
+        }
+    }
+}
+
+void octreeAlongX(const Cloud::Ptr& cloud, Cloud& output) {
+    pcl::IndicesPtr indices(new std::vector<int>);
+    xLimitIndices(*cloud, *indices);
+    pcl::octree::OctreePointCloudVoxelCentroid<pcl::PointXYZ> octree(LEAF_SIZE);
+    octree.defineBoundingBox(BOX_MIN[0], BOX_MIN[1], BOX_MIN[2], BOX_MAX[0], BOX_MAX[1], BOX_MAX[2]);
+    octree.setInputCloud(cloud, indices);
+    octree.addPointsFromInputCloud();
+    octree.getVoxelCentroids(output.points);
+}
+
+// Voxel of a centroid on the LEAF_SIZE grid anchored at the origin (the grid both methods use here). Centroids
+// come from the crop box, so they are always inside the key range.
+uint64_t voxelKey(const pcl::PointXYZ& point) {
+    uint64_t key = EMPTY_VOXEL_KEY;
+    packVoxelKey(static_cast<int64_t>(std::floor(point.x / LEAF_SIZE)), static_cast<int64_t>(std::floor(point.y / LEAF_SIZE)),
+                 static_cast<int64_t>(std::floor(point.z / LEAF_SIZE)), key);
+    return key;
+}
+
+// Voxels in both outputs and the largest distance between their centroids
+void compareOutputs(const Cloud& reference, const Cloud& output, size_t& matched, double& max_difference) {
+    std::unordered_map<uint64_t, pcl::PointXYZ> reference_voxels;
+    for (const pcl::PointXYZ& point : reference.points) {
+        reference_voxels[voxelKey(point)] = point;
+    }
+    matched = 0;
+    max_difference = 0.0;
+    for (const pcl::PointXYZ& point : output.points) {
+        auto found = reference_voxels.find(voxelKey(point));
+        if (found != reference_voxels.end()) {
+            matched++;
+            const double dx = point.x - found->second.x, dy = point.y - found->second.y, dz = point.z - found->second.z;
+            max_difference = std::max(max_difference, std::sqrt(dx * dx + dy * dy + dz * dz));
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: octree_downsampling_benchmark <frame.pcd> [frame.pcd ...]" << std::endl;
+        return 1;
+    }
+
+    // The y passthrough runs before the axis downsampling in stat_mod, so it is applied once up front
+    std::vector<Cloud::Ptr> frames;
+    std::vector<std::string> frame_names;
+    for (int f = 1; f < argc; ++f) {
+        Cloud raw;
+        if (!loadFrame(argv[f], raw)) {
+            continue;
+        }
+        Cloud::Ptr cropped(new Cloud);
+        for (const pcl::PointXYZ& point : raw.points) {
+            if (point.y >= MIN_Y && point.y <= MAX_Y) {
+                cropped->points.push_back(point);
+            }
+        }
+        cropped->width = cropped->points.size();
+        cropped->height = 1;
+        frames.push_back(cropped);
+        frame_names.push_back(argv[f]);
+    }
+    if (!anyFramesRead(static_cast<int>(frames.size()))) {
+        return 1;
+    }
+    const size_t num_frames = frames.size();
+
+    std::vector<Cloud> grid_outputs(num_frames), octree_outputs(num_frames), incremental_outputs(num_frames);
+    std::vector<double> grid_times(num_frames, 0.0), octree_times(num_frames, 0.0), incremental_times(num_frames, 0.0);
+    std::vector<size_t> new_leaves(num_frames, 0);
+
+    for (int r = 0; r < REPETITIONS; ++r) {
+        // A fresh incremental octree per repetition, so the first frame is always a full build
+        IncrementalVoxelCentroidOctree<pcl::PointXYZ> incremental_octree(LEAF_SIZE, BOX_MIN[0], BOX_MIN[1], BOX_MIN[2],
+                                                                         BOX_MAX[0], BOX_MAX[1], BOX_MAX[2]);
+        pcl::IndicesPtr indices(new std::vector<int>);
+
+        for (size_t f = 0; f < num_frames; ++f) {
+            auto start = std::chrono::steady_clock::now();
+            voxelGridAlongX(frames[f], grid_outputs[f]);
+            grid_times[f] += secondsSince(start) / REPETITIONS;
+
+            start = std::chrono::steady_clock::now();
+            octreeAlongX(frames[f], octree_outputs[f]);
+            octree_times[f] += secondsSince(start) / REPETITIONS;
+
+            start = std::chrono::steady_clock::now();
+            xLimitIndices(*frames[f], *indices);
+            incremental_octree.update(frames[f], indices);
+            incremental_octree.getVoxelCentroids(incremental_outputs[f]);
+            incremental_times[f] += secondsSince(start) / REPETITIONS;
+            new_leaves[f] = incremental_octree.newLeafCount();
+        }
+    }
+
+    double total_grid = 0.0, total_octree = 0.0, total_incremental = 0.0;
+    size_t total_voxels = 0, total_reused = 0, total_matched = 0, total_grid_voxels = 0;
+    for (size_t f = 0; f < num_frames; ++f) {
+        const size_t voxels = incremental_outputs[f].points.size();
+        const size_t reused = voxels - new_leaves[f];
+        size_t matched;
+        double max_difference;
+        compareOutputs(grid_outputs[f], incremental_outputs[f], matched, max_difference);
+
+        std::cout << frame_names[f] << ": voxel grid " << grid_times[f] * 1e3 << " ms, octree " << octree_times[f] * 1e3
+                  << " ms, incremental " << incremental_times[f] * 1e3 << " ms; " << reused << "/" << voxels
+                  << " leaves reused; " << matched << "/" << grid_outputs[f].points.size()
+                  << " voxel grid voxels matched, max centroid difference " << max_difference << " m" << std::endl;
+
+        total_grid += grid_times[f];
+        total_octree += octree_times[f];
+        total_incremental += incremental_times[f];
+        total_voxels += voxels;
+        total_reused += (f > 0) ? reused : 0; // The first frame has nothing to reuse
+        total_matched += matched;
+        total_grid_voxels += grid_outputs[f].points.size();
+    }
+
+    size_t voxels_after_first = total_voxels - incremental_outputs[0].points.size();
+    std::cout << num_frames << " frames: mean voxel grid " << total_grid / num_frames * 1e3 << " ms, octree "
+              << total_octree / num_frames * 1e3 << " ms, incremental octree " << total_incremental / num_frames * 1e3
+              << " ms (" << total_grid / total_incremental << "x vs voxel grid, " << total_octree / total_incremental
+              << "x vs rebuilt octree); "
+              << (voxels_after_first > 0 ? 100.0 * total_reused / voxels_after_first : 0.0)
+              << "% of leaves reused after the first frame; " << total_matched << "/" << total_grid_voxels
+              << " voxel grid voxels matched" << std::endl;
+
+    return 0;
+}
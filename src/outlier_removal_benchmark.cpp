@@ -0,0 +1,171 @@
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/filters/statistical_outlier_removal.h>
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <algorithm>
+
+#include "grid_outlier_removal.h"
+#include "benchmark_frames.h" // Frame loading and timing
+
+// Compares the outlier removal of stats1.cpp on recorded frames:
+//   statistical: pcl::StatisticalOutlierRemoval, mean K 50, 3 standard deviations
+//   grid hash:   gridOutlierRemoval (grid_outlier_removal.h)
+// once on the raw frames (where stats1 runs it) and once on the frames cropped by stats1's z and y passthrough.
+// For every frame it prints the time of both, the speedup and how the kept points agree: points kept by both,
+// removed by both, removed only by the statistical filter and removed only by the grid.
+// Frames are CygLidar PCD files (see BENCHMARKS.md).
+// Usage: outlier_removal_benchmark [cell_size] <frame.pcd> [frame.pcd ...]
+
+// stats1.cpp passthrough limits
+const float MIN_Z = -3.0f, MAX_Z = 0.0f;
+const float MIN_Y = -0.7f, MAX_Y = 0.7f;
+
+const int REPETITIONS = 10;
+
+typedef pcl::PointCloud<pcl::PointXYZ> Cloud;
+
+struct Agreement {
+    size_t kept_by_both = 0;
+    size_t removed_by_both = 0;
+    size_t removed_by_statistical_only = 0;
+    size_t removed_by_grid_only = 0;
+
+    void add(const Agreement& other) {
+        kept_by_both += other.kept_by_both;
+        removed_by_both += other.removed_by_both;
+        removed_by_statistical_only += other.removed_by_statistical_only;
+        removed_by_grid_only += other.removed_by_grid_only;
+    }
+
+    size_t total() const {
+        return kept_by_both + removed_by_both + removed_by_statistical_only + removed_by_grid_only;
+    }
+};
+
+struct Comparison {
+    double statistical_time = 0.0;
+    double grid_time = 0.0;
+    Agreement agreement;
+};
+
+Cloud::Ptr cropLikeStats1(const Cloud& cloud) {
+    Cloud::Ptr cropped(new Cloud);
+    for (const pcl::PointXYZ& point : cloud.points) {
+        if (point.z >= MIN_Z && point.z <= MAX_Z && point.y >= MIN_Y && point.y <= MAX_Y) {
+            cropped->points.push_back(point);
+        }
+    }
+    cropped->width = cropped->points.size();
+    cropped->height = 1;
+    return cropped;
+}
+
+Comparison compareOnCloud(const Cloud::Ptr& cloud, const GridOutlierConfig& config) {
+    Comparison comparison;
+    std::vector<int> statistical_kept, grid_kept;
+    GridOutlierWorkspace workspace;
+
+    comparison.statistical_time = secondsPerCall(REPETITIONS, [&] {
+        pcl::StatisticalOutlierRemoval<pcl::PointXYZ> sor;
+        sor.setInputCloud(cloud);
+        sor.setMeanK(50);
+        sor.setStddevMulThresh(3);
+        sor.filter(statistical_kept);
+    });
+    comparison.grid_time = secondsPerCall(REPETITIONS, [&] { gridOutlierRemoval(*cloud, config, workspace, grid_kept); });
+
+    std::vector<char> kept_by_statistical(cloud->points.size(), 0), kept_by_grid(cloud->points.size(), 0);
+    for (int index : statistical_kept) {
+        kept_by_statistical[index] = 1;
+    }
+    for (int index : grid_kept) {
+        kept_by_grid[index] = 1;
+    }
+    for (size_t i = 0; i < cloud->points.size(); ++i) {
+        if (kept_by_statistical[i] && kept_by_grid[i]) {
+            comparison.agreement.kept_by_both++;
+        } else if (kept_by_statistical[i]) {
+            comparison.agreement.removed_by_grid_only++;
+        } else if (kept_by_grid[i]) {
+            comparison.agreement.removed_by_statistical_only++;
+        } else {
+            comparison.agreement.removed_by_both++;
+        }
+    }
+    return comparison;
+}
+
+void printComparison(const std::string& name, size_t points, const Comparison& comparison) {
+    const Agreement& agreement = comparison.agreement;
+    std::cout << name << ": " << points << " points, statistical " << comparison.statistical_time * 1e3 << " ms, grid "
+              << comparison.grid_time * 1e3 << " ms, speedup " << comparison.statistical_time / comparison.grid_time << "x; "
+              << agreement.kept_by_both << " kept by both, " << agreement.removed_by_both << " removed by both, "
+              << agreement.removed_by_statistical_only << " removed only by statistical, "
+              << agreement.removed_by_grid_only << " removed only by grid" << std::endl;
+}
+
+void printSummary(const std::string& name, int frames, const Comparison& total) {
+    const Agreement& agreement = total.agreement;
+    const size_t statistical_removed = agreement.removed_by_both + agreement.removed_by_statistical_only;
+    std::cout << name << ", " << frames << " frames: mean statistical " << total.statistical_time / frames * 1e3
+              << " ms, mean grid " << total.grid_time / frames * 1e3 << " ms, speedup "
+              << total.statistical_time / total.grid_time << "x; "
+              << 100.0 * (agreement.kept_by_both + agreement.removed_by_both) / std::max<size_t>(1, agreement.total())
+              << "% of points classified alike, "
+              << 100.0 * agreement.removed_by_both / std::max<size_t>(1, statistical_removed)
+              << "% of the statistical outliers also removed by the grid" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    GridOutlierConfig config;
+    int first_frame = 1;
+    if (argc > 1) {
+        char* end;
+        const double cell_size = std::strtod(argv[1], &end);
+        if (*end == '\0') {
+            config.cell_size = static_cast<float>(cell_size);
+            first_frame = 2;
+        }
+    }
+    if (argc <= first_frame || config.cell_size <= 0.0f) {
+        std::cerr << "Usage: outlier_removal_benchmark [cell_size] <frame.pcd> [frame.pcd ...]" << std::endl;
+        return 1;
+    }
+
+    int frames = 0;
+    Comparison raw_total, cropped_total;
+    for (int f = first_frame; f < argc; ++f) {
+        Cloud::Ptr cloud(new Cloud);
+        if (!loadFrame(argv[f], *cloud)) {
+            continue;
+        }
+        Cloud::Ptr cropped = cropLikeStats1(*cloud);
+
+        Comparison raw = compareOnCloud(cloud, config);
+        Comparison after_crop = compareOnCloud(cropped, config);
+        printComparison(std::string(argv[f]) + " raw", cloud->points.size(), raw);
+        printComparison(std::string(argv[f]) + " cropped", cropped->points.size(), after_crop);
+
+        raw_total.statistical_time += raw.statistical_time;
+        raw_total.grid_time += raw.grid_time;
+        raw_total.agreement.add(raw.agreement);
+        cropped_total.statistical_time += after_crop.statistical_time;
+        cropped_total.grid_time += after_crop.grid_time;
+        cropped_total.agreement.add(after_crop.agreement);
+        frames++;
+    }
+
+    if (!anyFramesRead(frames)) {
+        return 1;
+    }
+
+    std::cout << "Cell size " << config.cell_size << " m" << std::endl;
+    printSummary("Raw frames", frames, raw_total);
+    printSummary("Cropped frames", frames, cropped_total);
+
+    return 0;
+}
@@ -0,0 +1,305 @@
+#pragma once
+
+// Batched plane fits.
+//
+// Every normal and plane fit in the nodes ends in the eigen decomposition of a 3x3 covariance, solved one point at
+// a time: pcl::solvePlaneParameters inside NormalEstimation, the range image and the plane smoothing, pcl::PCA in
+// archive.cpp. solvePlanesBatch takes the covariances of many points as structure-of-arrays and returns for each
+// the eigenvector of the smallest eigenvalue (the plane normal) and the curvature (smallest eigenvalue / trace),
+// the two outputs of solvePlaneParameters:
+//   - the matrix is scaled by the sum of its coefficient magnitudes and the smallest eigenvalue comes from the trigonometric
+//     closed form of the characteristic cubic (Cardano, in Smith's form), with branch-free polynomial acos, cos
+//     and sin instead of the libm calls, which do not vectorize
+//   - the normal is the largest of the cross products of two rows of (A - lambda I). The curvature is the Rayleigh
+//     quotient of that normal over the trace, which stays accurate when the smallest eigenvalue is many orders
+//     below the others (a flat patch), where the closed-form eigenvalue itself has lost its digits to cancellation
+// Like svm_quantized.h the kernel uses no intrinsics: the loop is written to auto-vectorize, 8 or 16 lanes on x86
+// and 4 on NEON (Jetson). A covariance whose two smallest eigenvalues (nearly) coincide, a line or an isotropic
+// blob, has no well defined cross product; the few of those are solved again with Eigen's iterative solver after
+// the batch. A non-finite covariance (setInvalidCovariance, for points with too few neighbours) gives NaN.
+// The normals are not oriented: flip them towards the viewpoint afterwards, like the PCL estimators do.
+//
+// estimateNormalsBatch is NormalEstimation(OMP) on top of it: neighbours and covariances per point in parallel,
+// then one batched solve.
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/features/normal_3d.h>
+
+#include <Eigen/Core>
+#include <Eigen/Eigenvalues>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+const int PLANE_BATCH_BLOCK = 256; // Covariances per vectorized loop, and per OpenMP work item
+
+// Upper triangles of symmetric 3x3 covariances, one entry per point
+struct CovarianceBatch {
+    std::vector<float> xx, xy, xz, yy, yz, zz;
+};
+
+// Normal and curvature per covariance
+struct PlaneBatch {
+    std::vector<float> normal_x, normal_y, normal_z, curvature;
+    int iterative_solves = 0; // Degenerate covariances the last solve handed to Eigen
+};
+
+inline void resizeCovarianceBatch(CovarianceBatch& batch, size_t size) {
+    batch.xx.resize(size);
+    batch.xy.resize(size);
+    batch.xz.resize(size);
+    batch.yy.resize(size);
+    batch.yz.resize(size);
+    batch.zz.resize(size);
+}
+
+inline void setCovariance(CovarianceBatch& batch, size_t i, const Eigen::Matrix3f& covariance) {
+    batch.xx[i] = covariance(0, 0);
+    batch.xy[i] = covariance(0, 1);
+    batch.xz[i] = covariance(0, 2);
+    batch.yy[i] = covariance(1, 1);
+    batch.yz[i] = covariance(1, 2);
+    batch.zz[i] = covariance(2, 2);
+}
+
+inline void setInvalidCovariance(CovarianceBatch& batch, size_t i) {
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    batch.xx[i] = batch.xy[i] = batch.xz[i] = batch.yy[i] = batch.yz[i] = batch.zz[i] = nan;
+}
+
+// sqrt of x >= 0 without the errno check of std::sqrt, whose branch keeps the loop from vectorizing: reciprocal
+// square root guessed from the exponent bits and refined by three Newton steps (relative error ~1e-7, sqrt(0) = 0)
+inline float sqrtFloat(float x) {
+    int32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    bits = 0x5f375a86 - (bits >> 1);
+    float y;
+    std::memcpy(&y, &bits, sizeof(y));
+    const float half = 0.5f * x;
+    y = y * (1.5f - half * y * y);
+    y = y * (1.5f - half * y * y);
+    y = y * (1.5f - half * y * y);
+    return x * y;
+}
+
+// max(x, 0) as (x + |x|) / 2: GCC keeps std::max against a constant as a branch under -ftrapping-math
+inline float positivePart(float x) {
+    return 0.5f * (x + std::fabs(x));
+}
+
+// acos of x in [-1, 1] with |error| < 3e-8 rad (Abramowitz & Stegun 4.4.46). |x| is clamped to 1 against rounding,
+// and the negative half, pi - acos(|x|), is taken with copysign rather than a select.
+inline float acosFloat(float x) {
+    const float a = 1.0f - positivePart(1.0f - std::fabs(x));
+    float p = -0.0012624911f;
+    p = p * a + 0.0066700901f;
+    p = p * a - 0.0170881256f;
+    p = p * a + 0.0308918810f;
+    p = p * a - 0.0501743046f;
+    p = p * a + 0.0889789874f;
+    p = p * a - 0.2145988016f;
+    p = p * a + 1.5707963050f;
+    const float r = sqrtFloat(1.0f - a) * p;
+    return 1.57079633f - std::copysign(1.57079633f - r, x);
+}
+
+// Smallest eigenvalue, normal and curvature of covariances begin..end-1. Degenerate ones get a NaN normal.
+// The body has no selects or clamps against constants: GCC does not if-convert those under the default
+// -ftrapping-math, and a single branch leaves the whole loop scalar. A zero or isotropic covariance runs into 0 / 0
+// on the way and comes out NaN like the other degenerate ones.
+inline void solvePlanesClosedForm(const CovarianceBatch& covariances, size_t begin, size_t end, PlaneBatch& planes) {
+    const float* cxx = covariances.xx.data() + begin;
+    const float* cxy = covariances.xy.data() + begin;
+    const float* cxz = covariances.xz.data() + begin;
+    const float* cyy = covariances.yy.data() + begin;
+    const float* cyz = covariances.yz.data() + begin;
+    const float* czz = covariances.zz.data() + begin;
+    float* out_x = planes.normal_x.data() + begin;
+    float* out_y = planes.normal_y.data() + begin;
+    float* out_z = planes.normal_z.data() + begin;
+    float* out_curvature = planes.curvature.data() + begin;
+    const int count = static_cast<int>(end - begin);
+
+    #pragma omp simd
+    for (int i = 0; i < count; ++i) {
+        // Scaled to order one, so the cubic's terms neither overflow nor underflow (a sum, not a max: no selects)
+        const float fxx = std::fabs(cxx[i]), fxy = std::fabs(cxy[i]), fxz = std::fabs(cxz[i]);
+        const float fyy = std::fabs(cyy[i]), fyz = std::fabs(cyz[i]), fzz = std::fabs(czz[i]);
+        const float scale = fxx + fxy + fxz + fyy + fyz + fzz;
+        const float inverse = 1.0f / scale;
+        const float a00 = cxx[i] * inverse, a01 = cxy[i] * inverse, a02 = cxz[i] * inverse;
+        const float a11 = cyy[i] * inverse, a12 = cyz[i] * inverse, a22 = czz[i] * inverse;
+
+        // Eigenvalues m + 2p cos(phi + 2k pi / 3) of A = m I + p B, with det(B) = 2 cos(3 phi)
+        const float trace = a00 + a11 + a22;
+        const float m = trace * (1.0f / 3.0f);
+        const float b00 = a00 - m, b11 = a11 - m, b22 = a22 - m;
+        const float q = (b00 * b00 + b11 * b11 + b22 * b22 + 2.0f * (a01 * a01 + a02 * a02 + a12 * a12)) * (1.0f / 6.0f);
+        const float p = sqrtFloat(q);
+        const float det = b00 * (b11 * b22 - a12 * a12) - a01 * (a01 * b22 - a12 * a02) + a02 * (a01 * a12 - b11 * a02);
+        const float phi = acosFloat(0.5f * det / (q * p)) * (1.0f / 3.0f);
+
+        // cos and sin over phi in [0, pi / 3]: the Taylor terms left out are below 4e-9
+        const float phi2 = phi * phi;
+        const float cos_phi = 1.0f + phi2 * (-0.5f + phi2 * (1.0f / 24.0f + phi2 * (-1.0f / 720.0f + phi2 * (1.0f / 40320.0f + phi2 * (-1.0f / 3628800.0f)))));
+        const float sin_phi = phi * (1.0f + phi2 * (-1.0f / 6.0f + phi2 * (1.0f / 120.0f + phi2 * (-1.0f / 5040.0f + phi2 * (1.0f / 362880.0f + phi2 * (-1.0f / 39916800.0f))))));
+        // Smallest root, k = 1: 2 cos(phi + 2 pi / 3) = -cos(phi) - sqrt(3) sin(phi)
+        const float lambda = m - p * (cos_phi + 1.7320508f * sin_phi);
+
+        // The normal is orthogonal to every row of A - lambda I; the longest cross product is the best conditioned.
+        // It is picked with 0/1 weights.
+        const float r00 = a00 - lambda, r11 = a11 - lambda, r22 = a22 - lambda;
+        const float c0x = a01 * a12 - a02 * r11, c0y = a02 * a01 - r00 * a12, c0z = r00 * r11 - a01 * a01;  // row 0 x row 1
+        const float c1x = a01 * r22 - a02 * a12, c1y = a02 * a02 - r00 * r22, c1z = r00 * a12 - a01 * a02;  // row 0 x row 2
+        const float c2x = r11 * r22 - a12 * a12, c2y = a12 * a02 - a01 * r22, c2z = a01 * a12 - r11 * a02;  // row 1 x row 2
+        const float n0 = c0x * c0x + c0y * c0y + c0z * c0z;
+        const float n1 = c1x * c1x + c1y * c1y + c1z * c1z;
+        const float n2 = c2x * c2x + c2y * c2y + c2z * c2z;
+        const float w0 = static_cast<float>((n0 >= n1) & (n0 >= n2));
+        const float w1 = static_cast<float>((n1 > n0) & (n1 >= n2));
+        const float w2 = 1.0f - w0 - w1;
+        const float vx = w0 * c0x + w1 * c1x + w2 * c2x;
+        const float vy = w0 * c0y + w1 * c1y + w2 * c2y;
+        const float vz = w0 * c0z + w1 * c1z + w2 * c2z;
+        const float norm = w0 * n0 + w1 * n1 + w2 * n2;
+
+        // Coinciding smallest eigenvalues leave all three products at rounding level. invalid is 0 for a solved
+        // covariance and NaN otherwise, from the sign bit of norm - 1e-10, and is added to every output (NaN input
+        // makes NaN outputs anyway).
+        const float margin = norm - 1e-10f;
+        int32_t margin_bits;
+        std::memcpy(&margin_bits, &margin, sizeof(margin_bits));
+        const int32_t invalid_bits = (margin_bits >> 31) & 0x7fc00000;
+        float invalid;
+        std::memcpy(&invalid, &invalid_bits, sizeof(invalid));
+        const float inverse_norm = 1.0f / sqrtFloat(norm);
+        const float nx = vx * inverse_norm, ny = vy * inverse_norm, nz = vz * inverse_norm;
+        const float rayleigh = nx * (a00 * nx + a01 * ny + a02 * nz) + ny * (a01 * nx + a11 * ny + a12 * nz) + nz * (a02 * nx + a12 * ny + a22 * nz);
+
+        out_x[i] = nx + invalid;
+        out_y[i] = ny + invalid;
+        out_z[i] = nz + invalid;
+        out_curvature[i] = positivePart(rayleigh) / trace + invalid;
+    }
+}
+
+// Normal and curvature of every covariance in the batch, in parallel over blocks of PLANE_BATCH_BLOCK. Degenerate
+// but finite covariances are then solved one by one with Eigen.
+inline void solvePlanesBatch(const CovarianceBatch& covariances, PlaneBatch& planes) {
+    const size_t size = covariances.xx.size();
+    planes.normal_x.resize(size);
+    planes.normal_y.resize(size);
+    planes.normal_z.resize(size);
+    planes.curvature.resize(size);
+
+    const int num_blocks = static_cast<int>((size + PLANE_BATCH_BLOCK - 1) / PLANE_BATCH_BLOCK);
+    #pragma omp parallel for schedule(static)
+    for (int block = 0; block < num_blocks; ++block) {
+        const size_t begin = static_cast<size_t>(block) * PLANE_BATCH_BLOCK;
+        solvePlanesClosedForm(covariances, begin, std::min(size, begin + PLANE_BATCH_BLOCK), planes);
+    }
+
+    int iterative_solves = 0;
+    for (size_t i = 0; i < size; ++i) {
+        if (!std::isnan(planes.normal_x[i])) {
+            continue;
+        }
+        Eigen::Matrix3f covariance;
+        covariance << covariances.xx[i], covariances.xy[i], covariances.xz[i],
+                      covariances.xy[i], covariances.yy[i], covariances.yz[i],
+                      covariances.xz[i], covariances.yz[i], covariances.zz[i];
+        if (!covariance.allFinite()) {
+            continue;
+        }
+        Eigen::SelfAdjointEigenSolver<Eigen::Matrix3f> solver(covariance);
+        const Eigen::Vector3f normal = solver.eigenvectors().col(0);
+        const float trace = covariance.trace();
+        planes.normal_x[i] = normal[0];
+        planes.normal_y[i] = normal[1];
+        planes.normal_z[i] = normal[2];
+        planes.curvature[i] = trace > 0.0f ? std::max(0.0f, solver.eigenvalues()[0]) / trace : 0.0f;
+        iterative_solves++;
+    }
+    planes.iterative_solves = iterative_solves;
+}
+
+// Buffers of estimateNormalsBatch, kept across frames
+struct NormalBatchWorkspace {
+    CovarianceBatch covariances;
+    PlaneBatch planes;
+};
+
+// Covariance of the first found neighbours of point i, or an invalid one below three neighbours
+inline void setNeighbourhoodCovariance(const pcl::PointCloud<pcl::PointXYZ>& cloud, int i, const std::vector<int>& indices, int found,
+                                       CovarianceBatch& covariances) {
+    if (found < 3) {
+        setInvalidCovariance(covariances, i);
+        return;
+    }
+
+    // Moments about the query point, which keeps the float sums well conditioned
+    const pcl::PointXYZ& centre = cloud.points[i];
+    Eigen::Vector3f sum = Eigen::Vector3f::Zero();
+    Eigen::Matrix3f squared_sum = Eigen::Matrix3f::Zero();
+    for (int j = 0; j < found; ++j) {
+        const pcl::PointXYZ& point = cloud.points[indices[j]];
+        const Eigen::Vector3f offset(point.x - centre.x, point.y - centre.y, point.z - centre.z);
+        sum += offset;
+        squared_sum += offset * offset.transpose();
+    }
+    const Eigen::Vector3f mean = sum / static_cast<float>(found);
+    setCovariance(covariances, i, squared_sum / static_cast<float>(found) - mean * mean.transpose());
+}
+
+// The solved planes of a cloud as its normals, oriented towards the origin
+inline void orientedNormals(const pcl::PointCloud<pcl::PointXYZ>& cloud, const PlaneBatch& planes, pcl::PointCloud<pcl::Normal>& normals) {
+    const size_t size = cloud.points.size();
+    normals.header = cloud.header;
+    normals.points.resize(size);
+    normals.width = cloud.width;
+    normals.height = cloud.height;
+    normals.is_dense = false;
+    for (size_t i = 0; i < size; ++i) {
+        float nx = planes.normal_x[i], ny = planes.normal_y[i], nz = planes.normal_z[i];
+        if (!std::isnan(nx)) {
+            pcl::flipNormalTowardsViewpoint(cloud.points[i], 0.0f, 0.0f, 0.0f, nx, ny, nz);
+        }
+        pcl::Normal& normal = normals.points[i];
+        normal.normal_x = nx;
+        normal.normal_y = ny;
+        normal.normal_z = nz;
+        normal.curvature = planes.curvature[i];
+    }
+}
+
+// Normals of every point of the cloud from its k nearest neighbours (k > 0) or its neighbours within radius, like
+// NormalEstimationOMP with the same search and neighbourhood: oriented towards the origin, NaN where there are fewer
+// than three neighbours. The search must already index the cloud and allow concurrent queries (pcl::search::KdTree
+// and VoxelHashSearch do).
+template <typename Search>
+inline void estimateNormalsBatch(const pcl::PointCloud<pcl::PointXYZ>& cloud, const Search& search, int k, double radius,
+                                 NormalBatchWorkspace& workspace, pcl::PointCloud<pcl::Normal>& normals) {
+    const int size = static_cast<int>(cloud.points.size());
+    resizeCovarianceBatch(workspace.covariances, size);
+
+    #pragma omp parallel
+    {
+        std::vector<int> indices;
+        std::vector<float> distances;
+        #pragma omp for schedule(static)
+        for (int i = 0; i < size; ++i) {
+            const int found = k > 0 ? search.nearestKSearch(cloud.points[i], k, indices, distances)
+                                    : search.radiusSearch(cloud.points[i], radius, indices, distances);
+            setNeighbourhoodCovariance(cloud, i, indices, found, workspace.covariances);
+        }
+    }
+
+    solvePlanesBatch(workspace.covariances, workspace.planes);
+    orientedNormals(cloud, workspace.planes, normals);
+}
@@ -0,0 +1,202 @@
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/search/kdtree.h>
+#include <pcl/features/normal_3d.h>
+#include <pcl/features/normal_3d_omp.h>
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <algorithm>
+
+#include "cloud_filters.h"
+#include "plane_batch.h"
+#include "benchmark_frames.h" // Frame loading and timing
+
+// Compares the batched closed-form plane solver (plane_batch.h) with PCL's per-point solver on recorded frames.
+// Every frame is cropped and voxel downsampled, once with the leaf size and k = N/5 of model_predicting.cpp and
+// once more at finer leaves with k = FINE_K, the neighbourhood sizes of the smoothing and roughness fits.
+// For every cloud it prints:
+//   solve:   the time to solve the k-NN covariances of all points with pcl::solvePlaneParameters one by one and
+//            with solvePlanesBatch, the mean and largest angle between the two normals, the largest curvature
+//            difference and the number of covariances the batch handed to Eigen
+//   normals: the time of NormalEstimationOMP and of estimateNormalsBatch with the same KdTree and k, and the mean
+//            angle between their normals
+// Frames are RoboSense PCD files (see BENCHMARKS.md).
+// Usage: plane_batch_benchmark <frame.pcd> [frame.pcd ...]
+
+// model_predicting.cpp crop box, leaf size and k rule
+const CropBox BOX = {1.5f, 3.0f, -0.6f, 0.6f, -0.7f, 0.2f};
+const float LEAF_X = 0.13f, LEAF_Y = 0.13f, LEAF_Z = 0.05f;
+const int CLOUD_DIVISOR = 5;
+const int MIN_K = 10;
+
+const float FINE_LEAF_SIZES[] = {0.05f, 0.03f};
+const int NUM_FINE_LEAF_SIZES = 2;
+const int FINE_K = 20;
+
+const int REPETITIONS = 20;
+
+typedef pcl::PointCloud<pcl::PointXYZ> Cloud;
+typedef pcl::PointCloud<pcl::Normal> Normals;
+
+struct Result {
+    size_t points = 0;
+    double pcl_solve = 0.0, batch_solve = 0.0;      // Seconds per call
+    double mean_angle = 0.0, max_angle = 0.0;       // Degrees between the normals of the two solvers
+    double max_curvature_difference = 0.0;
+    int iterative_solves = 0;
+    double pcl_normals = 0.0, batch_normals = 0.0;  // Seconds per call
+    double normals_angle = 0.0;                     // Mean degrees between NormalEstimationOMP and estimateNormalsBatch
+
+    void add(const Result& other) {
+        points += other.points;
+        pcl_solve += other.pcl_solve;
+        batch_solve += other.batch_solve;
+        mean_angle += other.mean_angle;
+        max_angle = std::max(max_angle, other.max_angle);
+        max_curvature_difference = std::max(max_curvature_difference, other.max_curvature_difference);
+        iterative_solves += other.iterative_solves;
+        pcl_normals += other.pcl_normals;
+        batch_normals += other.batch_normals;
+        normals_angle += other.normals_angle;
+    }
+};
+
+// Angle between two unoriented directions, in degrees
+double angleBetween(float ax, float ay, float az, float bx, float by, float bz) {
+    const double dot = std::fabs(static_cast<double>(ax) * bx + static_cast<double>(ay) * by + static_cast<double>(az) * bz);
+    return std::acos(std::min(1.0, dot)) * 180.0 / M_PI;
+}
+
+Result compareSolvers(const Cloud::Ptr& cloud, int k) {
+    Result result;
+    result.points = cloud->points.size();
+    pcl::search::KdTree<pcl::PointXYZ>::Ptr tree(new pcl::search::KdTree<pcl::PointXYZ>);
+    tree->setInputCloud(cloud);
+
+    // The same k-NN covariances for both solvers
+    const size_t size = cloud->points.size();
+    std::vector<Eigen::Matrix3f> matrices(size);
+    CovarianceBatch covariances;
+    resizeCovarianceBatch(covariances, size);
+    std::vector<int> indices;
+    std::vector<float> distances;
+    for (size_t i = 0; i < size; ++i) {
+        tree->nearestKSearch(cloud->points[i], k, indices, distances);
+        Eigen::Vector4f mean;
+        pcl::computeMeanAndCovarianceMatrix(*cloud, indices, matrices[i], mean);
+        setCovariance(covariances, i, matrices[i]);
+    }
+
+    std::vector<Eigen::Vector4f> reference(size);
+    result.pcl_solve = secondsPerCall(REPETITIONS, [&] {
+        for (size_t i = 0; i < size; ++i) {
+            pcl::solvePlaneParameters(matrices[i], reference[i][0], reference[i][1], reference[i][2], reference[i][3]);
+        }
+    });
+
+    PlaneBatch planes;
+    result.batch_solve = secondsPerCall(REPETITIONS, [&] { solvePlanesBatch(covariances, planes); });
+    result.iterative_solves = planes.iterative_solves;
+
+    size_t count = 0;
+    for (size_t i = 0; i < size; ++i) {
+        if (!std::isfinite(reference[i][0]) || !std::isfinite(planes.normal_x[i])) {
+            continue;
+        }
+        const double angle = angleBetween(reference[i][0], reference[i][1], reference[i][2], planes.normal_x[i], planes.normal_y[i], planes.normal_z[i]);
+        result.mean_angle += angle;
+        result.max_angle = std::max(result.max_angle, angle);
+        result.max_curvature_difference = std::max(result.max_curvature_difference, static_cast<double>(std::fabs(reference[i][3] - planes.curvature[i])));
+        count++;
+    }
+    result.mean_angle = count > 0 ? result.mean_angle / count : 0.0;
+
+    // Whole normal estimation with the same tree and k
+    pcl::NormalEstimationOMP<pcl::PointXYZ, pcl::Normal> ne;
+    ne.setInputCloud(cloud);
+    ne.setSearchMethod(tree);
+    ne.setKSearch(k);
+    Normals pcl_normals, batch_normals;
+    NormalBatchWorkspace workspace;
+    result.pcl_normals = secondsPerCall(REPETITIONS, [&] { ne.compute(pcl_normals); });
+    result.batch_normals = secondsPerCall(REPETITIONS, [&] { estimateNormalsBatch(*cloud, *tree, k, 0.0, workspace, batch_normals); });
+
+    count = 0;
+    for (size_t i = 0; i < size; ++i) {
+        const pcl::Normal& a = pcl_normals.points[i];
+        const pcl::Normal& b = batch_normals.points[i];
+        if (std::isfinite(a.normal_x) && std::isfinite(b.normal_x)) {
+            result.normals_angle += angleBetween(a.normal_x, a.normal_y, a.normal_z, b.normal_x, b.normal_y, b.normal_z);
+            count++;
+        }
+    }
+    result.normals_angle = count > 0 ? result.normals_angle / count : 0.0;
+    return result;
+}
+
+void printResult(const std::string& name, const Result& result, int clouds) {
+    std::cout << name << ": " << result.points / clouds << " points; solve pcl " << result.pcl_solve / clouds * 1e3 << " ms, batch "
+              << result.batch_solve / clouds * 1e3 << " ms (" << result.pcl_solve / result.batch_solve << "x), angle mean "
+              << result.mean_angle / clouds << " max " << result.max_angle << " deg, curvature difference max "
+              << result.max_curvature_difference << ", " << result.iterative_solves << " iterative; normals NormalEstimationOMP "
+              << result.pcl_normals / clouds * 1e3 << " ms, batch " << result.batch_normals / clouds * 1e3 << " ms ("
+              << result.pcl_normals / result.batch_normals << "x), mean angle " << result.normals_angle / clouds << " deg" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: plane_batch_benchmark <frame.pcd> [frame.pcd ...]" << std::endl;
+        return 1;
+    }
+
+    int node_clouds = 0;
+    int fine_clouds[NUM_FINE_LEAF_SIZES] = {};
+    Result node_total, fine_total[NUM_FINE_LEAF_SIZES];
+    for (int f = 1; f < argc; ++f) {
+        Cloud raw;
+        if (!loadFrame(argv[f], raw)) {
+            continue;
+        }
+        CloudSoA survivors;
+        cropToSoA(raw, BOX, survivors);
+
+        Cloud::Ptr downsampled(new Cloud);
+        voxelGridDownsample(survivors, LEAF_X, LEAF_Y, LEAF_Z, *downsampled);
+        const int k = std::max(MIN_K, static_cast<int>(downsampled->points.size() / CLOUD_DIVISOR));
+        if (downsampled->points.size() > static_cast<size_t>(k)) {
+            const Result result = compareSolvers(downsampled, k);
+            printResult(std::string(argv[f]) + ", node leaf, k " + std::to_string(k), result, 1);
+            node_total.add(result);
+            node_clouds++;
+        }
+
+        for (int l = 0; l < NUM_FINE_LEAF_SIZES; ++l) {
+            const float leaf = FINE_LEAF_SIZES[l];
+            Cloud::Ptr fine(new Cloud);
+            voxelGridDownsample(survivors, leaf, leaf, leaf, *fine);
+            if (fine->points.size() <= static_cast<size_t>(FINE_K)) {
+                continue;
+            }
+            const Result result = compareSolvers(fine, FINE_K);
+            printResult(std::string(argv[f]) + ", leaf " + std::to_string(leaf) + " m, k " + std::to_string(FINE_K), result, 1);
+            fine_total[l].add(result);
+            fine_clouds[l]++;
+        }
+    }
+
+    if (!anyFramesRead(node_clouds)) {
+        return 1;
+    }
+
+    printResult("Mean over " + std::to_string(node_clouds) + " frames, node leaf", node_total, node_clouds);
+    for (int l = 0; l < NUM_FINE_LEAF_SIZES; ++l) {
+        if (fine_clouds[l] > 0) {
+            printResult("Mean over " + std::to_string(fine_clouds[l]) + " frames, leaf " + std::to_string(FINE_LEAF_SIZES[l]) + " m",
+                        fine_total[l], fine_clouds[l]);
+        }
+    }
+    return 0;
+}
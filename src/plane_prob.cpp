@@ -54,12 +54,21 @@
 #include <vector>
 #include <sstream>
 
+#include "cloud_ingest.h" // Crop while reading PointCloud2 messages, without fromROSMsg
+#include "allocation_counter.h" // Heap allocations per pipeline stage
+#include "range_image.h" // Ring x azimuth organized scan with pixel-window neighbours
+#include "plane_smoothing.h" // Plane fit per voxel block of the axis downsampling grid, instead of MLS
+#include "normal_neighbourhood.h" // Capped k or leaf-sized radius for normal estimation
+#include "voxel_hash_search.h" // Uniform grid hash neighbour search for voxelized clouds
+
 // ROS Publishers
 ros::Publisher pub_after_passthrough_y;
 // ros::Publisher pub_after_passthrough_z;
 ros::Publisher pub_after_axis_downsampling;
 // ros::Publisher pub_after_sor;
 ros::Publisher pub_after_low_pass;
+ros::Publisher pub_after_range_image;
+ros::Publisher pub_after_range_image_edges;
 
 ros::Publisher marker_pub;
 
@@ -111,6 +120,88 @@ struct PlaneData {
 };
 
 
+// Segmentation objects and working clouds of extractPlanes. Inlier clouds are handed out to the planes in order
+// and reused by the next call, so planes stored from a reused PlaneExtraction are only valid until then.
+struct PlaneExtraction {
+    pcl::SACSegmentation<pcl::PointXYZ> segmentation;
+    pcl::ExtractIndices<pcl::PointXYZ> extract;
+    pcl::ModelCoefficients::Ptr coefficients{new pcl::ModelCoefficients};
+    pcl::PointIndices::Ptr inliers{new pcl::PointIndices};
+    pcl::PointCloud<pcl::PointXYZ>::Ptr remaining_cloud{new pcl::PointCloud<pcl::PointXYZ>};
+    pcl::PointCloud<pcl::PointXYZ>::Ptr next_remaining_cloud{new pcl::PointCloud<pcl::PointXYZ>};
+    std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> plane_clouds;
+};
+
+// Clouds, buffers, search trees and algorithm objects of the RoboSense pipeline, created once and reused
+// every frame instead of being allocated per stage. The clouds keep their capacity, so once the first frames
+// have grown them the crop and axis downsampling stages run without heap allocations. MLS, normal estimation
+// and plane segmentation still allocate inside PCL (search index builds, per-query and per-model buffers).
+struct PipelineContext {
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_after_passthrough_y{new pcl::PointCloud<pcl::PointXYZ>};
+
+    CloudSoA axis_survivors;           // Points inside the axis limits of downsamplingAlongAxis
+    VoxelGridWorkspace voxel_grid;     // Voxel index sort buffer
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_after_axis_downsampling{new pcl::PointCloud<pcl::PointXYZ>};
+
+    pcl::MovingLeastSquares<pcl::PointXYZ, pcl::PointXYZ> mls;
+    pcl::search::Search<pcl::PointXYZ>::Ptr mls_tree{new pcl::search::KdTree<pcl::PointXYZ>};
+    PlaneSmoothingWorkspace plane_smoothing;
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_after_low_pass{new pcl::PointCloud<pcl::PointXYZ>};
+
+    pcl::NormalEstimation<pcl::PointXYZ, pcl::Normal> normal_estimation;
+    pcl::search::Search<pcl::PointXYZ>::Ptr normal_tree{new pcl::search::KdTree<pcl::PointXYZ>};
+    pcl::search::Search<pcl::PointXYZ>::Ptr voxel_hash{new VoxelHashSearch<pcl::PointXYZ>(0.2f)}; // Shared by MLS and normals
+    pcl::PointCloud<pcl::Normal>::Ptr normals{new pcl::PointCloud<pcl::Normal>};
+
+    PlaneExtraction plane_extraction;
+    std::vector<PlaneData> plane_storage;
+
+    RangeImage range_image;
+    NormalBatchWorkspace range_image_batch;  // Covariances of the pixel windows, solved in one batch
+    pcl::PointCloud<pcl::Normal>::Ptr range_image_normals{new pcl::PointCloud<pcl::Normal>};
+    std::vector<int> range_image_edges;
+    pcl::PointCloud<pcl::PointXYZ>::Ptr range_image_edge_cloud{new pcl::PointCloud<pcl::PointXYZ>};
+    RangeImageClusterWorkspace range_image_clustering;
+    std::vector<pcl::PointIndices> range_image_clusters;
+};
+
+PipelineContext pipeline;
+
+// Log the heap allocations of every pipeline stage once per frame (allocation_counter.h). A diagnostic: the
+// counts are only non-zero in a build with COUNT_HEAP_ALLOCATIONS defined.
+bool log_frame_allocations = false;
+FrameAllocations frame_allocations;
+
+// Smoothing of the downsampled cloud:
+//   MovingLeastSquares:   pcl::MovingLeastSquares, order 1, 5 cm radius (lowPassFilterMLS)
+//   VoxelPlaneProjection: plane fitted to the input points of each 3x3x3 voxel block of the axis downsampling
+//                         grid, centroids projected onto it (planeProjectionSmoothing)
+// A block spans three leaves (about +-15 cm here), much wider than the MLS radius, and only the curvature gate
+// keeps it from rounding off nosings; MLS stays the default until smoothing_benchmark results on stair bags show
+// the two are comparable.
+enum class SmoothingMethod { MovingLeastSquares, VoxelPlaneProjection };
+SmoothingMethod smoothing_method = SmoothingMethod::MovingLeastSquares;
+PlaneSmoothingConfig plane_smoothing_config; // Defaults: at least 5 points, curvature up to 0.05
+
+// Also organize every scan into a ring x azimuth range image (range_image.h) and run normals, edge detection and
+// clustering on it by pixel offsets, without search trees. Publishes the organized cloud and its edge pixels.
+bool use_range_image = false;
+RangeImageConfig range_image_config; // Defaults: RS-LiDAR-16, 0.2 degree azimuth bins
+
+// Neighbourhood of the normal estimation (normal_neighbourhood.h). CloudFraction with divisor 10 and min_k 1 is
+// the original k = N/10, which had no floor (unlike the k = max(10, N/5) of model_predicting and terrain); give
+// min_k a real floor such as 10 before switching to LeafRadius, whose isolated points are refit with min_k
+// neighbours. CappedK and LeafRadius keep the estimation linear in the cloud size.
+NormalNeighbourhoodConfig normal_neighbourhood = {NeighbourhoodMode::CloudFraction, 10, 1};
+
+// Neighbour search of MLS and the normal estimation: a KdTree, or a uniform grid hash (voxel_hash_search.h) with
+// cells sized to the search radius or the leaf. Both return the exact neighbours.
+// KdTree stays the default until search_benchmark numbers on recorded frames back the switch
+// (test/test_voxel_hash_search.cpp checks the exactness).
+enum class NeighbourSearch { KdTree, VoxelHash };
+NeighbourSearch neighbour_search = NeighbourSearch::KdTree;
+
+
 // std::vector<ClusterPlanes> original_cluster_planes;
 // std::vector<ClusterPlanes> downsampled_cluster_planes;
 
@@ -192,6 +283,32 @@ pcl::PointCloud<pcl::PointXYZ>::Ptr downsamplingAlongAxis(
     return cloud_downsampled;
 }
 
+// Same as above into reused buffers: the axis limits are applied as a crop box, then the voxel grid of
+// cloud_filters.h runs over the points inside them, which is what pcl::VoxelGrid does with filter limits
+// (same output for limits that are exact in float, as all of ours are).
+void downsamplingAlongAxis(const pcl::PointCloud<pcl::PointXYZ>& cloud, const std::string& axis,
+                           double min_limit, double max_limit,
+                           float leaf_size_x, float leaf_size_y, float leaf_size_z,
+                           CloudSoA& survivors, VoxelGridWorkspace& workspace, pcl::PointCloud<pcl::PointXYZ>& cloud_downsampled)
+{
+    const float limit = std::numeric_limits<float>::max();
+    CropBox box = {-limit, limit, -limit, limit, -limit, limit};
+    if (axis == "x") {
+        box.min_x = static_cast<float>(min_limit);
+        box.max_x = static_cast<float>(max_limit);
+    } else if (axis == "y") {
+        box.min_y = static_cast<float>(min_limit);
+        box.max_y = static_cast<float>(max_limit);
+    } else {
+        box.min_z = static_cast<float>(min_limit);
+        box.max_z = static_cast<float>(max_limit);
+    }
+    cropToSoA(cloud, box, survivors);
+
+    cloud_downsampled.header = cloud.header;
+    voxelGridDownsample(survivors, leaf_size_x, leaf_size_y, leaf_size_z, cloud_downsampled, workspace);
+}
+
 
 // Low-Pass Filter using Moving Least Squares (MLS)
 pcl::PointCloud<pcl::PointXYZ>::Ptr lowPassFilterMLS(const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud, 
@@ -215,6 +332,20 @@ pcl::PointCloud<pcl::PointXYZ>::Ptr lowPassFilterMLS(const pcl::PointCloud<pcl::
     return cloud_smoothed;
 }
 
+// Same as above with an MLS object and search tree that live across frames
+void lowPassFilterMLS(const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud, int order, double search_radius,
+                      pcl::MovingLeastSquares<pcl::PointXYZ, pcl::PointXYZ>& mls,
+                      const pcl::search::Search<pcl::PointXYZ>::Ptr& tree, pcl::PointCloud<pcl::PointXYZ>& cloud_smoothed)
+{
+    mls.setInputCloud(cloud);
+    mls.setComputeNormals(false);
+    mls.setPolynomialOrder(order);
+    mls.setSearchMethod(tree);
+    mls.setSearchRadius(search_radius);
+
+    mls.process(cloud_smoothed);
+}
+
 
 
 // ----------------------------------------------------------------------------------
@@ -398,25 +529,27 @@ pcl::PointCloud<pcl::PointXYZ>::Ptr lowPassFilterMLS(const pcl::PointCloud<pcl::
 
 
 // Plane Segmentation
-void extractPlanes(pcl::PointCloud<pcl::PointXYZ>::Ptr& input_cloud,
+void extractPlanes(const pcl::PointCloud<pcl::PointXYZ>::Ptr& input_cloud,
                    std::vector<PlaneData>& plane_storage,
-                   int max_iterations, double distance_threshold) {
-    pcl::ModelCoefficients::Ptr coefficients(new pcl::ModelCoefficients);
-    pcl::PointIndices::Ptr inliers(new pcl::PointIndices);
-    pcl::SACSegmentation<pcl::PointXYZ> seg;
+                   int max_iterations, double distance_threshold,
+                   PlaneExtraction& extraction) {
+    pcl::SACSegmentation<pcl::PointXYZ>& seg = extraction.segmentation;
     seg.setOptimizeCoefficients(true);
     seg.setModelType(pcl::SACMODEL_PLANE);
     seg.setMethodType(pcl::SAC_RANSAC);
     seg.setMaxIterations(max_iterations);
     seg.setDistanceThreshold(distance_threshold);
 
-    pcl::PointCloud<pcl::PointXYZ>::Ptr current_cloud(new pcl::PointCloud<pcl::PointXYZ>);
-    pcl::copyPointCloud(*input_cloud, *current_cloud);
+    pcl::ModelCoefficients::Ptr& coefficients = extraction.coefficients;
+    pcl::PointIndices::Ptr& inliers = extraction.inliers;
+    pcl::ExtractIndices<pcl::PointXYZ>& extract = extraction.extract;
+
+    pcl::copyPointCloud(*input_cloud, *extraction.remaining_cloud);
 
     int plane_index = 0;
 
-    while (current_cloud->points.size() > 30) {
-        seg.setInputCloud(current_cloud);
+    while (extraction.remaining_cloud->points.size() > 30) {
+        seg.setInputCloud(extraction.remaining_cloud);
         seg.segment(*inliers, *coefficients);
 
         if (inliers->indices.size() == 0) {
@@ -429,10 +562,13 @@ void extractPlanes(pcl::PointCloud<pcl::PointXYZ>::Ptr& input_cloud,
             break;
         }
 
+        if (plane_index >= static_cast<int>(extraction.plane_clouds.size())) {
+            extraction.plane_clouds.push_back(pcl::PointCloud<pcl::PointXYZ>::Ptr(new pcl::PointCloud<pcl::PointXYZ>));
+        }
+
         PlaneData plane_data;
-        plane_data.cloud = pcl::PointCloud<pcl::PointXYZ>::Ptr(new pcl::PointCloud<pcl::PointXYZ>);
-        pcl::ExtractIndices<pcl::PointXYZ> extract;
-        extract.setInputCloud(current_cloud);
+        plane_data.cloud = extraction.plane_clouds[plane_index];
+        extract.setInputCloud(extraction.remaining_cloud);
         extract.setIndices(inliers);
         extract.setNegative(false);
         extract.filter(*plane_data.cloud);
@@ -458,9 +594,8 @@ void extractPlanes(pcl::PointCloud<pcl::PointXYZ>::Ptr& input_cloud,
         }
 
         extract.setNegative(true);
-        pcl::PointCloud<pcl::PointXYZ>::Ptr temp(new pcl::PointCloud<pcl::PointXYZ>);
-        extract.filter(*temp);
-        current_cloud.swap(temp);
+        extract.filter(*extraction.next_remaining_cloud);
+        extraction.remaining_cloud.swap(extraction.next_remaining_cloud);
 
         plane_index++;
     }
@@ -478,6 +613,14 @@ void extractPlanes(pcl::PointCloud<pcl::PointXYZ>::Ptr& input_cloud,
     }
 }
 
+// Same with fresh segmentation objects, so every plane gets its own cloud
+void extractPlanes(pcl::PointCloud<pcl::PointXYZ>::Ptr& input_cloud,
+                   std::vector<PlaneData>& plane_storage,
+                   int max_iterations, double distance_threshold) {
+    PlaneExtraction extraction;
+    extractPlanes(input_cloud, plane_storage, max_iterations, distance_threshold, extraction);
+}
+
 
 // ----------------------------------------------------------------------------------
 // PLANE VISUALIZATION WITH MARKER ARRAY
@@ -673,6 +816,24 @@ pcl::PointCloud<pcl::Normal>::Ptr computeNormals(
     return normals;
 }
 
+// Same as above with a normal estimator and search tree that live across frames, and a k or radius
+// neighbourhood (normal_neighbourhood.h). Radius searches leaving a point with too few neighbours get that
+// normal from its min_k nearest neighbours. The tree is rebuilt here, since the estimator only rebuilds it when
+// the cloud pointer changes and the pipeline passes the same cloud every frame.
+void computeNormals(const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud, const NormalNeighbourhood& neighbourhood, int min_k,
+                    pcl::NormalEstimation<pcl::PointXYZ, pcl::Normal>& ne,
+                    const pcl::search::Search<pcl::PointXYZ>::Ptr& tree, pcl::PointCloud<pcl::Normal>& normals)
+{
+    tree->setInputCloud(cloud);
+    ne.setInputCloud(cloud);
+    ne.setSearchMethod(tree);
+    setNormalNeighbourhood(ne, neighbourhood);
+    ne.compute(normals);
+    if (neighbourhood.radius > 0.0) {
+        fillIsolatedNormals(*cloud, *tree, min_k, normals);
+    }
+}
+
 void visualizeNormals(const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud, const pcl::PointCloud<pcl::Normal>::Ptr& normals) {
     pcl::visualization::PCLVisualizer viewer("Normals Visualization");
     viewer.setBackgroundColor(0.05, 0.05, 0.05, 0); // Dark background for better visibility
@@ -945,14 +1106,22 @@ void pointcloud_callback(const sensor_msgs::PointCloud2ConstPtr& input_msg, ros:
     // ------------------------------------------------------------------------------------------------------------------------------------------------------------------
 
 
-    // Convert ROS PointCloud2 message to PCL PointCloud
-    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
-    pcl::fromROSMsg(*input_msg, *cloud);
+    // All stages write into the reused clouds of the pipeline context
+    if (log_frame_allocations) {
+        frame_allocations.begin();
+    }
 
-    // Passthrough Filtering with Y-Axis
-    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_after_passthrough_y = passthroughFilterY(cloud, -0.2, 0.2);
+    // Passthrough Filtering with Y-Axis, applied while reading the message (cloud_ingest.h)
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_after_passthrough_y = pipeline.cloud_after_passthrough_y;
+    readPointCloud2(*input_msg, cropBoxY(-0.2f, 0.2f), *cloud_after_passthrough_y);
+    if (log_frame_allocations) {
+        frame_allocations.endStage("passthrough");
+    }
     publishProcessedCloud(cloud_after_passthrough_y, pub_after_passthrough_y, input_msg);
     ROS_INFO("After Passthough filter: %ld points", cloud_after_passthrough_y->points.size());
+    if (log_frame_allocations) {
+        frame_allocations.endStage("publishing");
+    }
 
     // Downsampling along X-axis
     // Parameters: cloud, axis, min_limit, max_limit, leaf_size_x, leaf_size_y, leaf_size_z
@@ -963,15 +1132,22 @@ void pointcloud_callback(const sensor_msgs::PointCloud2ConstPtr& input_msg, ros:
     double voxel_y = 0.1;
     double voxel_z = 0.08;
     
-    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_after_axis_downsampling = downsamplingAlongAxis(
-                                                                        cloud_after_passthrough_y, // cloud to be downsampled
-                                                                        "z",                       //axis to downsample with
-                                                                        min_limit, max_limit,                  // filter limits on the selected axis
-                                                                        voxel_x, voxel_y, voxel_z);      // leaf dimensions across x, y and z axis
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_after_axis_downsampling = pipeline.cloud_after_axis_downsampling;
+    downsamplingAlongAxis(*cloud_after_passthrough_y, // cloud to be downsampled
+                          "z",                        //axis to downsample with
+                          min_limit, max_limit,       // filter limits on the selected axis
+                          voxel_x, voxel_y, voxel_z,  // leaf dimensions across x, y and z axis
+                          pipeline.axis_survivors, pipeline.voxel_grid, *cloud_after_axis_downsampling);
+    if (log_frame_allocations) {
+        frame_allocations.endStage("downsampling");
+    }
     publishProcessedCloud(cloud_after_axis_downsampling, pub_after_axis_downsampling, input_msg);
 
     // // Log the number of points in the downsampled cloud directly
     ROS_INFO("After Downsampling: %ld points", cloud_after_axis_downsampling->points.size());
+    if (log_frame_allocations) {
+        frame_allocations.endStage("publishing");
+    }
 
     // -------------Low-Pass Filtering-------------
     double min_voxel = std::min({voxel_x, voxel_y, voxel_z});
@@ -983,31 +1159,104 @@ void pointcloud_callback(const sensor_msgs::PointCloud2ConstPtr& input_msg, ros:
 
     int poly_order = 1;
 
-    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_after_low_pass = lowPassFilterMLS(cloud_after_axis_downsampling, poly_order, search_radius);
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_after_low_pass = pipeline.cloud_after_low_pass;
+    if (smoothing_method == SmoothingMethod::VoxelPlaneProjection) {
+        planeProjectionSmoothing(pipeline.axis_survivors, pipeline.voxel_grid, *cloud_after_axis_downsampling,
+                                 plane_smoothing_config, pipeline.plane_smoothing, *cloud_after_low_pass);
+    } else {
+        pcl::search::Search<pcl::PointXYZ>::Ptr mls_search = pipeline.mls_tree;
+        if (neighbour_search == NeighbourSearch::VoxelHash) {
+            static_cast<VoxelHashSearch<pcl::PointXYZ>&>(*pipeline.voxel_hash).setCellSize(static_cast<float>(search_radius));
+            mls_search = pipeline.voxel_hash;
+        }
+        lowPassFilterMLS(cloud_after_axis_downsampling, poly_order, search_radius, pipeline.mls, mls_search, *cloud_after_low_pass);
+    }
+    if (log_frame_allocations) {
+        frame_allocations.endStage("smoothing");
+    }
     publishProcessedCloud(cloud_after_low_pass, pub_after_low_pass, input_msg);
     ROS_INFO("After Low-Pass filter: %ld points", cloud_after_low_pass->points.size());
+    if (log_frame_allocations) {
+        frame_allocations.endStage("publishing");
+    }
   
 
     // -------------NORMAL ESTIMATION & VISUALIZATION-------------
-    int k_numbers = (cloud_after_low_pass->points.size())/10;
+    NormalNeighbourhood neighbourhood = normalNeighbourhood(normal_neighbourhood, cloud_after_low_pass->points.size(),
+                                                            static_cast<float>(std::max({voxel_x, voxel_y, voxel_z})));
 
     // pcl::PointCloud<pcl::Normal>::Ptr cloud_normals = computeNormals(cloud_after_axis_downsampling, 50);
-    pcl::PointCloud<pcl::Normal>::Ptr cloud_normals_1 = computeNormals(cloud_after_low_pass, k_numbers);
+    pcl::PointCloud<pcl::Normal>::Ptr cloud_normals_1 = pipeline.normals;
+    pcl::search::Search<pcl::PointXYZ>::Ptr normal_search = pipeline.normal_tree;
+    if (neighbour_search == NeighbourSearch::VoxelHash) {
+        static_cast<VoxelHashSearch<pcl::PointXYZ>&>(*pipeline.voxel_hash).setCellSize(
+            voxelHashCellSize(neighbourhood.radius, static_cast<float>(std::max({voxel_x, voxel_y, voxel_z}))));
+        normal_search = pipeline.voxel_hash;
+    }
+    computeNormals(cloud_after_low_pass, neighbourhood, normal_neighbourhood.min_k, pipeline.normal_estimation, normal_search, *cloud_normals_1);
+    if (log_frame_allocations) {
+        frame_allocations.endStage("normals");
+    }
    
     // visualizeNormals(cloud_after_axis_downsampling, cloud_normals);
     // visualizeNormals(cloud_after_low_pass, cloud_normals_1);
+
+    // -------------RANGE IMAGE-------------
+    if (use_range_image) {
+        // Same y passthrough as above, but the cropped returns stay in their pixels
+        RangeImage& range_image = pipeline.range_image;
+        buildRangeImage(*input_msg, cropBoxY(-0.2f, 0.2f), range_image_config, range_image);
+        if (log_frame_allocations) {
+            frame_allocations.endStage("range image");
+        }
+
+        // Neighbours: 1 ring and 3 azimuth bins to each side, within 15 cm
+        rangeImageNormals(range_image, 1, 3, 0.15f, pipeline.range_image_batch, *pipeline.range_image_normals);
+        if (log_frame_allocations) {
+            frame_allocations.endStage("normals");
+        }
+
+        rangeImageEdges(range_image, *pipeline.range_image_normals, 0.05f, 0.05f, pipeline.range_image_edges);
+        rangeImageClusters(range_image, 1, 3, 0.09f, 20, pipeline.range_image_clustering, pipeline.range_image_clusters);
+        if (log_frame_allocations) {
+            frame_allocations.endStage("clustering");
+        }
+
+        pcl::PointCloud<pcl::PointXYZ>::Ptr range_image_edge_cloud = pipeline.range_image_edge_cloud;
+        range_image_edge_cloud->header = range_image.cloud->header;
+        range_image_edge_cloud->points.clear();
+        for (int index : pipeline.range_image_edges) {
+            range_image_edge_cloud->points.push_back(range_image.cloud->points[index]);
+        }
+        range_image_edge_cloud->width = static_cast<uint32_t>(range_image_edge_cloud->points.size());
+        range_image_edge_cloud->height = 1;
+        range_image_edge_cloud->is_dense = true;
+
+        publishProcessedCloud(range_image.cloud, pub_after_range_image, input_msg);
+        publishProcessedCloud(range_image_edge_cloud, pub_after_range_image_edges, input_msg);
+        ROS_INFO("Range image: %d x %d, %d pixels filled, %d collisions, %d unmapped, %zu edge pixels, %zu clusters",
+                 range_image.rows, range_image.cols, range_image.filled_pixels, range_image.collisions,
+                 range_image.unmapped_points, pipeline.range_image_edges.size(), pipeline.range_image_clusters.size());
+        if (log_frame_allocations) {
+            frame_allocations.endStage("publishing");
+        }
+    }
     
     // --------------------------PLANE SEGMENTATION: -------------------------------------------
 
     // Plane segmentation from directly the downsampled cloud
 
-    // std::vector<PlaneData> plane_storage;
+    // std::vector<PlaneData>& plane_storage = pipeline.plane_storage;
+    // plane_storage.clear();
     
     // // Extract all possible planes from the downsampled point cloud
     // int max_iterations = 100;  // Example: max iterations for RANSAC
     // double distance_threshold = 0.01;  // Example: distance threshold for RANSAC
 
-    // extractPlanes(cloud_after_low_pass, plane_storage, max_iterations, distance_threshold);
+    // extractPlanes(cloud_after_low_pass, plane_storage, max_iterations, distance_threshold, pipeline.plane_extraction);
+    // if (log_frame_allocations) {
+    //     frame_allocations.endStage("planes");
+    // }
 
     // // Publish the plane markers
     // publishPlaneMarkers(plane_storage, global_plane_normals, marker_pub, cloud_after_low_pass->header.frame_id);
@@ -1044,6 +1293,12 @@ void pointcloud_callback(const sensor_msgs::PointCloud2ConstPtr& input_msg, ros:
     
     // ROS_INFO("Published Plane Markers");
 
+    if (log_frame_allocations) {
+        char allocation_report[256];
+        frame_allocations.format(allocation_report, sizeof(allocation_report));
+        ROS_INFO("Heap allocations this frame: %s", allocation_report);
+    }
+
     // ------------------------------------------------------------------------------------------------------------------------------------------------------------------
     // ROBOSENSE PLANE SEGMENTATION ALGORITHM ---- ENDS
     // ------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -1101,6 +1356,10 @@ int main(int argc, char** argv) {
     ros::init(argc, argv, "pcl_node");
     ros::NodeHandle nh;
 
+    if (log_frame_allocations && !ALLOCATION_COUNTER_ENABLED) {
+        ROS_WARN("Heap allocation counting needs glibc and a build with COUNT_HEAP_ALLOCATIONS defined; the per-frame allocation counts will read 0.");
+    }
+
     // Publishers
     pub_after_passthrough_y = nh.advertise<sensor_msgs::PointCloud2>("/passthrough_cloud_y", 1);
     // pub_after_passthrough_z = nh.advertise<sensor_msgs::PointCloud2>("/passthrough_cloud_z", 1);
@@ -1110,6 +1369,8 @@ int main(int argc, char** argv) {
     // pub_after_sor = nh.advertise<sensor_msgs::PointCloud2>("/sor_filtered_cloud", 1);
 
     pub_after_low_pass = nh.advertise<sensor_msgs::PointCloud2>("/lowpass_cloud", 1);
+    pub_after_range_image = nh.advertise<sensor_msgs::PointCloud2>("/range_image_cloud", 1);
+    pub_after_range_image_edges = nh.advertise<sensor_msgs::PointCloud2>("/range_image_edges", 1);
     
     // marker_pub = nh.advertise<visualization_msgs::Marker>("visualization_marker", 10);
     marker_pub = nh.advertise<visualization_msgs::MarkerArray>("visualization_marker_array", 10);
@@ -0,0 +1,166 @@
+#pragma once
+
+// Voxel plane smoothing.
+//
+// MovingLeastSquares builds a KdTree over the downsampled cloud and fits a local surface around every point
+// through a radius search. planeProjectionSmoothing needs no search structure: the voxel grid that produced the
+// cloud (voxelGridDownsample and its workspace, cloud_filters.h) already groups the cropped input points by voxel.
+// One pass over them collects per-voxel moments, then every centroid gets a plane fitted to the input points of
+// its 3x3x3 voxel block and is projected onto it, which is what an order-1 MLS does. The blocks are looked up by
+// voxel index, independently per centroid, so the block moments are gathered in parallel; the plane fits of all
+// centroids are then solved in one batch (plane_batch.h).
+// A block whose points are not planar (curvature above max_curvature, e.g. across a stair nosing) leaves its
+// centroid in place instead of rounding the edge off.
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/features/normal_3d.h>
+
+#include <Eigen/Core>
+
+#include <algorithm>
+#include <vector>
+
+#include "cloud_filters.h"
+#include "plane_batch.h"
+
+struct PlaneSmoothingConfig {
+    int min_points = 5;          // Input points a block needs for its plane to be used
+    float max_curvature = 0.05f; // Largest surface variation (smallest eigenvalue / sum) still treated as a plane
+};
+
+// Zeroth, first and second moments of the input points of one voxel
+struct VoxelMoments {
+    double count;
+    double x, y, z;
+    double xx, xy, xz, yy, yz, zz;
+};
+
+// Per-voxel buffers, kept across frames so their capacity is reused
+struct PlaneSmoothingWorkspace {
+    std::vector<unsigned int> voxel_indices; // Voxel of every centroid, ascending like the index sort
+    std::vector<VoxelMoments> moments;
+    std::vector<Eigen::Vector3f> block_means;  // Mean of every centroid's block, relative to the centroid
+    CovarianceBatch covariances;               // Covariance of every centroid's block, NaN below min_points
+    PlaneBatch planes;
+    int projected_points = 0;                // Centroids moved onto their plane by the last call
+};
+
+// Smooths the output of voxelGridDownsample(survivors, ..., downsampled, voxel_grid), point by point in the same
+// order. Without a grid (voxelGridDownsample returned its input unchanged) the cloud is copied as it is.
+inline void planeProjectionSmoothing(const CloudSoA& survivors, const VoxelGridWorkspace& voxel_grid,
+                                     const pcl::PointCloud<pcl::PointXYZ>& downsampled, const PlaneSmoothingConfig& config,
+                                     PlaneSmoothingWorkspace& workspace, pcl::PointCloud<pcl::PointXYZ>& smoothed) {
+    smoothed.header = downsampled.header;
+    smoothed.points.resize(downsampled.points.size());
+    smoothed.width = static_cast<uint32_t>(downsampled.points.size());
+    smoothed.height = 1;
+    smoothed.is_dense = true;
+    workspace.projected_points = 0;
+    if (!voxel_grid.has_layout) {
+        std::copy(downsampled.points.begin(), downsampled.points.end(), smoothed.points.begin());
+        return;
+    }
+
+    // Moments of every voxel, from the sorted (voxel, point) pairs of the grid: run k is centroid k
+    const std::vector<std::pair<unsigned int, unsigned int>>& index_vector = voxel_grid.index_vector;
+    workspace.voxel_indices.clear();
+    workspace.moments.clear();
+    for (size_t begin = 0; begin < index_vector.size();) {
+        VoxelMoments moments = {};
+        size_t end = begin;
+        for (; end < index_vector.size() && index_vector[end].first == index_vector[begin].first; ++end) {
+            const unsigned int point = index_vector[end].second;
+            const double x = survivors.x[point], y = survivors.y[point], z = survivors.z[point];
+            moments.count += 1.0;
+            moments.x += x; moments.y += y; moments.z += z;
+            moments.xx += x * x; moments.xy += x * y; moments.xz += x * z;
+            moments.yy += y * y; moments.yz += y * z; moments.zz += z * z;
+        }
+        workspace.voxel_indices.push_back(index_vector[begin].first);
+        workspace.moments.push_back(moments);
+        begin = end;
+    }
+
+    const VoxelGridLayout& layout = voxel_grid.layout;
+    const int div_b_x = layout.divb_mul_y;
+    const int div_b_y = layout.divb_mul_z / layout.divb_mul_y;
+    const std::vector<unsigned int>& voxel_indices = workspace.voxel_indices;
+    const int num_voxels = static_cast<int>(std::min(voxel_indices.size(), downsampled.points.size()));
+    workspace.block_means.resize(num_voxels);
+    resizeCovarianceBatch(workspace.covariances, num_voxels);
+
+    #pragma omp parallel for schedule(static)
+    for (int voxel = 0; voxel < num_voxels; ++voxel) {
+        const pcl::PointXYZ& centroid = downsampled.points[voxel];
+
+        const int index = static_cast<int>(voxel_indices[voxel]);
+        const int ijk_x = index % div_b_x;
+        const int ijk_y = (index / div_b_x) % div_b_y;
+        const int ijk_z = index / layout.divb_mul_z;
+
+        // Moments of the block, taken about the centroid to keep the sums well conditioned
+        VoxelMoments block = {};
+        for (int dz = -1; dz <= 1; ++dz) {
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    if (ijk_x + dx < 0 || ijk_x + dx >= div_b_x || ijk_y + dy < 0 || ijk_y + dy >= div_b_y || ijk_z + dz < 0) {
+                        continue;
+                    }
+                    const unsigned int neighbour = static_cast<unsigned int>(index + dx + dy * layout.divb_mul_y + dz * layout.divb_mul_z);
+                    auto found = std::lower_bound(voxel_indices.begin(), voxel_indices.end(), neighbour);
+                    if (found == voxel_indices.end() || *found != neighbour) {
+                        continue;
+                    }
+                    const VoxelMoments& m = workspace.moments[found - voxel_indices.begin()];
+                    const double cx = centroid.x, cy = centroid.y, cz = centroid.z;
+                    block.count += m.count;
+                    block.x += m.x - m.count * cx;
+                    block.y += m.y - m.count * cy;
+                    block.z += m.z - m.count * cz;
+                    block.xx += m.xx - 2.0 * cx * m.x + m.count * cx * cx;
+                    block.yy += m.yy - 2.0 * cy * m.y + m.count * cy * cy;
+                    block.zz += m.zz - 2.0 * cz * m.z + m.count * cz * cz;
+                    block.xy += m.xy - cx * m.y - cy * m.x + m.count * cx * cy;
+                    block.xz += m.xz - cx * m.z - cz * m.x + m.count * cx * cz;
+                    block.yz += m.yz - cy * m.z - cz * m.y + m.count * cy * cz;
+                }
+            }
+        }
+        if (block.count < config.min_points) {
+            setInvalidCovariance(workspace.covariances, voxel);
+            continue;
+        }
+
+        const double mx = block.x / block.count, my = block.y / block.count, mz = block.z / block.count;
+        CovarianceBatch& covariances = workspace.covariances;
+        workspace.block_means[voxel] = Eigen::Vector3f(static_cast<float>(mx), static_cast<float>(my), static_cast<float>(mz));
+        covariances.xx[voxel] = static_cast<float>(block.xx / block.count - mx * mx);
+        covariances.yy[voxel] = static_cast<float>(block.yy / block.count - my * my);
+        covariances.zz[voxel] = static_cast<float>(block.zz / block.count - mz * mz);
+        covariances.xy[voxel] = static_cast<float>(block.xy / block.count - mx * my);
+        covariances.xz[voxel] = static_cast<float>(block.xz / block.count - mx * mz);
+        covariances.yz[voxel] = static_cast<float>(block.yz / block.count - my * mz);
+    }
+
+    solvePlanesBatch(workspace.covariances, workspace.planes);
+
+    const PlaneBatch& planes = workspace.planes;
+    int projected_points = 0;
+    for (int voxel = 0; voxel < num_voxels; ++voxel) {
+        const pcl::PointXYZ& centroid = downsampled.points[voxel];
+        smoothed.points[voxel] = centroid;
+        // NaN (too few points) fails the comparison too
+        if (!(planes.curvature[voxel] <= config.max_curvature)) {
+            continue;
+        }
+
+        // The centroid sits at the origin of the block moments, so its offset from the plane is -n . mean
+        const float nx = planes.normal_x[voxel], ny = planes.normal_y[voxel], nz = planes.normal_z[voxel];
+        const Eigen::Vector3f& mean = workspace.block_means[voxel];
+        const float distance = -(nx * mean[0] + ny * mean[1] + nz * mean[2]);
+        smoothed.points[voxel] = pcl::PointXYZ(centroid.x - distance * nx, centroid.y - distance * ny, centroid.z - distance * nz);
+        projected_points++;
+    }
+    workspace.projected_points = projected_points;
+}
@@ -0,0 +1,321 @@
+#pragma once
+
+// Organized range image of a spinning lidar scan.
+//
+// A RoboSense scan is a set of rings (one per laser) swept over the azimuth, so every return has a natural pixel:
+// row = ring, column = azimuth bin. buildRangeImage reads a PointCloud2 message straight into that grid as an
+// organized pcl::PointCloud (width = azimuth bins, height = rings, NaN where there is no return). The neighbours
+// of a point are then the pixels around it and are found by index arithmetic instead of KdTree queries, which is
+// what rangeImageNormals, rangeImageEdges and rangeImageClusters below do.
+// The ring comes from the "ring" field when the driver publishes one, from the message row when the message is
+// itself organized, and from the elevation angle otherwise. Two returns in the same pixel keep the nearer one.
+// PCL's organized algorithms (IntegralImageNormalEstimation, OrganizedEdgeDetection, ...) take the cloud as it is.
+// IntegralImageNormalEstimation assumes a camera looking along z, though; integral_normals.h does the same for the
+// cylindrical image of a lidar.
+// pcl::search::OrganizedNeighbor does not: it fits a pinhole projection, which a 360 degree cylindrical image
+// does not have.
+
+#include <sensor_msgs/PointCloud2.h>
+#include <pcl_conversions/pcl_conversions.h>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/PointIndices.h>
+#include <pcl/features/normal_3d.h>
+
+#include <Eigen/Core>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "cloud_ingest.h"
+#include "plane_batch.h"
+
+struct RangeImageConfig {
+    int num_rings = 16;            // RS-LiDAR-16
+    int num_columns = 1800;        // 0.2 degree azimuth bins, the firing resolution at 10 Hz
+    float min_elevation = -15.0f;  // Degrees, elevation of the lowest and highest ring. Only used when the ring
+    float max_elevation = 15.0f;   // has to be derived from the elevation angle.
+};
+
+// Organized cloud and per-pixel range of one scan. The buffers keep their capacity from frame to frame.
+struct RangeImage {
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud{new pcl::PointCloud<pcl::PointXYZ>}; // index = row * cols + column
+    std::vector<float> range;  // Distance to the sensor, 0 for empty pixels
+    int rows = 0;
+    int cols = 0;
+    int filled_pixels = 0;
+    int collisions = 0;        // Returns dropped because a nearer one fell into the same pixel
+    int unmapped_points = 0;   // Returns whose ring lies outside the image
+
+    bool filled(int index) const {
+        return range[index] > 0.0f;
+    }
+};
+
+inline void resetRangeImage(int rows, int cols, RangeImage& image) {
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    const size_t size = static_cast<size_t>(rows) * cols;
+    image.rows = rows;
+    image.cols = cols;
+    image.cloud->points.assign(size, pcl::PointXYZ(nan, nan, nan));
+    image.cloud->width = static_cast<uint32_t>(cols);
+    image.cloud->height = static_cast<uint32_t>(rows);
+    image.cloud->is_dense = false;
+    image.range.assign(size, 0.0f);
+    image.filled_pixels = 0;
+    image.collisions = 0;
+    image.unmapped_points = 0;
+}
+
+// Ring of a return from its elevation angle, -1 if it lies outside the vertical field of view
+inline int elevationRing(const RangeImageConfig& config, float x, float y, float z) {
+    if (config.num_rings < 2) {
+        return 0;
+    }
+    const float elevation = std::atan2(z, std::sqrt(x * x + y * y)) * static_cast<float>(180.0 / M_PI);
+    const float ring_spacing = (config.max_elevation - config.min_elevation) / static_cast<float>(config.num_rings - 1);
+    const int ring = static_cast<int>(std::lround((elevation - config.min_elevation) / ring_spacing));
+    return (ring >= 0 && ring < config.num_rings) ? ring : -1;
+}
+
+inline void insertRangeImagePoint(RangeImage& image, int row, float x, float y, float z) {
+    const float range = std::sqrt(x * x + y * y + z * z);
+    if (!(range > 0.0f)) {
+        return; // NaN returns and the zero points some drivers publish for missing returns
+    }
+    const float azimuth = std::atan2(y, x);
+    int column = static_cast<int>((azimuth + static_cast<float>(M_PI)) * static_cast<float>(image.cols / (2.0 * M_PI)));
+    if (column >= image.cols) {
+        column -= image.cols; // azimuth == pi
+    }
+
+    const int index = row * image.cols + column;
+    if (image.range[index] > 0.0f) {
+        image.collisions++;
+        if (range >= image.range[index]) {
+            return;
+        }
+    } else {
+        image.filled_pixels++;
+    }
+    image.range[index] = range;
+    image.cloud->points[index] = pcl::PointXYZ(x, y, z);
+}
+
+// Range image of the returns of a cloud inside the box. Rows of an organized cloud are taken as rings.
+inline void buildRangeImage(const pcl::PointCloud<pcl::PointXYZ>& cloud, const CropBox& box, const RangeImageConfig& config, RangeImage& image) {
+    const bool organized = cloud.height > 1;
+    resetRangeImage(organized ? static_cast<int>(cloud.height) : config.num_rings, config.num_columns, image);
+    image.cloud->header = cloud.header;
+
+    for (size_t i = 0; i < cloud.points.size(); ++i) {
+        const pcl::PointXYZ& point = cloud.points[i];
+        if (!insideCropBox(point, box)) {
+            continue;
+        }
+        const int ring = organized ? static_cast<int>(i / cloud.width) : elevationRing(config, point.x, point.y, point.z);
+        if (ring < 0) {
+            image.unmapped_points++;
+            continue;
+        }
+        insertRangeImagePoint(image, ring, point.x, point.y, point.z);
+    }
+}
+
+// Same as above, read straight from the message. Returns outside the box leave their pixel empty.
+inline void buildRangeImage(const sensor_msgs::PointCloud2& msg, const CropBox& box, const RangeImageConfig& config, RangeImage& image) {
+    PointCloud2Layout layout;
+    if (!pointCloud2Layout(msg, layout)) {
+        pcl::PointCloud<pcl::PointXYZ> cloud;
+        pcl::fromROSMsg(msg, cloud);
+        buildRangeImage(cloud, box, config, image);
+        return;
+    }
+
+    const bool has_ring = layout.ring_offset >= 0;
+    const bool organized = !has_ring && msg.height > 1;
+    resetRangeImage(organized ? static_cast<int>(msg.height) : config.num_rings, config.num_columns, image);
+    pcl_conversions::toPCL(msg.header, image.cloud->header);
+
+    for (uint32_t row = 0; row < msg.height; ++row) {
+        const uint8_t* point = msg.data.data() + static_cast<size_t>(row) * msg.row_step;
+        for (uint32_t column = 0; column < msg.width; ++column, point += msg.point_step) {
+            float x, y, z;
+            std::memcpy(&x, point + layout.x_offset, sizeof(float));
+            std::memcpy(&y, point + layout.y_offset, sizeof(float));
+            std::memcpy(&z, point + layout.z_offset, sizeof(float));
+            if (!insideCropBox(pcl::PointXYZ(x, y, z), box)) {
+                continue;
+            }
+            const int ring = has_ring ? readRing(point, layout) : organized ? static_cast<int>(row) : elevationRing(config, x, y, z);
+            if (ring < 0 || ring >= image.rows) {
+                image.unmapped_points++;
+                continue;
+            }
+            insertRangeImagePoint(image, ring, x, y, z);
+        }
+    }
+}
+
+// Calls visit(index) for every filled pixel within half_rows rings and half_columns azimuth bins of (row, column),
+// the pixel itself excluded. Columns wrap around behind the sensor.
+template <typename Visitor>
+inline void forEachPixelNeighbour(const RangeImage& image, int row, int column, int half_rows, int half_columns, Visitor visit) {
+    const int first_row = std::max(0, row - half_rows);
+    const int last_row = std::min(image.rows - 1, row + half_rows);
+    for (int r = first_row; r <= last_row; ++r) {
+        for (int offset = -half_columns; offset <= half_columns; ++offset) {
+            if (r == row && offset == 0) {
+                continue;
+            }
+            int c = column + offset;
+            if (c < 0) {
+                c += image.cols;
+            } else if (c >= image.cols) {
+                c -= image.cols;
+            }
+            const int index = r * image.cols + c;
+            if (image.range[index] > 0.0f) {
+                visit(index);
+            }
+        }
+    }
+}
+
+// Normal and curvature of every filled pixel from the pixels of its window that lie within max_distance of it,
+// oriented towards the sensor. The output is organized like the image; pixels that are empty or have fewer than
+// two such neighbours get NaN. The covariances are gathered per pixel and solved in one batch (plane_batch.h).
+inline void rangeImageNormals(const RangeImage& image, int half_rows, int half_columns, float max_distance, NormalBatchWorkspace& workspace,
+                              pcl::PointCloud<pcl::Normal>& normals) {
+    const int size = image.rows * image.cols;
+    const float max_squared_distance = max_distance * max_distance;
+    resizeCovarianceBatch(workspace.covariances, size);
+
+    #pragma omp parallel
+    {
+        std::vector<int> neighbourhood;
+        #pragma omp for schedule(static)
+        for (int index = 0; index < size; ++index) {
+            if (!image.filled(index)) {
+                setInvalidCovariance(workspace.covariances, index);
+                continue;
+            }
+
+            // The pixel itself and the pixels of its window within max_distance of it
+            const pcl::PointXYZ& centre = image.cloud->points[index];
+            neighbourhood.assign(1, index);
+            forEachPixelNeighbour(image, index / image.cols, index % image.cols, half_rows, half_columns, [&](int neighbour) {
+                const pcl::PointXYZ& point = image.cloud->points[neighbour];
+                const Eigen::Vector3f offset(point.x - centre.x, point.y - centre.y, point.z - centre.z);
+                if (offset.squaredNorm() <= max_squared_distance) {
+                    neighbourhood.push_back(neighbour);
+                }
+            });
+            setNeighbourhoodCovariance(*image.cloud, index, neighbourhood, static_cast<int>(neighbourhood.size()), workspace.covariances);
+        }
+    }
+
+    solvePlanesBatch(workspace.covariances, workspace.planes);
+    orientedNormals(*image.cloud, workspace.planes, normals);
+}
+
+// Pixels on the near side of a depth discontinuity: the next pixel in the same ring or the same column is farther
+// away and lies more than max(min_jump, relative_jump * range) off the pixel's tangent plane (off the line of sight
+// where the pixel has no normal). Measuring against the tangent plane keeps the floor, whose rings are far apart
+// at grazing angles, from showing up as edges. On stairs the edges are the nosings and the side edges.
+inline void rangeImageEdges(const RangeImage& image, const pcl::PointCloud<pcl::Normal>& normals, float min_jump, float relative_jump,
+                            std::vector<int>& edges) {
+    edges.clear();
+    for (int row = 0; row < image.rows; ++row) {
+        for (int column = 0; column < image.cols; ++column) {
+            const int index = row * image.cols + column;
+            const float range = image.range[index];
+            if (range <= 0.0f) {
+                continue;
+            }
+            const float jump = std::max(min_jump, relative_jump * range);
+            const pcl::PointXYZ& point = image.cloud->points[index];
+            const pcl::Normal& normal = normals.points[index];
+            const bool has_normal = std::isfinite(normal.normal_x);
+
+            const int left = row * image.cols + (column == 0 ? image.cols - 1 : column - 1);
+            const int right = row * image.cols + (column == image.cols - 1 ? 0 : column + 1);
+            const int neighbours[4] = {left, right, row > 0 ? index - image.cols : -1, row < image.rows - 1 ? index + image.cols : -1};
+            for (int neighbour : neighbours) {
+                if (neighbour < 0 || image.range[neighbour] <= range) {
+                    continue;
+                }
+                const pcl::PointXYZ& other = image.cloud->points[neighbour];
+                const float separation = has_normal ? std::fabs(normal.normal_x * (other.x - point.x) + normal.normal_y * (other.y - point.y) +
+                                                                normal.normal_z * (other.z - point.z))
+                                                    : image.range[neighbour] - range;
+                if (separation > jump) {
+                    edges.push_back(index);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+// Pixel labels and flood-fill stack of rangeImageClusters, kept across frames
+struct RangeImageClusterWorkspace {
+    std::vector<int> labels;
+    std::vector<int> stack;
+};
+
+// Euclidean clustering over the pixel grid: pixels within the window of each other and closer than max_distance
+// are connected. Clusters are indices into image.cloud, like those of EuclideanClusterExtraction; clusters with
+// fewer than min_cluster_size points are dropped.
+inline void rangeImageClusters(const RangeImage& image, int half_rows, int half_columns, float max_distance, int min_cluster_size,
+                               RangeImageClusterWorkspace& workspace, std::vector<pcl::PointIndices>& clusters) {
+    const int size = image.rows * image.cols;
+    const float max_squared_distance = max_distance * max_distance;
+    workspace.labels.assign(size, -1);
+
+    size_t num_clusters = 0;
+    for (int seed = 0; seed < size; ++seed) {
+        if (!image.filled(seed) || workspace.labels[seed] >= 0) {
+            continue;
+        }
+        if (num_clusters == clusters.size()) {
+            clusters.emplace_back();
+        }
+        pcl::PointIndices& cluster = clusters[num_clusters];
+        cluster.header = image.cloud->header;
+        cluster.indices.clear();
+
+        const int label = static_cast<int>(num_clusters);
+        workspace.labels[seed] = label;
+        workspace.stack.clear();
+        workspace.stack.push_back(seed);
+        while (!workspace.stack.empty()) {
+            const int index = workspace.stack.back();
+            workspace.stack.pop_back();
+            cluster.indices.push_back(index);
+
+            const pcl::PointXYZ& point = image.cloud->points[index];
+            forEachPixelNeighbour(image, index / image.cols, index % image.cols, half_rows, half_columns, [&](int neighbour) {
+                if (workspace.labels[neighbour] >= 0) {
+                    return;
+                }
+                const pcl::PointXYZ& other = image.cloud->points[neighbour];
+                const float dx = other.x - point.x, dy = other.y - point.y, dz = other.z - point.z;
+                if (dx * dx + dy * dy + dz * dz <= max_squared_distance) {
+                    workspace.labels[neighbour] = label;
+                    workspace.stack.push_back(neighbour);
+                }
+            });
+        }
+
+        // A dropped cluster keeps its label, so its pixels are not visited again, and its slot is reused
+        if (static_cast<int>(cluster.indices.size()) >= min_cluster_size) {
+            num_clusters++;
+        }
+    }
+    clusters.resize(num_clusters);
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+// Range-adaptive voxel grid.
+//
+// Lidar point spacing grows with range, so a fixed leaf size leaves dozens of points in the near voxels and
+// single points in the far ones, and the work of normal estimation and RANSAC downstream follows the scene
+// depth. rangeAdaptiveVoxelDownsample splits the distance along one axis into bands. Each band has its own leaf
+// size, growing linearly from min_leaf in the nearest band to max_leaf in the farthest. All points are
+// voxelized in a single pass into one hash map of packed voxel keys (voxel_key.h), and every voxel becomes its
+// centroid. The bands number their voxels along the distance axis one after the other, so a key never needs
+// the band.
+// The leaf size is chosen per band rather than per point so that neighbouring points share one grid.
+//
+// Along the distance axis every band's grid starts at the band's near edge, and every band but the last is a
+// whole number of its own leaves wide (the nominal equal-width bands rounded to leaf multiples). A seam is then
+// a voxel face on both sides: no voxel is cut into slivers and no physical cell is emitted by two bands.
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "voxel_key.h" // Packed voxel keys and their hash
+
+const int MAX_RANGE_BANDS = 15;
+
+struct RangeVoxelConfig {
+    int axis = 0;              // Distance is measured along x (0), y (1) or z (2)
+    float min_distance = 0.0f; // Points outside [min_distance, max_distance] are dropped, like VoxelGrid filter limits
+    float max_distance = 2.3f;
+    float min_leaf = 0.05f;    // Leaf edge of the nearest band
+    float max_leaf = 0.1f;     // Leaf edge of the farthest band
+    int num_bands = 4;
+};
+
+// Hash map, accumulators and per-band statistics, kept across frames so their capacity is reused
+struct RangeVoxelWorkspace {
+    std::vector<uint64_t> bucket_keys;
+    std::vector<unsigned int> bucket_slots;
+    std::vector<float> sum_x, sum_y, sum_z;
+    std::vector<unsigned int> counts;
+    int num_bands = 0;
+    int band_points[MAX_RANGE_BANDS];  // Input points that fell into each band
+    int band_voxels[MAX_RANGE_BANDS];  // Output points of each band
+    int skipped_points = 0;            // Finite points inside the limits whose voxel coordinates overflow the key
+};
+
+inline int rangeBandCount(const RangeVoxelConfig& config) {
+    return std::max(1, std::min(config.num_bands, MAX_RANGE_BANDS));
+}
+
+inline float rangeBandLeaf(const RangeVoxelConfig& config, int band) {
+    const int num_bands = rangeBandCount(config);
+    if (num_bands == 1) {
+        return config.min_leaf;
+    }
+    return config.min_leaf + (config.max_leaf - config.min_leaf) * static_cast<float>(band) / static_cast<float>(num_bands - 1);
+}
+
+// Near edge of every band along the distance axis, plus the far limit at starts[num_bands]
+inline void rangeBandStarts(const RangeVoxelConfig& config, float starts[MAX_RANGE_BANDS + 1]) {
+    const int num_bands = rangeBandCount(config);
+    const float nominal_width = (config.max_distance - config.min_distance) / static_cast<float>(num_bands);
+    starts[0] = config.min_distance;
+    for (int band = 0; band + 1 < num_bands; ++band) {
+        const float leaf = rangeBandLeaf(config, band);
+        const float leaves = std::max(1.0f, std::round(nominal_width / leaf));
+        starts[band + 1] = std::min(starts[band] + leaves * leaf, config.max_distance);
+    }
+    starts[num_bands] = config.max_distance;
+}
+
+inline void rangeAdaptiveVoxelDownsample(const pcl::PointCloud<pcl::PointXYZ>& input, const RangeVoxelConfig& config,
+                                         RangeVoxelWorkspace& workspace, pcl::PointCloud<pcl::PointXYZ>& output) {
+    const int num_bands = rangeBandCount(config);
+    float band_start[MAX_RANGE_BANDS + 1];
+    rangeBandStarts(config, band_start);
+    float inverse_leaf[MAX_RANGE_BANDS];
+    int64_t axis_cells[MAX_RANGE_BANDS];      // Voxels across each band along the distance axis
+    int64_t first_axis_cell[MAX_RANGE_BANDS]; // Index of each band's first voxel along the distance axis
+    for (int band = 0; band < num_bands; ++band) {
+        inverse_leaf[band] = 1.0f / rangeBandLeaf(config, band);
+        axis_cells[band] = std::max(int64_t(1), static_cast<int64_t>(std::ceil((band_start[band + 1] - band_start[band]) * inverse_leaf[band] - 1e-3f)));
+        first_axis_cell[band] = band == 0 ? 0 : first_axis_cell[band - 1] + axis_cells[band - 1];
+        workspace.band_points[band] = 0;
+        workspace.band_voxels[band] = 0;
+    }
+    workspace.num_bands = num_bands;
+    workspace.skipped_points = 0;
+
+    // Every point can open at most one voxel, so twice the point count keeps the table at most half full
+    size_t capacity = 16;
+    while (capacity < 2 * input.points.size()) {
+        capacity *= 2;
+    }
+    const uint64_t mask = capacity - 1;
+    workspace.bucket_keys.assign(capacity, EMPTY_VOXEL_KEY);
+    workspace.bucket_slots.resize(capacity);
+    workspace.sum_x.clear();
+    workspace.sum_y.clear();
+    workspace.sum_z.clear();
+    workspace.counts.clear();
+
+    for (const pcl::PointXYZ& point : input.points) {
+        const float distance = point.data[config.axis];
+        if (!(distance >= config.min_distance && distance <= config.max_distance) ||
+            !std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z)) {
+            continue;
+        }
+        int band = 0;
+        while (band + 1 < num_bands && distance >= band_start[band + 1]) {
+            band++;
+        }
+
+        // The distance axis is measured from the band's near edge (clamped so rounding at the far seam cannot
+        // open a voxel past it) and continues the numbering of the bands before it; the other two axes are
+        // measured from the sensor
+        int64_t cell[3];
+        for (int a = 0; a < 3; ++a) {
+            cell[a] = static_cast<int64_t>(std::floor(point.data[a] * inverse_leaf[band]));
+        }
+        cell[config.axis] = first_axis_cell[band] +
+                            std::min(static_cast<int64_t>(std::floor((distance - band_start[band]) * inverse_leaf[band])), axis_cells[band] - 1);
+        uint64_t key;
+        if (!packVoxelKey(cell[0], cell[1], cell[2], key)) {
+            workspace.skipped_points++;
+            continue;
+        }
+        workspace.band_points[band]++;
+
+        uint64_t bucket = voxelKeyBucket(key, mask);
+        while (workspace.bucket_keys[bucket] != key && workspace.bucket_keys[bucket] != EMPTY_VOXEL_KEY) {
+            bucket = (bucket + 1) & mask;
+        }
+        if (workspace.bucket_keys[bucket] == EMPTY_VOXEL_KEY) {
+            workspace.bucket_keys[bucket] = key;
+            workspace.bucket_slots[bucket] = static_cast<unsigned int>(workspace.counts.size());
+            workspace.sum_x.push_back(0.0f);
+            workspace.sum_y.push_back(0.0f);
+            workspace.sum_z.push_back(0.0f);
+            workspace.counts.push_back(0);
+            workspace.band_voxels[band]++;
+        }
+        const unsigned int slot = workspace.bucket_slots[bucket];
+        workspace.sum_x[slot] += point.x;
+        workspace.sum_y[slot] += point.y;
+        workspace.sum_z[slot] += point.z;
+        workspace.counts[slot]++;
+    }
+
+    // Centroids in the order the voxels were first seen
+    const size_t num_voxels = workspace.counts.size();
+    output.header = input.header;
+    output.points.resize(num_voxels);
+    for (size_t slot = 0; slot < num_voxels; ++slot) {
+        const float count = static_cast<float>(workspace.counts[slot]);
+        output.points[slot] = pcl::PointXYZ(workspace.sum_x[slot] / count, workspace.sum_y[slot] / count, workspace.sum_z[slot] / count);
+    }
+    output.width = static_cast<uint32_t>(num_voxels);
+    output.height = 1;
+    output.is_dense = true;
+}
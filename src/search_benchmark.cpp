@@ -0,0 +1,179 @@
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/search/kdtree.h>
+#include <pcl/search/flann_search.h>
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+#include "cloud_filters.h"
+#include "voxel_hash_search.h"
+#include "benchmark_frames.h" // Frame loading and timing
+
+// Compares the neighbour search backends on recorded frames:
+//   KdTree:     pcl::search::KdTree (KdTreeFLANN), what the nodes build every frame
+//   FLANN:      pcl::search::FlannSearch with its default single kd-tree index
+//   voxel hash: VoxelHashSearch (voxel_hash_search.h)
+// Every frame is voxel downsampled at several leaf sizes, which gives clouds of different sizes and densities.
+// For every frame and leaf size it prints, per backend, the time to build the index and the time to query every
+// point of the cloud for its K nearest neighbours and for its neighbours within RADIUS_LEAVES leaf edges (what
+// normal estimation and MLS do), and checks that the voxel hash finds the same neighbours as the KdTree.
+// Frames are RoboSense PCD files (see BENCHMARKS.md).
+// Usage: search_benchmark <frame.pcd> [frame.pcd ...]
+
+const float LEAF_SIZES[] = {0.03f, 0.05f, 0.1f, 0.13f};
+const int NUM_LEAF_SIZES = 4;
+const int K = 20;
+const float RADIUS_LEAVES = 2.5f;
+
+const int REPETITIONS = 5;
+
+typedef pcl::PointCloud<pcl::PointXYZ> Cloud;
+
+struct Timing {
+    double build = 0.0;
+    double knn = 0.0;
+    double radius = 0.0;
+
+    void add(const Timing& other) {
+        build += other.build;
+        knn += other.knn;
+        radius += other.radius;
+    }
+};
+
+// Neighbour distances of every query, to compare the backends
+struct Results {
+    std::vector<std::vector<float>> knn;
+    std::vector<size_t> radius_counts;
+};
+
+Timing timeSearch(pcl::search::Search<pcl::PointXYZ>& search, const Cloud::Ptr& cloud, double radius, Results& results) {
+    Timing timing;
+    timing.build = secondsPerCall(REPETITIONS, [&] { search.setInputCloud(cloud); });
+
+    std::vector<int> indices;
+    std::vector<float> distances;
+    results.knn.resize(cloud->points.size());
+    bool first_repetition = true;
+    timing.knn = secondsPerCall(REPETITIONS, [&] {
+        for (size_t i = 0; i < cloud->points.size(); ++i) {
+            search.nearestKSearch(cloud->points[i], K, indices, distances);
+            if (first_repetition) {
+                results.knn[i] = distances;
+            }
+        }
+        first_repetition = false;
+    });
+
+    results.radius_counts.resize(cloud->points.size());
+    timing.radius = secondsPerCall(REPETITIONS, [&] {
+        for (size_t i = 0; i < cloud->points.size(); ++i) {
+            results.radius_counts[i] = search.radiusSearch(cloud->points[i], radius, indices, distances);
+        }
+    });
+    return timing;
+}
+
+// Queries whose neighbour distances or radius counts differ from the reference
+size_t countMismatches(const Results& reference, const Results& results) {
+    size_t mismatches = 0;
+    for (size_t i = 0; i < reference.knn.size(); ++i) {
+        bool same = reference.knn[i].size() == results.knn[i].size() && reference.radius_counts[i] == results.radius_counts[i];
+        for (size_t j = 0; same && j < reference.knn[i].size(); ++j) {
+            same = std::fabs(reference.knn[i][j] - results.knn[i][j]) <= 1e-6f * std::max(1.0f, reference.knn[i][j]);
+        }
+        mismatches += same ? 0 : 1;
+    }
+    return mismatches;
+}
+
+void printTiming(const std::string& name, const Timing& timing) {
+    std::cout << "; " << name << " build " << timing.build * 1e3 << " ms, " << K << "-NN " << timing.knn * 1e3
+              << " ms, radius " << timing.radius * 1e3 << " ms";
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: search_benchmark <frame.pcd> [frame.pcd ...]" << std::endl;
+        return 1;
+    }
+
+    const CropBox everything = {-std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+                                -std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+                                -std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+    int frames[NUM_LEAF_SIZES] = {};
+    double points[NUM_LEAF_SIZES] = {};
+    Timing kdtree_total[NUM_LEAF_SIZES], flann_total[NUM_LEAF_SIZES], voxel_hash_total[NUM_LEAF_SIZES];
+    size_t total_mismatches = 0, total_queries = 0;
+    int read_frames = 0;
+
+    for (int f = 1; f < argc; ++f) {
+        Cloud raw;
+        if (!loadFrame(argv[f], raw)) {
+            continue;
+        }
+        read_frames++;
+        CloudSoA finite_points;
+        cropToSoA(raw, everything, finite_points);
+
+        for (int l = 0; l < NUM_LEAF_SIZES; ++l) {
+            const float leaf = LEAF_SIZES[l];
+            Cloud::Ptr cloud(new Cloud);
+            voxelGridDownsample(finite_points, leaf, leaf, leaf, *cloud);
+            if (cloud->points.size() <= static_cast<size_t>(K)) {
+                continue;
+            }
+            const double radius = RADIUS_LEAVES * leaf;
+
+            pcl::search::KdTree<pcl::PointXYZ> kdtree;
+            pcl::search::FlannSearch<pcl::PointXYZ> flann;
+            VoxelHashSearch<pcl::PointXYZ> voxel_hash(voxelHashCellSize(0.0, leaf));
+            Results kdtree_results, flann_results, voxel_hash_results;
+            const Timing kdtree_timing = timeSearch(kdtree, cloud, radius, kdtree_results);
+            const Timing flann_timing = timeSearch(flann, cloud, radius, flann_results);
+            const Timing voxel_hash_timing = timeSearch(voxel_hash, cloud, radius, voxel_hash_results);
+            const size_t mismatches = countMismatches(kdtree_results, voxel_hash_results);
+
+            std::cout << argv[f] << ", leaf " << leaf << " m: " << cloud->points.size() << " points";
+            printTiming("KdTree", kdtree_timing);
+            printTiming("FLANN", flann_timing);
+            printTiming("voxel hash", voxel_hash_timing);
+            std::cout << "; " << mismatches << " queries differ from the KdTree" << std::endl;
+
+            frames[l]++;
+            points[l] += cloud->points.size();
+            kdtree_total[l].add(kdtree_timing);
+            flann_total[l].add(flann_timing);
+            voxel_hash_total[l].add(voxel_hash_timing);
+            total_mismatches += mismatches;
+            total_queries += cloud->points.size();
+        }
+    }
+
+    if (!anyFramesRead(read_frames)) {
+        return 1;
+    }
+
+    for (int l = 0; l < NUM_LEAF_SIZES; ++l) {
+        if (frames[l] == 0) {
+            continue;
+        }
+        const double n = frames[l];
+        const Timing& kdtree = kdtree_total[l];
+        const Timing& voxel_hash = voxel_hash_total[l];
+        std::cout << "Leaf " << LEAF_SIZES[l] << " m, " << frames[l] << " frames, mean " << points[l] / n << " points: mean KdTree "
+                  << (kdtree.build + kdtree.knn + kdtree.radius) / n * 1e3 << " ms, FLANN "
+                  << (flann_total[l].build + flann_total[l].knn + flann_total[l].radius) / n * 1e3 << " ms, voxel hash "
+                  << (voxel_hash.build + voxel_hash.knn + voxel_hash.radius) / n * 1e3 << " ms; speedup over KdTree: build "
+                  << kdtree.build / voxel_hash.build << "x, " << K << "-NN " << kdtree.knn / voxel_hash.knn << "x, radius "
+                  << kdtree.radius / voxel_hash.radius << "x" << std::endl;
+    }
+    std::cout << total_mismatches << " of " << total_queries << " voxel hash queries differ from the KdTree" << std::endl;
+
+    return 0;
+}
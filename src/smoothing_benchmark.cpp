@@ -0,0 +1,154 @@
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/surface/mls.h>
+#include <pcl/search/kdtree.h>
+#include <pcl/common/centroid.h>
+#include <pcl/features/normal_3d.h>
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+#include "cloud_filters.h"
+#include "plane_smoothing.h"
+#include "benchmark_frames.h" // Frame loading and timing
+
+// Compares the smoothing stage of plane_prob.cpp on recorded frames:
+//   MLS:             lowPassFilterMLS, order 1, 5 cm radius, new KdTree every frame
+//   plane smoothing: planeProjectionSmoothing on the grid of the axis downsampling (plane_smoothing.h)
+// Both run on the output of plane_prob's y passthrough and axis downsampling. For every frame it prints the time
+// of both and three quality figures:
+//   roughness:    mean distance of a point to the plane fitted to its neighbours within 15 cm (lower is smoother),
+//                 for the unsmoothed cloud, the MLS output and the plane smoothing output
+//   displacement: mean distance each method moved the points
+//   difference:   mean distance between the MLS and the plane smoothing result of the same point
+// Frames are RoboSense PCD files of the stair recordings (see BENCHMARKS.md).
+// Usage: smoothing_benchmark <frame.pcd> [frame.pcd ...]
+
+// plane_prob.cpp settings: y passthrough, z limits and leaf size of the axis downsampling, MLS radius
+const CropBox BOX = {-std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), -0.2f, 0.2f, -0.5f, 0.0f};
+const float LEAF_X = 0.1f, LEAF_Y = 0.1f, LEAF_Z = 0.08f;
+const double MLS_RADIUS = 0.05;
+const double ROUGHNESS_RADIUS = 0.15;
+
+const int REPETITIONS = 10;
+
+typedef pcl::PointCloud<pcl::PointXYZ> Cloud;
+
+void smoothMLS(const Cloud::Ptr& cloud, Cloud& output) {
+    pcl::MovingLeastSquares<pcl::PointXYZ, pcl::PointXYZ> mls;
+    mls.setInputCloud(cloud);
+    mls.setComputeNormals(false);
+    mls.setPolynomialOrder(1);
+    mls.setSearchMethod(pcl::search::KdTree<pcl::PointXYZ>::Ptr(new pcl::search::KdTree<pcl::PointXYZ>));
+    mls.setSearchRadius(MLS_RADIUS);
+    mls.process(output);
+}
+
+double roughness(const Cloud::Ptr& cloud) {
+    if (cloud->points.empty()) {
+        return 0.0;
+    }
+    pcl::search::KdTree<pcl::PointXYZ> tree;
+    tree.setInputCloud(cloud);
+    std::vector<int> indices;
+    std::vector<float> distances;
+    double sum = 0.0;
+    size_t count = 0;
+    for (const pcl::PointXYZ& point : cloud->points) {
+        if (tree.radiusSearch(point, ROUGHNESS_RADIUS, indices, distances) < 3) {
+            continue;
+        }
+        Eigen::Matrix3f covariance;
+        Eigen::Vector4f mean;
+        pcl::computeMeanAndCovarianceMatrix(*cloud, indices, covariance, mean);
+        float nx, ny, nz, curvature;
+        pcl::solvePlaneParameters(covariance, nx, ny, nz, curvature);
+        sum += std::fabs(nx * (point.x - mean[0]) + ny * (point.y - mean[1]) + nz * (point.z - mean[2]));
+        count++;
+    }
+    return count > 0 ? sum / count : 0.0;
+}
+
+double meanDistance(const Cloud& a, const Cloud& b) {
+    const size_t size = std::min(a.points.size(), b.points.size());
+    double sum = 0.0;
+    for (size_t i = 0; i < size; ++i) {
+        const double dx = a.points[i].x - b.points[i].x, dy = a.points[i].y - b.points[i].y, dz = a.points[i].z - b.points[i].z;
+        sum += std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+    return size > 0 ? sum / size : 0.0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: smoothing_benchmark <frame.pcd> [frame.pcd ...]" << std::endl;
+        return 1;
+    }
+
+    int frames = 0, aligned_frames = 0;
+    double total_mls_time = 0.0, total_plane_time = 0.0;
+    double total_input_roughness = 0.0, total_mls_roughness = 0.0, total_plane_roughness = 0.0, total_difference = 0.0;
+    for (int f = 1; f < argc; ++f) {
+        Cloud raw;
+        if (!loadFrame(argv[f], raw)) {
+            continue;
+        }
+
+        CloudSoA survivors;
+        VoxelGridWorkspace voxel_grid;
+        Cloud::Ptr downsampled(new Cloud);
+        cropToSoA(raw, BOX, survivors);
+        voxelGridDownsample(survivors, LEAF_X, LEAF_Y, LEAF_Z, *downsampled, voxel_grid);
+
+        Cloud::Ptr mls_output(new Cloud), plane_output(new Cloud);
+        PlaneSmoothingConfig config;
+        PlaneSmoothingWorkspace workspace;
+
+        const double mls_time = secondsPerCall(REPETITIONS, [&] { smoothMLS(downsampled, *mls_output); });
+        const double plane_time = secondsPerCall(REPETITIONS, [&] {
+            planeProjectionSmoothing(survivors, voxel_grid, *downsampled, config, workspace, *plane_output);
+        });
+
+        const double input_roughness = roughness(downsampled);
+        const double mls_roughness = roughness(mls_output);
+        const double plane_roughness = roughness(plane_output);
+        // Without upsampling MLS normally returns one point per input point; the per-point figures need that
+        const bool aligned = mls_output->points.size() == downsampled->points.size();
+        const double difference = aligned ? meanDistance(*mls_output, *plane_output) : 0.0;
+
+        std::cout << argv[f] << ": " << downsampled->points.size() << " points, MLS " << mls_time * 1e3 << " ms, plane smoothing "
+                  << plane_time * 1e3 << " ms, speedup " << mls_time / plane_time << "x; roughness input "
+                  << input_roughness * 1e3 << " mm, MLS " << mls_roughness * 1e3 << " mm, plane smoothing "
+                  << plane_roughness * 1e3 << " mm; displacement MLS "
+                  << (aligned ? meanDistance(*downsampled, *mls_output) * 1e3 : 0.0) << " mm, plane smoothing "
+                  << meanDistance(*downsampled, *plane_output) * 1e3 << " mm ("
+                  << workspace.projected_points << " projected); MLS difference "
+                  << (aligned ? std::to_string(difference * 1e3) + " mm" : std::string("n/a, point counts differ")) << std::endl;
+
+        frames++;
+        total_mls_time += mls_time;
+        total_plane_time += plane_time;
+        total_input_roughness += input_roughness;
+        total_mls_roughness += mls_roughness;
+        total_plane_roughness += plane_roughness;
+        total_difference += difference;
+        aligned_frames += aligned ? 1 : 0;
+    }
+
+    if (!anyFramesRead(frames)) {
+        return 1;
+    }
+
+    std::cout << frames << " frames: mean MLS " << total_mls_time / frames * 1e3 << " ms, mean plane smoothing "
+              << total_plane_time / frames * 1e3 << " ms, speedup " << total_mls_time / total_plane_time
+              << "x; mean roughness input " << total_input_roughness / frames * 1e3 << " mm, MLS "
+              << total_mls_roughness / frames * 1e3 << " mm, plane smoothing " << total_plane_roughness / frames * 1e3
+              << " mm; mean MLS difference " << total_difference / std::max(1, aligned_frames) * 1e3 << " mm over "
+              << aligned_frames << " frames" << std::endl;
+
+    return 0;
+}
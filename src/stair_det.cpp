@@ -22,6 +22,9 @@
 #include <pcl/segmentation/conditional_euclidean_clustering.h>
 #include <pcl/features/normal_3d.h>
 
+#include "cloud_ingest.h" // Crop while reading PointCloud2 messages, without fromROSMsg
+#include "range_image.h" // Ring x azimuth organized scan with pixel-window neighbours
+
 
 
 
@@ -38,6 +41,25 @@ ros::Publisher pub_after_plane_3;
 ros::Publisher pub_after_plane_4;
 
 ros::Publisher marker_pub;
+ros::Publisher pub_after_range_image_edges;
+
+// Limits of passthroughFilterY
+const float PASSTHROUGH_MIN_Y = -0.7f, PASSTHROUGH_MAX_Y = 0.7f;
+
+// Apply the y passthrough while reading the message (cloud_ingest.h) instead of fromROSMsg + passthroughFilterY.
+// Same cloud either way; the raw cloud is then never built.
+bool use_direct_ingest = true;
+
+// Organize the RoboSense scan into a ring x azimuth range image (range_image.h) and find its depth edges and
+// clusters by pixel offsets. The range image needs the ring structure, so the node then listens to /rslidar_points.
+bool use_range_image = false;
+RangeImageConfig range_image_config; // Defaults: RS-LiDAR-16, 0.2 degree azimuth bins
+RangeImage range_image;
+NormalBatchWorkspace range_image_batch; // Covariances of the pixel windows, solved in one batch
+pcl::PointCloud<pcl::Normal>::Ptr range_image_normals(new pcl::PointCloud<pcl::Normal>);
+std::vector<int> range_image_edges;
+RangeImageClusterWorkspace range_image_clustering;
+std::vector<pcl::PointIndices> range_image_clusters;
 
 
 
@@ -140,7 +162,7 @@ pcl::PointCloud<pcl::PointXYZ>::Ptr passthroughFilterY(const pcl::PointCloud<pcl
   pcl::PassThrough<pcl::PointXYZ> pass;
   pass.setInputCloud(cloud);
   pass.setFilterFieldName("y");
-  pass.setFilterLimits(-0.7, 0.7);
+  pass.setFilterLimits(PASSTHROUGH_MIN_Y, PASSTHROUGH_MAX_Y);
 
   pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_filtered_y(new pcl::PointCloud<pcl::PointXYZ>);
   pass.filter(*cloud_filtered_y);
@@ -458,9 +480,14 @@ void pointcloud_callback(const sensor_msgs::PointCloud2ConstPtr& msg)
     // Start measuring time
     ros::Time start_time = ros::Time::now();
 
-    // Sensor data acquisition
+    // Sensor data acquisition (with direct ingestion this already includes the y passthrough)
     pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
-    pcl::fromROSMsg(*msg, *cloud);
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_after_passthrough_y(new pcl::PointCloud<pcl::PointXYZ>);
+    if (use_direct_ingest) {
+        readPointCloud2(*msg, cropBoxY(PASSTHROUGH_MIN_Y, PASSTHROUGH_MAX_Y), *cloud_after_passthrough_y);
+    } else {
+        pcl::fromROSMsg(*msg, *cloud);
+    }
 
     ros::Time rawCloud_end_time = ros::Time::now();
 
@@ -475,7 +502,9 @@ void pointcloud_callback(const sensor_msgs::PointCloud2ConstPtr& msg)
     // Passthrough Filtering with Y-Axis
     // start_time = ros::Time::now();
 
-    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_after_passthrough_y = passthroughFilterY(cloud);
+    if (!use_direct_ingest) {
+        cloud_after_passthrough_y = passthroughFilterY(cloud);
+    }
 
     // Output time taken for passthroughFilterY
     // ros::Time passthroughFilterY_end_time = ros::Time::now();
@@ -488,6 +517,22 @@ void pointcloud_callback(const sensor_msgs::PointCloud2ConstPtr& msg)
     publishProcessedCloud(cloud_after_passthrough_y, pub_after_passthrough_y, msg);
 
 
+    // Range image normals, edges (the step nosings) and clusters
+    if (use_range_image) {
+        buildRangeImage(*msg, cropBoxY(PASSTHROUGH_MIN_Y, PASSTHROUGH_MAX_Y), range_image_config, range_image);
+        rangeImageNormals(range_image, 1, 3, 0.15f, range_image_batch, *range_image_normals);
+        rangeImageEdges(range_image, *range_image_normals, 0.05f, 0.05f, range_image_edges);
+        rangeImageClusters(range_image, 1, 3, 0.1f, 20, range_image_clustering, range_image_clusters);
+
+        pcl::PointCloud<pcl::PointXYZ>::Ptr edge_cloud(new pcl::PointCloud<pcl::PointXYZ>);
+        pcl::copyPointCloud(*range_image.cloud, range_image_edges, *edge_cloud);
+        publishProcessedCloud(edge_cloud, pub_after_range_image_edges, msg);
+
+        ROS_INFO("Range image: %d of %d pixels filled, %zu edge pixels, %zu clusters",
+                 range_image.filled_pixels, range_image.rows * range_image.cols, range_image_edges.size(), range_image_clusters.size());
+    }
+
+
 
 
     // Downsampling Along a Specific Axis using Voxel Grid Downsampling
@@ -622,9 +667,11 @@ int main(int argc, char** argv)
     pub_after_plane_4 = nh.advertise<sensor_msgs::PointCloud2>("/plane_4", 1);
 
     marker_pub = nh.advertise<visualization_msgs::Marker>("segmented_plane_marker", 1);
+    pub_after_range_image_edges = nh.advertise<sensor_msgs::PointCloud2>("/range_image_edges", 1);
 
     // Subcribing to Lidar Sensor topic
-    ros::Subscriber sub = nh.subscribe<sensor_msgs::PointCloud2>("/scan_3D", 1, pointcloud_callback);
+    const char* lidar_topic = use_range_image ? "/rslidar_points" : "/scan_3D";
+    ros::Subscriber sub = nh.subscribe<sensor_msgs::PointCloud2>(lidar_topic, 1, pointcloud_callback);
 
     ros::spin();
 
@@ -8,8 +8,8 @@
 // #include <pcl/octree/octree.h>
 #include <pcl/filters/voxel_grid.h>
 // #include <pcl/search/flann_search.h>
-// #include <pcl/octree/octree_pointcloud.h>
-// #include <pcl/octree/octree_pointcloud_voxelcentroid.h>
+#include <pcl/octree/octree_pointcloud.h>
+#include <pcl/octree/octree_pointcloud_voxelcentroid.h>
 // #include <pcl/filters/statistical_outlier_removal.h>
 #include <pcl/filters/passthrough.h>
 #include <pcl/features/normal_3d.h>
@@ -26,6 +26,10 @@
 #include <pcl/filters/bilateral.h>
 #include <vector>
 
+#include "cloud_ingest.h" // Crop while reading PointCloud2 messages, without fromROSMsg
+#include "range_voxel_grid.h" // Single-pass voxel grid with the leaf size growing over distance bands
+#include "incremental_octree.h" // Voxel-centroid octree that keeps its leaves from frame to frame
+
 // #include <pcl/segmentation/organized_connected_component_segmentation.h>
 
 
@@ -58,6 +62,30 @@ ros::Publisher pub_after_axis_downsampling;
 ros::Publisher pub_after_plane_segmentation;
 // ros::Publisher pub_after_individual_planes;
 
+// Limits of passthroughFilterY
+const float PASSTHROUGH_MIN_Y = -0.2f, PASSTHROUGH_MAX_Y = 0.5f;
+
+// Apply the y passthrough while reading the message (cloud_ingest.h) instead of fromROSMsg + passthroughFilterY.
+// Same cloud either way; the raw cloud is then never built.
+bool use_direct_ingest = true;
+
+// Downsampling along x, all with the x limits [0, 2.3]:
+//   AxisVoxelGrid:     fixed 5 cm VoxelGrid (downsamplingAlongAxis)
+//   RangeAdaptive:     leaf growing from 5 cm at the sensor to 10 cm at the far end (dynamicVoxelGridDownsampling)
+//   IncrementalOctree: 5 cm voxel-centroid octree kept between frames (incrementalOctreeDownsamplingAlongAxis)
+// AxisVoxelGrid stays the default; the other two change the cloud the plane segmentation sees and are opt-in
+// until they have been compared on recorded frames.
+enum class DownsamplingMethod { AxisVoxelGrid, RangeAdaptive, IncrementalOctree };
+DownsamplingMethod downsampling_method = DownsamplingMethod::AxisVoxelGrid;
+
+RangeVoxelConfig dynamic_downsampling_config; // Leaf range 0.05 -> 0.1 m over 4 bands; axis and limits set per call
+RangeVoxelWorkspace dynamic_downsampling_workspace;
+
+// 3.2 m cube (2^6 voxels of 5 cm) in front of the sensor, corner on the 5 cm grid, so the octree voxels line up
+// with those of downsamplingAlongAxis. Points outside still go in; the octree then grows once and stays grown.
+IncrementalVoxelCentroidOctree<pcl::PointXYZ> incremental_octree(0.05, 0.0, -1.6, -1.6, 3.2, 1.6, 1.6);
+pcl::IndicesPtr incremental_octree_indices(new std::vector<int>);
+
 // ros::Publisher pub_after_region_growing_segmentation;
 // ros::Publisher pub_after_euclid_clust_segmentation;
 // ros::Publisher pub_x, pub_y, pub_z;
@@ -336,7 +364,7 @@ pcl::PointCloud<pcl::PointXYZ>::Ptr passthroughFilterY(const pcl::PointCloud<pcl
   pcl::PassThrough<pcl::PointXYZ> pass;
   pass.setInputCloud(cloud);
   pass.setFilterFieldName("y");
-  pass.setFilterLimits(-0.2, 0.5);
+  pass.setFilterLimits(PASSTHROUGH_MIN_Y, PASSTHROUGH_MAX_Y);
 
   pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_filtered_y(new pcl::PointCloud<pcl::PointXYZ>);
   pass.filter(*cloud_filtered_y);
@@ -411,111 +439,134 @@ pcl::PointCloud<pcl::PointXYZ>::Ptr downsamplingAlongAxis(const pcl::PointCloud<
 
 
 
-// pcl::PointCloud<pcl::PointXYZ>::Ptr dynamicVoxelGridDownsampling(const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud, const std::string& axis)
-// {
-//     // Set parameters for dynamic voxel grid downsampling
-//     double max_leaf_size = 0.1;  // Maximum leaf size at the sides
-//     double min_leaf_size = 0.05; // Minimum leaf size at the center
-//     double max_distance_from_center = 1.5;  // Maximum distance to consider
-
-//     // Create a new point cloud to store the downsampled points
-//     pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_downsampled(new pcl::PointCloud<pcl::PointXYZ>);
-
-//     // Calculate the bounding box of the point cloud
-//     pcl::PointXYZ min_point, max_point;
-//     pcl::getMinMax3D(*cloud, min_point, max_point);
-
-//     // Choose the axis index based on the provided string
-//     int axis_index;
-//     if (axis == "x") {
-//         axis_index = 0;
-//     } else if (axis == "y") {
-//         axis_index = 1;
-//     } else if (axis == "z") {
-//         axis_index = 2;
-//     } else {
-//         // Handle invalid axis string (add appropriate error handling)
-//         // For now, default to using the X-axis
-//         axis_index = 0;
-//     }
+// Range-adaptive Voxel Grid Downsampling Along a Specific Axis: one pass, the leaf size grows with the distance
+// along the axis in bands (range_voxel_grid.h), so far parts of the scene are not over-represented
+pcl::PointCloud<pcl::PointXYZ>::Ptr dynamicVoxelGridDownsampling(const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud, const std::string& axis, double min_limit, double max_limit)
+{
+    RangeVoxelConfig& config = dynamic_downsampling_config;
+    config.min_distance = static_cast<float>(min_limit);
+    config.max_distance = static_cast<float>(max_limit);
+    if (axis == "y") {
+        config.axis = 1;
+    } else if (axis == "z") {
+        config.axis = 2;
+    } else {
+        // Default to the X-axis, as for an invalid axis string
+        config.axis = 0;
+    }
+
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_downsampled(new pcl::PointCloud<pcl::PointXYZ>);
+    rangeAdaptiveVoxelDownsample(*cloud, config, dynamic_downsampling_workspace, *cloud_downsampled);
+
+    return cloud_downsampled;
+}
 
-//     // Calculate the center of the bounding box along the chosen axis
-//     double center = 0.5 * (min_point.data[axis_index] + max_point.data[axis_index]);
+// Points in and out of every distance band of the last dynamicVoxelGridDownsampling call (debug level, as it
+// runs every frame)
+void logDynamicDownsamplingBands()
+{
+    const RangeVoxelWorkspace& workspace = dynamic_downsampling_workspace;
+    const RangeVoxelConfig& config = dynamic_downsampling_config;
+    float band_start[MAX_RANGE_BANDS + 1];
+    rangeBandStarts(config, band_start);
+    for (int band = 0; band < workspace.num_bands; ++band) {
+        ROS_DEBUG("Band %d [%.3f, %.3f] m, leaf %.3f m: %d -> %d points", band, band_start[band], band_start[band + 1],
+                  rangeBandLeaf(config, band), workspace.band_points[band], workspace.band_voxels[band]);
+    }
+    if (workspace.skipped_points > 0) {
+        ROS_WARN_THROTTLE(5.0, "Dynamic downsampling skipped %d points outside the voxel key range", workspace.skipped_points);
+    }
+}
 
-//     // Calculate the leaf size based on the distance from the center
-//     double distance_from_center = fabs(center - max_point.data[axis_index]);
-//     double normalized_distance = std::min(distance_from_center / max_distance_from_center, 1.0);
-//     double dynamic_leaf_size = min_leaf_size + (max_leaf_size - min_leaf_size) * normalized_distance;
 
-//     // Voxel grid downsampling
-//     pcl::VoxelGrid<pcl::PointXYZ> voxel_grid;
-//     voxel_grid.setInputCloud(cloud);
-//     voxel_grid.setLeafSize(dynamic_leaf_size, dynamic_leaf_size, dynamic_leaf_size);
-//     voxel_grid.setFilterFieldName(axis);
 
-//     // Apply voxel grid downsampling
-//     voxel_grid.filter(*cloud_downsampled);
 
-//     return cloud_downsampled;
-// }
 
 
+// Indices of the points whose coordinate along axis_index (0 = x, 1 = y, 2 = z) is within the limits
+void axisLimitIndices(const pcl::PointCloud<pcl::PointXYZ>& cloud, int axis_index, double min_limit, double max_limit, std::vector<int>& indices)
+{
+  indices.clear();
+  for (int i = 0; i < static_cast<int>(cloud.points.size()); ++i) {
+    const float value = cloud.points[i].data[axis_index];
+    if (value >= min_limit && value <= max_limit) {
+      indices.push_back(i);
+    }
+  }
+}
 
 
+// Octree Downsampling: centroids of the occupied voxels of an OctreePointCloudVoxelCentroid built for this cloud
+pcl::PointCloud<pcl::PointXYZ>::Ptr octreeDownsampling(const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud, double octree_resolution)
+{
+  pcl::octree::OctreePointCloudVoxelCentroid<pcl::PointXYZ> octree(octree_resolution);// Use the pcl::octree namespace directly
 
+  // Set the input cloud and add points to the octree
+  octree.setInputCloud(cloud);
+  octree.addPointsFromInputCloud();
 
-// Create an OctreePointCloudVoxelCentroid object with the specified resolution
-// pcl::PointCloud<pcl::PointXYZ>::Ptr octreeDownsampling(const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud, double octree_resolution)
-// {
-//   pcl::octree::OctreePointCloudVoxelCentroid<pcl::PointXYZ> octree(octree_resolution);// Use the pcl::octree namespace directly
+  // Create a new point cloud to store the downsampled points
+  pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_downsampled(new pcl::PointCloud<pcl::PointXYZ>);
 
-//   // Set the input cloud and add points to the octree
-//   octree.setInputCloud(cloud);
-//   octree.addPointsFromInputCloud();
+  // Get the voxel centroids (downsampled points) from the octree
+  octree.getVoxelCentroids(cloud_downsampled->points);
+  cloud_downsampled->width = cloud_downsampled->size();
+  cloud_downsampled->height = 1;
 
-//   // Create a new point cloud to store the downsampled points
-//   pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_downsampled(new pcl::PointCloud<pcl::PointXYZ>);
+  return cloud_downsampled;
+}
 
-//   // Get the occupied voxel centers (downsampled points) from the octree
-//   octree.getOccupiedVoxelCenters(cloud_downsampled->points);
 
-//   return cloud_downsampled;
-// }
 
 
+// Octree Downsampling Along a Specific Axis: the octree is built from scratch from the points within the limits
+pcl::PointCloud<pcl::PointXYZ>::Ptr octreeDownsamplingAlongAxis(const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud,
+                                                               int axis_index,
+                                                               double min_limit,
+                                                               double max_limit,
+                                                               double octree_resolution)
+{
+    // Extract indices of points within specified axis limits
+    pcl::IndicesPtr new_point_indices(new std::vector<int>);
+    axisLimitIndices(*cloud, axis_index, min_limit, max_limit, *new_point_indices);
+
+    // Create Octree
+    pcl::octree::OctreePointCloudVoxelCentroid<pcl::PointXYZ> octree(octree_resolution);
+    octree.setInputCloud(cloud, new_point_indices);
+    octree.addPointsFromInputCloud();
+
+    // Extract the downsampled cloud
+    pcl::PointCloud<pcl::PointXYZ>::Ptr downsampled_cloud(new pcl::PointCloud<pcl::PointXYZ>);
+    octree.getVoxelCentroids(downsampled_cloud->points);
+    downsampled_cloud->width = downsampled_cloud->size();
+    downsampled_cloud->height = 1;
+
+    return downsampled_cloud;
+}
 
 
-// Octree Downsampling Along a Specific Axis
-// pcl::PointCloud<pcl::PointXYZ>::Ptr octreeDownsamplingAlongAxis(const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud,
-//                                                                int axis_index,
-//                                                                double min_limit,
-//                                                                double max_limit,
-//                                                                double octree_resolution)
-// {
-//     // Create Octree
-//     pcl::octree::OctreePointCloud<pcl::PointXYZ> octree(octree_resolution);
-//     octree.setInputCloud(cloud);
-//     octree.addPointsFromInputCloud();
 
-//     // Extract indices of points within specified axis limits
-//     std::vector<int> new_point_indices;
 
-//     for (int i = 0; i < cloud->points.size(); ++i) {
-//         // Get the point coordinates
-//         const pcl::PointXYZ& point = cloud->points[i];
+// Incremental Octree Downsampling Along a Specific Axis: same as above, but the octree (incremental_octree.h)
+// is kept between frames and only the voxels that were not occupied in the previous scan get new leaves
+pcl::PointCloud<pcl::PointXYZ>::Ptr incrementalOctreeDownsamplingAlongAxis(const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud,
+                                                                          int axis_index,
+                                                                          double min_limit,
+                                                                          double max_limit)
+{
+    axisLimitIndices(*cloud, axis_index, min_limit, max_limit, *incremental_octree_indices);
+    incremental_octree.update(cloud, incremental_octree_indices);
 
-//         // Decide whether to retain points based on the desired axis and limits
-//         if (point.data[axis_index] >= min_limit && point.data[axis_index] <= max_limit) {
-//             new_point_indices.push_back(i);
-//         }
-//     }
+    pcl::PointCloud<pcl::PointXYZ>::Ptr downsampled_cloud(new pcl::PointCloud<pcl::PointXYZ>);
+    incremental_octree.getVoxelCentroids(*downsampled_cloud);
+    downsampled_cloud->header = cloud->header;
 
-//     // Extract the downsampled cloud
-//     pcl::PointCloud<pcl::PointXYZ>::Ptr downsampled_cloud(new pcl::PointCloud<pcl::PointXYZ>);
-//     pcl::copyPointCloud(*cloud, new_point_indices, *downsampled_cloud);
+    size_t new_leaves = incremental_octree.newLeafCount();
+    ROS_INFO("Incremental octree: %zu voxels, %zu reused from the previous scan, %zu new",
+             downsampled_cloud->size(), downsampled_cloud->size() - new_leaves, new_leaves);
 
-//     return downsampled_cloud;
-// }
+    return downsampled_cloud;
+}
 
 
 
@@ -966,9 +1017,14 @@ void pointcloud_callback(const sensor_msgs::PointCloud2ConstPtr& msg)
   // Start measuring time
   ros::Time start_time = ros::Time::now();
   
-  // Sensor data acquisition
+  // Sensor data acquisition (with direct ingestion this already includes the y passthrough)
   pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
-  pcl::fromROSMsg(*msg, *cloud);
+  pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_after_passthrough_y(new pcl::PointCloud<pcl::PointXYZ>);
+  if (use_direct_ingest) {
+    readPointCloud2(*msg, cropBoxY(PASSTHROUGH_MIN_Y, PASSTHROUGH_MAX_Y), *cloud_after_passthrough_y);
+  } else {
+    pcl::fromROSMsg(*msg, *cloud);
+  }
 
   ros::Time rawCloud_end_time = ros::Time::now();
 
@@ -976,7 +1032,7 @@ void pointcloud_callback(const sensor_msgs::PointCloud2ConstPtr& msg)
   ros::Duration rawCloud_time = rawCloud_end_time - start_time;
   ROS_INFO("Raw Cloud Acquisition time: %f milliseconds", rawCloud_time.toSec() * 1000.0);
 
-  ROS_INFO("Number of points in the raw cloud: %d", getNumberOfPoints(cloud));
+  ROS_INFO("Number of points in the raw cloud: %d", static_cast<int>(msg->width * msg->height));
   
   
 
@@ -989,7 +1045,9 @@ void pointcloud_callback(const sensor_msgs::PointCloud2ConstPtr& msg)
 
   start_time = ros::Time::now();
   
-  pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_after_passthrough_y = passthroughFilterY(cloud);
+  if (!use_direct_ingest) {
+    cloud_after_passthrough_y = passthroughFilterY(cloud);
+  }
   
   // Output time taken for passthroughFilterY
   ros::Time passthroughFilterY_end_time = ros::Time::now();
@@ -1065,8 +1123,15 @@ void pointcloud_callback(const sensor_msgs::PointCloud2ConstPtr& msg)
   // Downsampling Along a Specific Axis using Voxel Grid Downsampling
   start_time = ros::Time::now();
   
-  // Downsampling along X-axis
-  pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_after_axis_downsampling = downsamplingAlongAxis(cloud_after_passthrough_y, "x", 0.0, 2.3);
+  // Downsampling along X-axis, with the leaf size growing over distance or fixed
+  pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_after_axis_downsampling;
+  if (downsampling_method == DownsamplingMethod::RangeAdaptive) {
+    cloud_after_axis_downsampling = dynamicVoxelGridDownsampling(cloud_after_passthrough_y, "x", 0.0, 2.3);
+  } else if (downsampling_method == DownsamplingMethod::IncrementalOctree) {
+    cloud_after_axis_downsampling = incrementalOctreeDownsamplingAlongAxis(cloud_after_passthrough_y, 0, 0.0, 2.3);
+  } else {
+    cloud_after_axis_downsampling = downsamplingAlongAxis(cloud_after_passthrough_y, "x", 0.0, 2.3);
+  }
   
   // Output time taken for Downsampling
   ros::Time axis_downsampling_end_time = ros::Time::now();
@@ -1075,6 +1140,9 @@ void pointcloud_callback(const sensor_msgs::PointCloud2ConstPtr& msg)
     
   // Get Number of Points
   ROS_INFO("Number of points in the cloud_after_axis_downsampling cloud: %d", getNumberOfPoints(cloud_after_axis_downsampling));
+  if (downsampling_method == DownsamplingMethod::RangeAdaptive) {
+    logDynamicDownsamplingBands();
+  }
 
   publishProcessedCloud(cloud_after_axis_downsampling, pub_after_axis_downsampling, msg);
 
@@ -1083,26 +1151,6 @@ void pointcloud_callback(const sensor_msgs::PointCloud2ConstPtr& msg)
 
 
 
-  // Dynamic Voxel Grid Downsampling Along a Specific Axis
-  // start_time = ros::Time::now();
-  
-  // pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_after_dynamic_axis_downsampling = dynamicVoxelGridDownsampling(cloud_after_passthrough_y, "x");
-  
-  // // Output time taken for Downsampling
-  // ros::Time dynamic_axis_downsampling_end_time = ros::Time::now();
-  // ros::Duration dynamic_axis_downsampling_time = dynamic_axis_downsampling_end_time - start_time;
-  // ROS_INFO("dynamic_axis_downsampling_time time: %f milliseconds", dynamic_axis_downsampling_time.toSec() * 1000.0);
-    
-  // // Get Number of Points
-  // ROS_INFO("Number of points in the cloud_after_dynamic_axis_downsampling cloud: %d", getNumberOfPoints(cloud_after_dynamic_axis_downsampling));
-
-  // publishProcessedCloud(cloud_after_dynamic_axis_downsampling, pub_after_dynamic_axis_downsampling, msg);
-
-
-
-
-
-
   // Octree Voxel Downsampling
   // start_time = ros::Time::now();
   
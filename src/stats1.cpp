@@ -11,6 +11,8 @@
 #include <pcl/filters/passthrough.h>
 #include <pcl/segmentation/sac_segmentation.h>
 
+#include "grid_outlier_removal.h" // O(N) density-based outlier removal without neighbour searches
+
 
 
 
@@ -30,6 +32,20 @@ ros::Publisher pub_stairs_candidate;
 ros::Publisher pub_stairs_region;
 ros::Publisher pub_detected_stairs;
 
+// Outlier removal method:
+//   Statistical: pcl::StatisticalOutlierRemoval, 50-NN mean distance within 3 standard deviations
+//   GridHash:    the same rule on the point counts of 10 cm cells (gridOutlierRemoval)
+// GridHash approximates the neighbour distance by the density of the 3x3x3 cell block and removes whole cells,
+// so Statistical stays the default until outlier_removal_benchmark agreement numbers support the switch.
+enum class OutlierRemovalMethod { Statistical, GridHash };
+OutlierRemovalMethod outlier_removal_method = OutlierRemovalMethod::Statistical;
+
+// Remove outliers from the cropped cloud (after the z and y passthrough) instead of the raw cloud
+bool outlier_removal_after_crop = false;
+
+GridOutlierConfig grid_outlier_config; // Defaults: 10 cm cells, 3 standard deviations
+GridOutlierWorkspace grid_outlier_workspace;
+
 // Global variable declarations
 // std::vector<pcl::PointIndices> stairs_labels;
 
@@ -38,6 +54,22 @@ ros::Publisher pub_detected_stairs;
 
 
 
+void removeOutliers(const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud, pcl::PointCloud<pcl::PointXYZ>& cloud_after_outlier_removal)
+{
+  if (outlier_removal_method == OutlierRemovalMethod::GridHash) {
+    gridOutlierRemoval(*cloud, grid_outlier_config, grid_outlier_workspace, cloud_after_outlier_removal);
+    return;
+  }
+
+  pcl::StatisticalOutlierRemoval<pcl::PointXYZ> sor;
+  sor.setInputCloud(cloud);
+  sor.setMeanK(50);
+  sor.setStddevMulThresh(3);
+  sor.filter(cloud_after_outlier_removal);
+}
+
+
+
 void pointcloud_callback(const sensor_msgs::PointCloud2ConstPtr& msg)
 {
   // Using PCL to declare the PointCloud type that we will be using from the LIDAR
@@ -48,18 +80,17 @@ void pointcloud_callback(const sensor_msgs::PointCloud2ConstPtr& msg)
 
   
   
-  // Step 1: Outlier Removal
-  pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_after_outlier_removal(new pcl::PointCloud<pcl::PointXYZ>);
-  pcl::StatisticalOutlierRemoval<pcl::PointXYZ> sor;
-  sor.setInputCloud(cloud);
-  sor.setMeanK(50);
-  sor.setStddevMulThresh(3);
-  sor.filter(*cloud_after_outlier_removal);
+  // Step 1: Outlier Removal (skipped here when it runs on the cropped cloud)
+  pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_after_outlier_removal = cloud;
+  if (!outlier_removal_after_crop) {
+    cloud_after_outlier_removal.reset(new pcl::PointCloud<pcl::PointXYZ>);
+    removeOutliers(cloud, *cloud_after_outlier_removal);
 
-  sensor_msgs::PointCloud2 outlier_removal_output_cloud;
-  pcl::toROSMsg(*cloud_after_outlier_removal, outlier_removal_output_cloud);
-  outlier_removal_output_cloud.header = msg->header;
-  pub_after_outlier_removal.publish(outlier_removal_output_cloud);
+    sensor_msgs::PointCloud2 outlier_removal_output_cloud;
+    pcl::toROSMsg(*cloud_after_outlier_removal, outlier_removal_output_cloud);
+    outlier_removal_output_cloud.header = msg->header;
+    pub_after_outlier_removal.publish(outlier_removal_output_cloud);
+  }
 
 
 
@@ -93,6 +124,18 @@ void pointcloud_callback(const sensor_msgs::PointCloud2ConstPtr& msg)
   passthrough_output_cloud_z_y.header = msg->header;
   pub_after_passthrough_z_y.publish(passthrough_output_cloud_z_y);
 
+  // Outlier Removal on the cropped cloud
+  if (outlier_removal_after_crop) {
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_after_crop_outlier_removal(new pcl::PointCloud<pcl::PointXYZ>);
+    removeOutliers(cloud_after_passthrough_z_y, *cloud_after_crop_outlier_removal);
+    cloud_after_passthrough_z_y = cloud_after_crop_outlier_removal;
+
+    sensor_msgs::PointCloud2 outlier_removal_output_cloud;
+    pcl::toROSMsg(*cloud_after_passthrough_z_y, outlier_removal_output_cloud);
+    outlier_removal_output_cloud.header = msg->header;
+    pub_after_outlier_removal.publish(outlier_removal_output_cloud);
+  }
+
 
 
   
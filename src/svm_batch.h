@@ -0,0 +1,388 @@
+#pragma once
+
+// Batch inference for two-class libsvm terrain models.
+//
+// The support vectors are stored as structure-of-arrays (sv_x, sv_y, coef) so the RBF kernel can be evaluated
+// for a block of points against a cache-sized block of support vectors with SIMD. Runtime CPU dispatch picks
+// AVX-512, AVX2 + FMA or the scalar path. Coordinates and accumulation are kept in double precision: the shipped
+// models keep ~55k support vectors per class with |coef| = C = 100, so the decision value is a small difference
+// of two sums in the millions and rounding the coordinates to float alone moves it by ~1e-4.
+//
+// The arrays are referenced through pointers so they can live either in the model's own storage (built from a
+// libsvm model) or directly in a memory-mapped binary model (see svm_binary_model.h).
+
+#include <svm.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SVM_BATCH_X86 1
+#endif
+
+enum class SVMBatchISA {
+    Scalar,
+    AVX2,
+    AVX512
+};
+
+inline const char* svmBatchISAName(SVMBatchISA isa) {
+    switch (isa) {
+        case SVMBatchISA::AVX512: return "AVX-512";
+        case SVMBatchISA::AVX2: return "AVX2";
+        default: return "Scalar";
+    }
+}
+
+// Widest instruction set supported by the CPU the node is running on
+inline SVMBatchISA detectSVMBatchISA() {
+#if defined(SVM_BATCH_X86) && defined(__GNUC__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return SVMBatchISA::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return SVMBatchISA::AVX2;
+    }
+#endif
+    return SVMBatchISA::Scalar;
+}
+
+// SoA copy of a two-class model over the features normal_x (index 1) and normal_y (index 2)
+struct SVMBatchModel {
+    int kernel_type = RBF;
+    double gamma = 0.0;
+    double rho = 0.0;
+    double label_positive = 0.0; // Label returned when the decision value is > 0 (libsvm's label[0])
+    double label_negative = 0.0; // Label returned otherwise (libsvm's label[1])
+    int num_sv = 0;
+
+    // Padded to a multiple of SVM_BATCH_PADDING with zero coefficients
+    int padded_sv = 0;
+    const double* sv_x = nullptr;
+    const double* sv_y = nullptr;
+    const double* coef = nullptr;
+
+    // Backing storage when built from a libsvm model; empty when the arrays point into a mapped binary model
+    std::vector<double> sv_x_storage;
+    std::vector<double> sv_y_storage;
+    std::vector<double> coef_storage;
+
+    // Linear kernel: decision = w_x * normal_x + w_y * normal_y - rho
+    double weight_x = 0.0;
+    double weight_y = 0.0;
+
+    SVMBatchISA isa = SVMBatchISA::Scalar;
+
+    SVMBatchModel() = default;
+    SVMBatchModel(const SVMBatchModel&) = delete; // The array pointers would dangle in a copy
+    SVMBatchModel& operator=(const SVMBatchModel&) = delete;
+};
+
+const int SVM_BATCH_PADDING = 8;       // Doubles per AVX-512 register
+const int SVM_BATCH_SV_BLOCK = 1024;   // 3 x 1024 doubles = 24 KB of SVs, stays in L1 across a point tile
+const int SVM_BATCH_POINT_TILE = 64;   // Points evaluated against one SV block before moving to the next
+const int SVM_BATCH_POINT_GROUP = 4;   // Points sharing each SV load in registers
+
+// Builds the SoA model. Only two-class C-SVC/nu-SVC models with RBF or linear kernels over features 1 and 2
+// are supported; returns false otherwise so the caller can keep using svm_predict.
+inline bool buildSVMBatchModel(const svm_model* svm, SVMBatchModel& batch) {
+    if (svm == nullptr || svm->nr_class != 2 ||
+        (svm->param.svm_type != C_SVC && svm->param.svm_type != NU_SVC) ||
+        (svm->param.kernel_type != RBF && svm->param.kernel_type != LINEAR)) {
+        return false;
+    }
+
+    int padded = (svm->l + SVM_BATCH_PADDING - 1) / SVM_BATCH_PADDING * SVM_BATCH_PADDING;
+    batch.sv_x_storage.assign(padded, 0.0);
+    batch.sv_y_storage.assign(padded, 0.0);
+    batch.coef_storage.assign(padded, 0.0);
+    batch.weight_x = 0.0;
+    batch.weight_y = 0.0;
+
+    for (int i = 0; i < svm->l; ++i) {
+        double coef = svm->sv_coef[0][i];
+        for (const svm_node* node = svm->SV[i]; node->index != -1; ++node) {
+            if (node->index == 1) {
+                batch.sv_x_storage[i] = node->value;
+                batch.weight_x += coef * node->value;
+            } else if (node->index == 2) {
+                batch.sv_y_storage[i] = node->value;
+                batch.weight_y += coef * node->value;
+            } else {
+                return false;
+            }
+        }
+        batch.coef_storage[i] = coef;
+    }
+
+    batch.padded_sv = padded;
+    batch.sv_x = batch.sv_x_storage.data();
+    batch.sv_y = batch.sv_y_storage.data();
+    batch.coef = batch.coef_storage.data();
+
+    batch.kernel_type = svm->param.kernel_type;
+    batch.gamma = svm->param.gamma;
+    batch.rho = svm->rho[0];
+    batch.label_positive = svm->label[0];
+    batch.label_negative = svm->label[1];
+    batch.num_sv = svm->l;
+    batch.isa = detectSVMBatchISA();
+
+    return true;
+}
+
+// ----------------------------------------------------------------------------------
+// RBF KERNEL BLOCKS
+// ----------------------------------------------------------------------------------
+// Each block function adds sum_k coef[k] * exp(-gamma * |p - sv[k]|^2) over sv[begin, end) to the sums of
+// SVM_BATCH_POINT_GROUP points. begin and end are multiples of SVM_BATCH_PADDING.
+
+inline void rbfBlockScalar(const SVMBatchModel& batch, int begin, int end,
+                           const double* px, const double* py, double* sums) {
+    const double* sv_x = batch.sv_x;
+    const double* sv_y = batch.sv_y;
+    const double* coef = batch.coef;
+
+    for (int p = 0; p < SVM_BATCH_POINT_GROUP; ++p) {
+        double sum = 0.0;
+        for (int k = begin; k < end; ++k) {
+            double dx = px[p] - sv_x[k];
+            double dy = py[p] - sv_y[k];
+            sum += coef[k] * std::exp(-batch.gamma * (dx * dx + dy * dy));
+        }
+        sums[p] += sum;
+    }
+}
+
+#ifdef SVM_BATCH_X86
+
+// exp(x) for x <= 0 in double precision: x = n * ln2 + r with |r| <= ln2 / 2, e^r from a degree-11 Taylor
+// polynomial (relative error < 1e-14), then scaled by 2^n through the exponent bits.
+// max_pd returns its second operand when either is NaN, so the clamp takes x second: a NaN argument (a NaN
+// feature) stays NaN through the polynomial and the decision value, like std::exp in the scalar path and libsvm.
+__attribute__((target("avx2,fma")))
+inline __m256d expAVX2(__m256d x) {
+    x = _mm256_max_pd(_mm256_set1_pd(-708.0), x);
+
+    __m256d n = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(1.4426950408889634)),
+                                _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256d r = _mm256_fnmadd_pd(n, _mm256_set1_pd(6.93147180369123816490e-01), x);
+    r = _mm256_fnmadd_pd(n, _mm256_set1_pd(1.90821492927058770002e-10), r);
+
+    __m256d poly = _mm256_set1_pd(1.0 / 39916800.0);
+    poly = _mm256_fmadd_pd(poly, r, _mm256_set1_pd(1.0 / 3628800.0));
+    poly = _mm256_fmadd_pd(poly, r, _mm256_set1_pd(1.0 / 362880.0));
+    poly = _mm256_fmadd_pd(poly, r, _mm256_set1_pd(1.0 / 40320.0));
+    poly = _mm256_fmadd_pd(poly, r, _mm256_set1_pd(1.0 / 5040.0));
+    poly = _mm256_fmadd_pd(poly, r, _mm256_set1_pd(1.0 / 720.0));
+    poly = _mm256_fmadd_pd(poly, r, _mm256_set1_pd(1.0 / 120.0));
+    poly = _mm256_fmadd_pd(poly, r, _mm256_set1_pd(1.0 / 24.0));
+    poly = _mm256_fmadd_pd(poly, r, _mm256_set1_pd(1.0 / 6.0));
+    poly = _mm256_fmadd_pd(poly, r, _mm256_set1_pd(0.5));
+    poly = _mm256_fmadd_pd(poly, r, _mm256_set1_pd(1.0));
+    poly = _mm256_fmadd_pd(poly, r, _mm256_set1_pd(1.0));
+
+    __m256i exponent = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(n));
+    exponent = _mm256_slli_epi64(_mm256_add_epi64(exponent, _mm256_set1_epi64x(1023)), 52);
+    return _mm256_mul_pd(poly, _mm256_castsi256_pd(exponent));
+}
+
+__attribute__((target("avx2,fma")))
+inline double horizontalSumAVX2(__m256d v) {
+    __m128d sum = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+}
+
+__attribute__((target("avx2,fma")))
+inline void rbfBlockAVX2(const SVMBatchModel& batch, int begin, int end,
+                         const double* px, const double* py, double* sums) {
+    const __m256d neg_gamma = _mm256_set1_pd(-batch.gamma);
+    __m256d point_x[SVM_BATCH_POINT_GROUP], point_y[SVM_BATCH_POINT_GROUP], acc[SVM_BATCH_POINT_GROUP];
+    for (int p = 0; p < SVM_BATCH_POINT_GROUP; ++p) {
+        point_x[p] = _mm256_set1_pd(px[p]);
+        point_y[p] = _mm256_set1_pd(py[p]);
+        acc[p] = _mm256_setzero_pd();
+    }
+
+    for (int k = begin; k < end; k += 4) {
+        __m256d sv_x = _mm256_loadu_pd(&batch.sv_x[k]);
+        __m256d sv_y = _mm256_loadu_pd(&batch.sv_y[k]);
+        __m256d coef = _mm256_loadu_pd(&batch.coef[k]);
+        for (int p = 0; p < SVM_BATCH_POINT_GROUP; ++p) {
+            __m256d dx = _mm256_sub_pd(point_x[p], sv_x);
+            __m256d dy = _mm256_sub_pd(point_y[p], sv_y);
+            __m256d dist = _mm256_fmadd_pd(dy, dy, _mm256_mul_pd(dx, dx));
+            acc[p] = _mm256_fmadd_pd(coef, expAVX2(_mm256_mul_pd(neg_gamma, dist)), acc[p]);
+        }
+    }
+
+    for (int p = 0; p < SVM_BATCH_POINT_GROUP; ++p) {
+        sums[p] += horizontalSumAVX2(acc[p]);
+    }
+}
+
+// Same reduction and NaN handling as expAVX2; the 2^n scaling uses scalef so no integer conversion is needed
+__attribute__((target("avx512f")))
+inline __m512d expAVX512(__m512d x) {
+    x = _mm512_max_pd(_mm512_set1_pd(-708.0), x);
+
+    __m512d n = _mm512_roundscale_pd(_mm512_mul_pd(x, _mm512_set1_pd(1.4426950408889634)),
+                                     _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m512d r = _mm512_fnmadd_pd(n, _mm512_set1_pd(6.93147180369123816490e-01), x);
+    r = _mm512_fnmadd_pd(n, _mm512_set1_pd(1.90821492927058770002e-10), r);
+
+    __m512d poly = _mm512_set1_pd(1.0 / 39916800.0);
+    poly = _mm512_fmadd_pd(poly, r, _mm512_set1_pd(1.0 / 3628800.0));
+    poly = _mm512_fmadd_pd(poly, r, _mm512_set1_pd(1.0 / 362880.0));
+    poly = _mm512_fmadd_pd(poly, r, _mm512_set1_pd(1.0 / 40320.0));
+    poly = _mm512_fmadd_pd(poly, r, _mm512_set1_pd(1.0 / 5040.0));
+    poly = _mm512_fmadd_pd(poly, r, _mm512_set1_pd(1.0 / 720.0));
+    poly = _mm512_fmadd_pd(poly, r, _mm512_set1_pd(1.0 / 120.0));
+    poly = _mm512_fmadd_pd(poly, r, _mm512_set1_pd(1.0 / 24.0));
+    poly = _mm512_fmadd_pd(poly, r, _mm512_set1_pd(1.0 / 6.0));
+    poly = _mm512_fmadd_pd(poly, r, _mm512_set1_pd(0.5));
+    poly = _mm512_fmadd_pd(poly, r, _mm512_set1_pd(1.0));
+    poly = _mm512_fmadd_pd(poly, r, _mm512_set1_pd(1.0));
+
+    return _mm512_scalef_pd(poly, n);
+}
+
+__attribute__((target("avx512f")))
+inline void rbfBlockAVX512(const SVMBatchModel& batch, int begin, int end,
+                           const double* px, const double* py, double* sums) {
+    const __m512d neg_gamma = _mm512_set1_pd(-batch.gamma);
+    __m512d point_x[SVM_BATCH_POINT_GROUP], point_y[SVM_BATCH_POINT_GROUP], acc[SVM_BATCH_POINT_GROUP];
+    for (int p = 0; p < SVM_BATCH_POINT_GROUP; ++p) {
+        point_x[p] = _mm512_set1_pd(px[p]);
+        point_y[p] = _mm512_set1_pd(py[p]);
+        acc[p] = _mm512_setzero_pd();
+    }
+
+    for (int k = begin; k < end; k += 8) {
+        __m512d sv_x = _mm512_loadu_pd(&batch.sv_x[k]);
+        __m512d sv_y = _mm512_loadu_pd(&batch.sv_y[k]);
+        __m512d coef = _mm512_loadu_pd(&batch.coef[k]);
+        for (int p = 0; p < SVM_BATCH_POINT_GROUP; ++p) {
+            __m512d dx = _mm512_sub_pd(point_x[p], sv_x);
+            __m512d dy = _mm512_sub_pd(point_y[p], sv_y);
+            __m512d dist = _mm512_fmadd_pd(dy, dy, _mm512_mul_pd(dx, dx));
+            acc[p] = _mm512_fmadd_pd(coef, expAVX512(_mm512_mul_pd(neg_gamma, dist)), acc[p]);
+        }
+    }
+
+    for (int p = 0; p < SVM_BATCH_POINT_GROUP; ++p) {
+        sums[p] += _mm512_reduce_add_pd(acc[p]);
+    }
+}
+
+#endif // SVM_BATCH_X86
+
+inline void rbfBlock(const SVMBatchModel& batch, SVMBatchISA isa, int begin, int end,
+                     const double* px, const double* py, double* sums) {
+#ifdef SVM_BATCH_X86
+    if (isa == SVMBatchISA::AVX512) {
+        rbfBlockAVX512(batch, begin, end, px, py, sums);
+        return;
+    }
+    if (isa == SVMBatchISA::AVX2) {
+        rbfBlockAVX2(batch, begin, end, px, py, sums);
+        return;
+    }
+#endif
+    rbfBlockScalar(batch, begin, end, px, py, sums);
+}
+
+// ----------------------------------------------------------------------------------
+// BATCH PREDICTION
+// ----------------------------------------------------------------------------------
+
+// Predicts count points whose features are read as normal_x[i * stride] and normal_y[i * stride], so a
+// pcl::PointCloud<pcl::Normal> can be passed directly (see predictBatchNormals). Writes the decision value
+// and the label of every point. Point tiles are distributed over the OpenMP threads.
+inline void predictBatch(const SVMBatchModel& batch, const float* normal_x, const float* normal_y, int count, int stride,
+                         double* decision_values, double* labels, SVMBatchISA isa) {
+    if (batch.kernel_type == LINEAR) {
+        #pragma omp parallel for
+        for (int i = 0; i < count; ++i) {
+            double value = batch.weight_x * normal_x[static_cast<size_t>(i) * stride] +
+                           batch.weight_y * normal_y[static_cast<size_t>(i) * stride] - batch.rho;
+            decision_values[i] = value;
+            labels[i] = (value > 0) ? batch.label_positive : batch.label_negative;
+        }
+        return;
+    }
+
+    const int padded_sv = batch.padded_sv;
+    const int num_tiles = (count + SVM_BATCH_POINT_TILE - 1) / SVM_BATCH_POINT_TILE;
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int tile = 0; tile < num_tiles; ++tile) {
+        const int tile_begin = tile * SVM_BATCH_POINT_TILE;
+        const int tile_count = std::min(SVM_BATCH_POINT_TILE, count - tile_begin);
+
+        // Tile features padded to whole point groups; padding points are evaluated and discarded
+        double px[SVM_BATCH_POINT_TILE] = {0.0};
+        double py[SVM_BATCH_POINT_TILE] = {0.0};
+        double sums[SVM_BATCH_POINT_TILE] = {0.0};
+        for (int p = 0; p < tile_count; ++p) {
+            px[p] = normal_x[static_cast<size_t>(tile_begin + p) * stride];
+            py[p] = normal_y[static_cast<size_t>(tile_begin + p) * stride];
+        }
+        const int tile_groups = (tile_count + SVM_BATCH_POINT_GROUP - 1) / SVM_BATCH_POINT_GROUP;
+
+        for (int sv_begin = 0; sv_begin < padded_sv; sv_begin += SVM_BATCH_SV_BLOCK) {
+            const int sv_end = std::min(sv_begin + SVM_BATCH_SV_BLOCK, padded_sv);
+            for (int group = 0; group < tile_groups; ++group) {
+                const int offset = group * SVM_BATCH_POINT_GROUP;
+                rbfBlock(batch, isa, sv_begin, sv_end, px + offset, py + offset, sums + offset);
+            }
+        }
+
+        for (int p = 0; p < tile_count; ++p) {
+            double value = sums[p] - batch.rho;
+            decision_values[tile_begin + p] = value;
+            labels[tile_begin + p] = (value > 0) ? batch.label_positive : batch.label_negative;
+        }
+    }
+}
+
+// Decision value of a single point, for callers that predict one normal at a time
+inline double decisionValueSingle(const SVMBatchModel& batch, double normal_x, double normal_y) {
+    if (batch.kernel_type == LINEAR) {
+        return batch.weight_x * normal_x + batch.weight_y * normal_y - batch.rho;
+    }
+
+    double sum = 0.0;
+    for (int k = 0; k < batch.num_sv; ++k) {
+        double dx = normal_x - batch.sv_x[k];
+        double dy = normal_y - batch.sv_y[k];
+        sum += batch.coef[k] * std::exp(-batch.gamma * (dx * dx + dy * dy));
+    }
+    return sum - batch.rho;
+}
+
+inline void predictBatch(const SVMBatchModel& batch, const float* normal_x, const float* normal_y, int count, int stride,
+                         double* decision_values, double* labels) {
+    predictBatch(batch, normal_x, normal_y, count, stride, decision_values, labels, batch.isa);
+}
+
+// Convenience overload reading normal_x / normal_y in place from any PCL normal cloud
+template <typename PointCloudT>
+inline void predictBatchNormals(const SVMBatchModel& batch, const PointCloudT& cloud,
+                                std::vector<double>& decision_values, std::vector<double>& labels) {
+    typedef typename PointCloudT::PointType PointT;
+    const int count = static_cast<int>(cloud.points.size());
+    decision_values.resize(count);
+    labels.resize(count);
+    if (count == 0) {
+        return;
+    }
+
+    const int stride = sizeof(PointT) / sizeof(float);
+    predictBatch(batch, &cloud.points[0].normal_x, &cloud.points[0].normal_y, count, stride,
+                 decision_values.data(), labels.data());
+}
@@ -0,0 +1,209 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <omp.h>
+#include <svm.h>
+
+#include "svm_batch.h"
+#include "svm_random_features.h"
+
+// Benchmarks the SoA batch inference kernels (svm_batch.h) and the random feature approximation
+// (svm_random_features.h) against scalar libsvm on the shipped terrain models.
+// Usage: svm_benchmark [num_samples] [feature_csv ...]
+// Without feature CSVs the normals are drawn from a normal distribution clamped to [-1, 1].
+
+// Same layout as pcl::Normal so the batch API is exercised with the stride used by model_predicting
+struct NormalSample {
+    float normal_x;
+    float normal_y;
+    float normal_z;
+    float padding;
+    float curvature;
+    float padding_curvature[3];
+};
+
+const std::string MODEL_DIRECTORY = "/home/shovon/Desktop/catkin_ws/src/stat_analysis/model_results/terrain_classification/";
+
+// Function to load NormalX/NormalY from the feature CSVs (X,Y,Z,NormalX,NormalY,NormalZ,...)
+void loadCSV(const std::string& filename, std::vector<NormalSample>& samples) {
+    std::ifstream file(filename);
+    std::string line;
+
+    if (!file) {
+        std::cerr << "Could not open " << filename << std::endl;
+        return;
+    }
+
+    // Skip header line
+    std::getline(file, line);
+
+    while (std::getline(file, line)) {
+        std::stringstream ss(line);
+        std::string token;
+
+        // Skip X, Y, Z columns
+        for (int i = 0; i < 3; ++i) {
+            std::getline(ss, token, ',');
+        }
+
+        NormalSample sample = {};
+        std::getline(ss, token, ',');
+        sample.normal_x = std::stof(token);
+        std::getline(ss, token, ',');
+        sample.normal_y = std::stof(token);
+        samples.push_back(sample);
+    }
+}
+
+double secondsSince(const std::chrono::high_resolution_clock::time_point& start) {
+    return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void benchmarkModel(const std::string& model_path, const std::vector<NormalSample>& samples) {
+    svm_model* model = svm_load_model(model_path.c_str());
+    if (model == nullptr) {
+        std::cerr << "Failed to load model from " << model_path << std::endl;
+        return;
+    }
+
+    SVMBatchModel batch;
+    if (!buildSVMBatchModel(model, batch)) {
+        std::cerr << "Model is not supported by the batch API: " << model_path << std::endl;
+        svm_free_and_destroy_model(&model);
+        return;
+    }
+
+    int count = samples.size();
+    std::cout << "\nModel: " << model_path << "\n"
+              << "  Kernel: " << (batch.kernel_type == RBF ? "rbf" : "linear") << ", support vectors: " << batch.num_sv
+              << ", samples: " << count << std::endl;
+
+    // Scalar libsvm reference, one point at a time on a single thread
+    std::vector<double> reference_values(count), reference_labels(count);
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < count; ++i) {
+        svm_node nodes[3];
+        nodes[0].index = 1;
+        nodes[0].value = samples[i].normal_x;
+        nodes[1].index = 2;
+        nodes[1].value = samples[i].normal_y;
+        nodes[2].index = -1;
+        reference_labels[i] = svm_predict_values(model, nodes, &reference_values[i]);
+    }
+    double reference_time = secondsSince(start);
+    std::cout << "  libsvm (1 thread): " << reference_time << " s, " << count / reference_time << " points/s" << std::endl;
+
+    const int stride = sizeof(NormalSample) / sizeof(float);
+    // The linear path is w.x - rho per point and does not depend on the instruction set
+    std::vector<SVMBatchISA> isas = {SVMBatchISA::Scalar};
+    if (batch.kernel_type == RBF && detectSVMBatchISA() != SVMBatchISA::Scalar) {
+        isas.push_back(SVMBatchISA::AVX2);
+    }
+    if (batch.kernel_type == RBF && detectSVMBatchISA() == SVMBatchISA::AVX512) {
+        isas.push_back(SVMBatchISA::AVX512);
+    }
+
+    const int max_threads = omp_get_max_threads();
+    std::vector<int> thread_counts = {1};
+    if (max_threads > 1) {
+        thread_counts.push_back(max_threads);
+    }
+
+    for (SVMBatchISA isa : isas) {
+        for (int threads : thread_counts) {
+            std::vector<double> values(count), labels(count);
+            omp_set_num_threads(threads);
+
+            start = std::chrono::high_resolution_clock::now();
+            predictBatch(batch, &samples[0].normal_x, &samples[0].normal_y, count, stride, values.data(), labels.data(), isa);
+            double batch_time = secondsSince(start);
+
+            double max_error = 0.0;
+            int label_mismatches = 0;
+            for (int i = 0; i < count; ++i) {
+                max_error = std::max(max_error, std::fabs(values[i] - reference_values[i]));
+                if (labels[i] != reference_labels[i]) {
+                    label_mismatches++;
+                }
+            }
+
+            std::cout << "  Batch " << svmBatchISAName(isa) << " (" << threads << " thread" << (threads > 1 ? "s" : "") << "): "
+                      << batch_time << " s, " << count / batch_time << " points/s, speedup " << reference_time / batch_time
+                      << "x, max decision error " << max_error << ", label mismatches " << label_mismatches << std::endl;
+        }
+    }
+    omp_set_num_threads(max_threads);
+
+    // Random feature approximation: explicit linear model over D features, single thread like the libsvm reference
+    if (batch.kernel_type == RBF) {
+        for (RandomFeatureMethod method : {RandomFeatureMethod::Fourier, RandomFeatureMethod::Nystroem}) {
+            for (int dimension : {64, 128, 256, 512}) {
+                RandomFeatureModel features;
+                start = std::chrono::high_resolution_clock::now();
+                if (!buildRandomFeatureModel(batch, method, dimension, 8000, 42, features)) {
+                    std::cerr << "  " << randomFeatureMethodName(method) << " fit failed for D = " << dimension << std::endl;
+                    continue;
+                }
+                double fit_time = secondsSince(start);
+
+                std::vector<double> values(count);
+                start = std::chrono::high_resolution_clock::now();
+                for (int i = 0; i < count; ++i) {
+                    values[i] = randomFeatureDecision(features, samples[i].normal_x, samples[i].normal_y);
+                }
+                double approx_time = secondsSince(start);
+
+                double max_error = 0.0;
+                int label_mismatches = 0;
+                for (int i = 0; i < count; ++i) {
+                    max_error = std::max(max_error, std::fabs(values[i] - reference_values[i]));
+                    if (randomFeatureLabel(features, values[i]) != reference_labels[i]) {
+                        label_mismatches++;
+                    }
+                }
+
+                std::cout << "  " << randomFeatureMethodName(method) << " D = " << dimension << " (1 thread): " << approx_time
+                          << " s, fit " << fit_time << " s, speedup " << reference_time / approx_time << "x, max decision error "
+                          << max_error << ", label mismatches " << label_mismatches << std::endl;
+            }
+        }
+    }
+
+    svm_free_and_destroy_model(&model);
+}
+
+int main(int argc, char** argv) {
+    int num_samples = (argc > 1) ? std::stoi(argv[1]) : 2000;
+
+    std::vector<NormalSample> samples;
+    for (int i = 2; i < argc; ++i) {
+        loadCSV(argv[i], samples);
+    }
+
+    if (samples.empty()) {
+        std::mt19937 generator(42);
+        std::normal_distribution<float> distribution(0.0f, 0.4f);
+        samples.resize(num_samples);
+        for (auto& sample : samples) {
+            sample = {};
+            sample.normal_x = std::min(1.0f, std::max(-1.0f, distribution(generator)));
+            sample.normal_y = std::min(1.0f, std::max(-1.0f, distribution(generator)));
+        }
+    } else if (static_cast<int>(samples.size()) > num_samples) {
+        std::shuffle(samples.begin(), samples.end(), std::mt19937{42});
+        samples.resize(num_samples);
+    }
+
+    std::cout << "Widest instruction set on this CPU: " << svmBatchISAName(detectSVMBatchISA()) << std::endl;
+
+    benchmarkModel(MODEL_DIRECTORY + "terrain_classification_cyglidar_model_svm_rbf.model", samples);
+    benchmarkModel(MODEL_DIRECTORY + "terrain_classification_cyglidar_model_90_linear.model", samples);
+
+    return 0;
+}
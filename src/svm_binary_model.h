@@ -0,0 +1,170 @@
+#pragma once
+
+// Compiled binary format for two-class terrain models.
+//
+// svm_load_model parses tens of megabytes of "coef 1:x 2:y" text on every node start. The binary file holds the
+// same model as 64-byte aligned SoA arrays (double sv_x, sv_y, coef) behind a fixed header, so the
+// node can mmap it and hand the arrays to the batch kernels in svm_batch.h without any parse or copy step.
+//
+// Layout: SVMBinaryHeader | padding to 64 | sv_x[padded_sv] | sv_y[padded_sv] | coef[padded_sv]
+// Files are written in the byte order of the machine that converts them.
+
+#include <svm.h>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "svm_batch.h"
+
+const char SVM_BINARY_MAGIC[8] = {'S', 'V', 'M', 'B', 'I', 'N', '1', '\0'};
+const int SVM_BINARY_VERSION = 2; // Version 1 stored the SV coordinates as float
+const uint64_t SVM_BINARY_ALIGNMENT = 64;
+
+struct SVMBinaryHeader {
+    char magic[8];
+    int32_t version;
+    int32_t svm_type;
+    int32_t kernel_type;
+    int32_t num_sv;
+    int32_t padded_sv;
+    int32_t labels[2];
+    int32_t reserved;
+    double gamma;
+    double rho;
+    double weight_x; // Linear kernels: collapsed weight vector
+    double weight_y;
+    uint64_t sv_x_offset; // Byte offsets from the start of the file
+    uint64_t sv_y_offset;
+    uint64_t coef_offset;
+    uint64_t file_size;
+};
+
+inline uint64_t alignBinaryOffset(uint64_t offset) {
+    return (offset + SVM_BINARY_ALIGNMENT - 1) / SVM_BINARY_ALIGNMENT * SVM_BINARY_ALIGNMENT;
+}
+
+// Writes a batch model (see buildSVMBatchModel) to the binary format
+inline bool writeBinaryModel(const SVMBatchModel& batch, int svm_type, const std::string& path) {
+    SVMBinaryHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, SVM_BINARY_MAGIC, sizeof(header.magic));
+    header.version = SVM_BINARY_VERSION;
+    header.svm_type = svm_type;
+    header.kernel_type = batch.kernel_type;
+    header.num_sv = batch.num_sv;
+    header.padded_sv = batch.padded_sv;
+    header.labels[0] = static_cast<int32_t>(batch.label_positive);
+    header.labels[1] = static_cast<int32_t>(batch.label_negative);
+    header.gamma = batch.gamma;
+    header.rho = batch.rho;
+    header.weight_x = batch.weight_x;
+    header.weight_y = batch.weight_y;
+    header.sv_x_offset = alignBinaryOffset(sizeof(SVMBinaryHeader));
+    header.sv_y_offset = alignBinaryOffset(header.sv_x_offset + sizeof(double) * batch.padded_sv);
+    header.coef_offset = alignBinaryOffset(header.sv_y_offset + sizeof(double) * batch.padded_sv);
+    header.file_size = header.coef_offset + sizeof(double) * batch.padded_sv;
+
+    std::vector<char> buffer(header.file_size, 0);
+    std::memcpy(buffer.data(), &header, sizeof(header));
+    std::memcpy(buffer.data() + header.sv_x_offset, batch.sv_x, sizeof(double) * batch.padded_sv);
+    std::memcpy(buffer.data() + header.sv_y_offset, batch.sv_y, sizeof(double) * batch.padded_sv);
+    std::memcpy(buffer.data() + header.coef_offset, batch.coef, sizeof(double) * batch.padded_sv);
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(buffer.data(), buffer.size());
+    return static_cast<bool>(file);
+}
+
+// Read-only mapping of a binary model. The batch model's arrays point into the mapping, so it must outlive them.
+struct MappedSVMModel {
+    void* data = MAP_FAILED;
+    size_t size = 0;
+
+    MappedSVMModel() = default;
+    MappedSVMModel(const MappedSVMModel&) = delete;
+    MappedSVMModel& operator=(const MappedSVMModel&) = delete;
+
+    void unmap() {
+        if (data != MAP_FAILED) {
+            munmap(data, size);
+            data = MAP_FAILED;
+            size = 0;
+        }
+    }
+
+    ~MappedSVMModel() {
+        unmap();
+    }
+};
+
+inline bool isBinaryModelPath(const std::string& path) {
+    const std::string extension = ".bin";
+    return path.size() >= extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+// Maps a binary model and points the batch model at its arrays. Returns false (with a reason) on any mismatch.
+inline bool mapBinaryModel(const std::string& path, MappedSVMModel& mapping, SVMBatchModel& batch, std::string& error) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "cannot open file";
+        return false;
+    }
+
+    struct stat file_info;
+    if (fstat(fd, &file_info) != 0 || file_info.st_size < static_cast<off_t>(sizeof(SVMBinaryHeader))) {
+        close(fd);
+        error = "file is smaller than the header";
+        return false;
+    }
+
+    mapping.unmap();
+    mapping.size = file_info.st_size;
+    mapping.data = mmap(nullptr, mapping.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping.data == MAP_FAILED) {
+        error = "mmap failed";
+        return false;
+    }
+
+    const char* base = static_cast<const char*>(mapping.data);
+    const SVMBinaryHeader* header = reinterpret_cast<const SVMBinaryHeader*>(base);
+    if (std::memcmp(header->magic, SVM_BINARY_MAGIC, sizeof(SVM_BINARY_MAGIC)) != 0 || header->version != SVM_BINARY_VERSION) {
+        error = "not a version " + std::to_string(SVM_BINARY_VERSION) + " binary SVM model (rerun model_converter)";
+        mapping.unmap();
+        return false;
+    }
+    if (header->file_size != mapping.size || header->padded_sv < header->num_sv ||
+        header->padded_sv % SVM_BATCH_PADDING != 0 ||
+        header->coef_offset + sizeof(double) * header->padded_sv > mapping.size) {
+        error = "truncated or inconsistent file";
+        mapping.unmap();
+        return false;
+    }
+
+    batch.kernel_type = header->kernel_type;
+    batch.gamma = header->gamma;
+    batch.rho = header->rho;
+    batch.label_positive = header->labels[0];
+    batch.label_negative = header->labels[1];
+    batch.num_sv = header->num_sv;
+    batch.padded_sv = header->padded_sv;
+    batch.weight_x = header->weight_x;
+    batch.weight_y = header->weight_y;
+    batch.sv_x = reinterpret_cast<const double*>(base + header->sv_x_offset);
+    batch.sv_y = reinterpret_cast<const double*>(base + header->sv_y_offset);
+    batch.coef = reinterpret_cast<const double*>(base + header->coef_offset);
+    batch.sv_x_storage.clear();
+    batch.sv_y_storage.clear();
+    batch.coef_storage.clear();
+    batch.isa = detectSVMBatchISA();
+
+    return true;
+}
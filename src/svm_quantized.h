@@ -0,0 +1,272 @@
+#pragma once
+
+// Reduced-precision RBF inference for embedded (Jetson-class) deployments.
+//
+// Two representations of a two-class RBF batch model (svm_batch.h) that trade accuracy for memory bandwidth and
+// FPU work:
+//   Float32: float SVs and coefficients (12 bytes per SV), kernel in float, accumulated in float per SV block
+//   Int16:   Q13 SV coordinates and int16 coefficients (6 bytes per SV), kernel from an interpolated Q30 table
+//            (16 KB, stays in L1), int64 accumulation: no floating point in the inner loop
+//
+// Neither uses intrinsics: the loops are written to auto-vectorize, so the same code runs 4-wide on NEON (Jetson)
+// and on any x86 SIMD level the compiler targets, where the double path needs its hand-written x86 kernels.
+//
+// Both evaluate sum_k coef_k * (K_k - 1) + sum_k coef_k instead of sum_k coef_k * K_k. With gamma = 0.1 the kernel
+// stays close to 1 over the feature square, so the shifted terms are ~100x smaller than the raw ones and the two
+// class sums no longer cancel from the millions down to the decision value, which reduced precision could not
+// survive. The coefficient sum is exact (zero for C-SVC up to libsvm's rounding) and is added back in double.
+
+#include <svm.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "svm_batch.h"
+
+enum class SVMPrecision {
+    Double,
+    Float32,
+    Int16
+};
+
+inline const char* svmPrecisionName(SVMPrecision precision) {
+    switch (precision) {
+        case SVMPrecision::Float32: return "float32";
+        case SVMPrecision::Int16: return "int16";
+        default: return "double";
+    }
+}
+
+const int SVM_QUANTIZED_BLOCK = 512;        // SVs per partial sum in the float path
+const int SVM_INT16_COORD_BITS = 13;        // Q13 coordinates: [-1, 1] differences square into 29 bits
+const int SVM_INT16_TABLE_BITS = 12;        // 4096 kernel table intervals over the squared distance range
+const int SVM_INT16_FRACTION_BITS = 12;     // Interpolation weight resolution inside a table interval
+
+struct SVMFloatModel {
+    float gamma = 0.0f;
+    double rho = 0.0;
+    double coef_sum = 0.0;
+    double label_positive = 0.0;
+    double label_negative = 0.0;
+    int num_sv = 0;
+
+    std::vector<float> sv_x;
+    std::vector<float> sv_y;
+    std::vector<float> coef;
+};
+
+struct SVMInt16Model {
+    double rho = 0.0;
+    double coef_sum = 0.0;
+    double coef_scale = 0.0; // Real coefficient = coef * coef_scale
+    double label_positive = 0.0;
+    double label_negative = 0.0;
+    int num_sv = 0;
+
+    std::vector<int16_t> sv_x; // Q13
+    std::vector<int16_t> sv_y;
+    std::vector<int16_t> coef;
+
+    // expm1(-gamma * d^2) in Q30 at the interval boundaries of the squared Q13 distance. Two extra entries:
+    // the corner-to-corner distance 2^29 itself starts an interval that still needs its upper boundary.
+    std::vector<int32_t> kernel_table;
+    int table_shift = 0; // Squared Q13 distance >> table_shift is the table interval
+};
+
+inline int16_t quantizeCoordinate(double value) {
+    double clamped = std::min(std::max(value, -1.0), 1.0);
+    return static_cast<int16_t>(std::lround(clamped * (1 << SVM_INT16_COORD_BITS)));
+}
+
+// Bytes held by the model arrays of each representation (the double one is the SoA batch model)
+inline size_t svmModelBytes(const SVMBatchModel& batch) {
+    return static_cast<size_t>(batch.padded_sv) * 3 * sizeof(double);
+}
+
+inline size_t svmModelBytes(const SVMFloatModel& model) {
+    return model.sv_x.size() * sizeof(float) + model.sv_y.size() * sizeof(float) + model.coef.size() * sizeof(float);
+}
+
+inline size_t svmModelBytes(const SVMInt16Model& model) {
+    return (model.sv_x.size() + model.sv_y.size() + model.coef.size()) * sizeof(int16_t) + model.kernel_table.size() * sizeof(int32_t);
+}
+
+inline bool buildSVMFloatModel(const SVMBatchModel& batch, SVMFloatModel& model) {
+    if (batch.kernel_type != RBF || batch.num_sv == 0) {
+        return false;
+    }
+
+    model.gamma = static_cast<float>(batch.gamma);
+    model.rho = batch.rho;
+    model.label_positive = batch.label_positive;
+    model.label_negative = batch.label_negative;
+    model.num_sv = batch.num_sv;
+    model.sv_x.assign(batch.sv_x, batch.sv_x + batch.num_sv);
+    model.sv_y.assign(batch.sv_y, batch.sv_y + batch.num_sv);
+    model.coef.resize(batch.num_sv);
+
+    model.coef_sum = 0.0;
+    for (int k = 0; k < batch.num_sv; ++k) {
+        model.coef[k] = static_cast<float>(batch.coef[k]);
+        model.coef_sum += model.coef[k];
+    }
+    return true;
+}
+
+inline bool buildSVMInt16Model(const SVMBatchModel& batch, SVMInt16Model& model) {
+    if (batch.kernel_type != RBF || batch.num_sv == 0) {
+        return false;
+    }
+
+    model.rho = batch.rho;
+    model.label_positive = batch.label_positive;
+    model.label_negative = batch.label_negative;
+    model.num_sv = batch.num_sv;
+    model.sv_x.resize(batch.num_sv);
+    model.sv_y.resize(batch.num_sv);
+    model.coef.resize(batch.num_sv);
+
+    double max_coef = 0.0;
+    for (int k = 0; k < batch.num_sv; ++k) {
+        max_coef = std::max(max_coef, std::fabs(batch.coef[k]));
+    }
+    model.coef_scale = (max_coef > 0.0) ? max_coef / 32767.0 : 1.0;
+
+    model.coef_sum = 0.0;
+    for (int k = 0; k < batch.num_sv; ++k) {
+        model.sv_x[k] = quantizeCoordinate(batch.sv_x[k]);
+        model.sv_y[k] = quantizeCoordinate(batch.sv_y[k]);
+        model.coef[k] = static_cast<int16_t>(std::lround(batch.coef[k] / model.coef_scale));
+        model.coef_sum += model.coef[k] * model.coef_scale;
+    }
+
+    // Squared Q13 distances are below 2 * (2^14)^2 = 2^29
+    const int distance_bits = 2 * (SVM_INT16_COORD_BITS + 1) + 1;
+    model.table_shift = distance_bits - SVM_INT16_TABLE_BITS;
+    const int intervals = 1 << SVM_INT16_TABLE_BITS;
+    const double distance_scale = std::ldexp(1.0, -2 * SVM_INT16_COORD_BITS);
+    model.kernel_table.resize(intervals + 2);
+    for (int i = 0; i <= intervals + 1; ++i) {
+        double squared_distance = std::ldexp(static_cast<double>(i), model.table_shift) * distance_scale;
+        double shifted_kernel = std::expm1(-batch.gamma * squared_distance);
+        model.kernel_table[i] = static_cast<int32_t>(std::llround(std::max(shifted_kernel, -1.0) * 1073741824.0));
+    }
+    return true;
+}
+
+// exp in float for the kernel range x <= 0: x = n ln2 + r, |r| <= ln2 / 2, degree-6 polynomial for e^r and 2^n
+// assembled in the exponent bits. Branch-free (round-to-nearest by truncating x / ln2 - 0.5) so the SV loop vectorizes.
+inline float expFloat(float x) {
+    x = (x > -87.0f) ? x : -87.0f;
+    int32_t n = static_cast<int32_t>(x * 1.44269504f - 0.5f);
+    float nf = static_cast<float>(n);
+    float r = x - nf * 0.693359375f + nf * 2.12194440e-4f;
+    float p = 1.0f + r * (1.0f + r * (0.5f + r * (0.166666672f + r * (0.0416666716f + r * (0.00833333377f + r * 0.00138888892f)))));
+    int32_t bits = (n + 127) << 23;
+    float scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+    return p * scale;
+}
+
+// Decision values of SVM_BATCH_POINT_GROUP points in one pass over the SVs, so every SV load serves all of them.
+// Partial sums are kept per block of SVM_QUANTIZED_BLOCK SVs in float and only the block totals are added in double.
+inline void decisionValuesFloat(const SVMFloatModel& model, const float* normal_x, const float* normal_y, double* decision_values) {
+    static_assert(SVM_BATCH_POINT_GROUP == 4, "decisionValuesFloat keeps one accumulator per grouped point");
+    double sums[SVM_BATCH_POINT_GROUP] = {0.0};
+    for (int begin = 0; begin < model.num_sv; begin += SVM_QUANTIZED_BLOCK) {
+        int end = std::min(begin + SVM_QUANTIZED_BLOCK, model.num_sv);
+        float block0 = 0.0f, block1 = 0.0f, block2 = 0.0f, block3 = 0.0f;
+        #pragma omp simd reduction(+:block0, block1, block2, block3)
+        for (int k = begin; k < end; ++k) {
+            const float sx = model.sv_x[k], sy = model.sv_y[k], c = model.coef[k];
+            float dx0 = normal_x[0] - sx, dy0 = normal_y[0] - sy;
+            float dx1 = normal_x[1] - sx, dy1 = normal_y[1] - sy;
+            float dx2 = normal_x[2] - sx, dy2 = normal_y[2] - sy;
+            float dx3 = normal_x[3] - sx, dy3 = normal_y[3] - sy;
+            block0 += c * (expFloat(-model.gamma * (dx0 * dx0 + dy0 * dy0)) - 1.0f);
+            block1 += c * (expFloat(-model.gamma * (dx1 * dx1 + dy1 * dy1)) - 1.0f);
+            block2 += c * (expFloat(-model.gamma * (dx2 * dx2 + dy2 * dy2)) - 1.0f);
+            block3 += c * (expFloat(-model.gamma * (dx3 * dx3 + dy3 * dy3)) - 1.0f);
+        }
+        sums[0] += block0;
+        sums[1] += block1;
+        sums[2] += block2;
+        sums[3] += block3;
+    }
+    for (int p = 0; p < SVM_BATCH_POINT_GROUP; ++p) {
+        decision_values[p] = sums[p] + model.coef_sum - model.rho;
+    }
+}
+
+inline double decisionValueFloat(const SVMFloatModel& model, float normal_x, float normal_y) {
+    float xs[SVM_BATCH_POINT_GROUP], ys[SVM_BATCH_POINT_GROUP];
+    std::fill(xs, xs + SVM_BATCH_POINT_GROUP, normal_x);
+    std::fill(ys, ys + SVM_BATCH_POINT_GROUP, normal_y);
+    double values[SVM_BATCH_POINT_GROUP];
+    decisionValuesFloat(model, xs, ys, values);
+    return values[0];
+}
+
+inline double decisionValueInt16(const SVMInt16Model& model, float normal_x, float normal_y) {
+    const int32_t x = quantizeCoordinate(normal_x);
+    const int32_t y = quantizeCoordinate(normal_y);
+    const int fraction_shift = model.table_shift - SVM_INT16_FRACTION_BITS;
+    const int32_t fraction_mask = (1 << SVM_INT16_FRACTION_BITS) - 1;
+    const int32_t* table = model.kernel_table.data();
+
+    int64_t sum = 0;
+    #pragma omp simd reduction(+:sum)
+    for (int k = 0; k < model.num_sv; ++k) {
+        int32_t dx = x - model.sv_x[k];
+        int32_t dy = y - model.sv_y[k];
+        int32_t squared_distance = dx * dx + dy * dy;
+        int32_t interval = squared_distance >> model.table_shift;
+        int32_t fraction = (squared_distance >> fraction_shift) & fraction_mask;
+        int64_t lower = table[interval];
+        int64_t kernel = lower + (((table[interval + 1] - lower) * fraction) >> SVM_INT16_FRACTION_BITS);
+        sum += model.coef[k] * kernel;
+    }
+    return static_cast<double>(sum) * model.coef_scale / 1073741824.0 + model.coef_sum - model.rho;
+}
+
+inline double quantizedLabel(double decision_value, double label_positive, double label_negative) {
+    return (decision_value > 0) ? label_positive : label_negative;
+}
+
+// Decision values and labels for count points (strided like predictBatch), in parallel over point groups
+inline void predictFloat(const SVMFloatModel& model, const float* normal_x, const float* normal_y, int count, int stride,
+                         double* decision_values, double* labels) {
+    const int groups = (count + SVM_BATCH_POINT_GROUP - 1) / SVM_BATCH_POINT_GROUP;
+
+    #pragma omp parallel for schedule(dynamic, 4)
+    for (int g = 0; g < groups; ++g) {
+        const int first = g * SVM_BATCH_POINT_GROUP;
+        const int in_group = std::min(SVM_BATCH_POINT_GROUP, count - first);
+        float xs[SVM_BATCH_POINT_GROUP], ys[SVM_BATCH_POINT_GROUP];
+        for (int p = 0; p < SVM_BATCH_POINT_GROUP; ++p) {
+            // The last group repeats its last point
+            int i = first + std::min(p, in_group - 1);
+            xs[p] = normal_x[i * stride];
+            ys[p] = normal_y[i * stride];
+        }
+
+        double values[SVM_BATCH_POINT_GROUP];
+        decisionValuesFloat(model, xs, ys, values);
+        for (int p = 0; p < in_group; ++p) {
+            decision_values[first + p] = values[p];
+            labels[first + p] = quantizedLabel(values[p], model.label_positive, model.label_negative);
+        }
+    }
+}
+
+inline void predictInt16(const SVMInt16Model& model, const float* normal_x, const float* normal_y, int count, int stride,
+                         double* decision_values, double* labels) {
+    #pragma omp parallel for schedule(dynamic, 16)
+    for (int i = 0; i < count; ++i) {
+        decision_values[i] = decisionValueInt16(model, normal_x[i * stride], normal_y[i * stride]);
+        labels[i] = quantizedLabel(decision_values[i], model.label_positive, model.label_negative);
+    }
+}
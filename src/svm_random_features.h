@@ -0,0 +1,142 @@
+#pragma once
+
+// Explicit-feature approximation of RBF terrain models.
+//
+// The RBF decision function is replaced by a linear model over D explicit features:
+//   Fourier:  phi_j(x) = cos(w_j . x + b_j), w_j ~ N(0, 2 * gamma * I), b_j ~ U[0, 2 pi)  (random Fourier features)
+//   Nystroem: phi_j(x) = exp(-gamma * |x - l_j|^2), landmarks l_j sampled from the model's support vectors
+// plus a constant feature. The weights are fit by least squares to the exact decision values at points drawn
+// from the support vectors and from the [-1, 1]^2 feature square. Fitting the decision function directly
+// (instead of mapping each SV coefficient into feature space) matters for the shipped models: their decision
+// value is the small difference of two sums in the millions, which a per-kernel approximation cannot preserve.
+// A prediction then costs D cos/exp evaluations instead of one per support vector, and D is the accuracy/latency knob.
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include "svm_batch.h"
+
+enum class RandomFeatureMethod {
+    Fourier,
+    Nystroem
+};
+
+inline const char* randomFeatureMethodName(RandomFeatureMethod method) {
+    return (method == RandomFeatureMethod::Fourier) ? "random Fourier" : "Nystroem";
+}
+
+struct RandomFeatureModel {
+    RandomFeatureMethod method = RandomFeatureMethod::Fourier;
+    int dimension = 0;
+    double gamma = 0.0;
+
+    // Fourier: frequencies and phases. Nystroem: landmark coordinates in center_x / center_y.
+    std::vector<double> center_x;
+    std::vector<double> center_y;
+    std::vector<double> phase;
+
+    std::vector<double> weights;
+    double bias = 0.0;
+
+    double label_positive = 0.0;
+    double label_negative = 0.0;
+};
+
+inline double randomFeature(const RandomFeatureModel& features, int j, double normal_x, double normal_y) {
+    if (features.method == RandomFeatureMethod::Fourier) {
+        return std::cos(features.center_x[j] * normal_x + features.center_y[j] * normal_y + features.phase[j]);
+    }
+    double dx = normal_x - features.center_x[j];
+    double dy = normal_y - features.center_y[j];
+    return std::exp(-features.gamma * (dx * dx + dy * dy));
+}
+
+inline double randomFeatureDecision(const RandomFeatureModel& features, double normal_x, double normal_y) {
+    double sum = features.bias;
+    for (int j = 0; j < features.dimension; ++j) {
+        sum += features.weights[j] * randomFeature(features, j, normal_x, normal_y);
+    }
+    return sum;
+}
+
+inline double randomFeatureLabel(const RandomFeatureModel& features, double decision_value) {
+    return (decision_value > 0) ? features.label_positive : features.label_negative;
+}
+
+// Builds a D-dimensional approximation of an RBF batch model, fit on fit_samples points
+inline bool buildRandomFeatureModel(const SVMBatchModel& batch, RandomFeatureMethod method, int dimension,
+                                    int fit_samples, unsigned int seed, RandomFeatureModel& features) {
+    if (batch.kernel_type != RBF || batch.num_sv == 0 || dimension <= 0) {
+        return false;
+    }
+
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<int> pick_sv(0, batch.num_sv - 1);
+    std::uniform_real_distribution<double> uniform_feature(-1.0, 1.0);
+
+    features.method = method;
+    features.dimension = dimension;
+    features.gamma = batch.gamma;
+    features.label_positive = batch.label_positive;
+    features.label_negative = batch.label_negative;
+    features.center_x.resize(dimension);
+    features.center_y.resize(dimension);
+    features.phase.assign(dimension, 0.0);
+
+    if (method == RandomFeatureMethod::Fourier) {
+        std::normal_distribution<double> frequency(0.0, std::sqrt(2.0 * batch.gamma));
+        std::uniform_real_distribution<double> phase(0.0, 2.0 * M_PI);
+        for (int j = 0; j < dimension; ++j) {
+            features.center_x[j] = frequency(generator);
+            features.center_y[j] = frequency(generator);
+            features.phase[j] = phase(generator);
+        }
+    } else {
+        for (int j = 0; j < dimension; ++j) {
+            int k = pick_sv(generator);
+            features.center_x[j] = batch.sv_x[k];
+            features.center_y[j] = batch.sv_y[k];
+        }
+    }
+
+    // Fit points: half from the support vectors (where the data lives), half uniform over the feature square
+    std::vector<float> fit_x(fit_samples), fit_y(fit_samples);
+    for (int i = 0; i < fit_samples; ++i) {
+        if (i % 2 == 0) {
+            int k = pick_sv(generator);
+            fit_x[i] = batch.sv_x[k];
+            fit_y[i] = batch.sv_y[k];
+        } else {
+            fit_x[i] = uniform_feature(generator);
+            fit_y[i] = uniform_feature(generator);
+        }
+    }
+
+    std::vector<double> targets(fit_samples), labels(fit_samples);
+    predictBatch(batch, fit_x.data(), fit_y.data(), fit_samples, 1, targets.data(), labels.data());
+
+    // Least squares over [phi(x), 1]. With a small gamma the features are nearly collinear, so the design matrix
+    // is solved by column-pivoted QR rather than through the (squared condition number) normal equations.
+    Eigen::MatrixXd design(fit_samples, dimension + 1);
+    #pragma omp parallel for
+    for (int i = 0; i < fit_samples; ++i) {
+        for (int j = 0; j < dimension; ++j) {
+            design(i, j) = randomFeature(features, j, fit_x[i], fit_y[i]);
+        }
+        design(i, dimension) = 1.0;
+    }
+    Eigen::VectorXd target = Eigen::Map<Eigen::VectorXd>(targets.data(), fit_samples);
+
+    Eigen::VectorXd solution = design.colPivHouseholderQr().solve(target);
+    if (!solution.allFinite()) {
+        return false;
+    }
+
+    features.weights.assign(solution.data(), solution.data() + dimension);
+    features.bias = solution(dimension);
+    return true;
+}
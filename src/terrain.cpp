@@ -60,10 +60,43 @@
 
 #include <random>
 
+#include "cloud_filters.h" // Fused crop box + voxel grid downsampling
+#include "cloud_ingest.h" // Crop while reading PointCloud2 messages, without fromROSMsg
+#include "normal_neighbourhood.h" // Capped k or leaf-sized radius for normal estimation
+#include "range_image.h" // Organized ring x azimuth image of the scan
+#include "integral_normals.h" // Normals from summed-area tables over the range image
+
 // ROS Publishers
 ros::Publisher pub_after_combined_passthrough;
 
 ros::Publisher pub_after_downsampling;
+
+// Crop box of combinedPassthroughFilter
+// const CropBox CROP_BOX = {1.5f, 3.0f, -0.6f, 0.6f, -0.7f, 0.2f}; // Parameters for RoboSense LiDAR
+const CropBox CROP_BOX = {0.0f, 2.2f, -0.6f, 0.6f, -0.7f, 0.7f};
+
+// Crop while reading the message (cloud_ingest.h) and downsample the survivors (cloud_filters.h) instead of
+// fromROSMsg + PassThrough x3 + VoxelGrid. Same output, but the full cloud and the intermediate
+// /combined_passthrough cloud are not built or published.
+bool use_fused_crop_voxel = true;
+CloudSoA ingest_buffers; // Survivors of the crop, reused across frames
+
+// Neighbourhood of the normal estimation (normal_neighbourhood.h). The features written here train the model,
+// so model_predicting.cpp has to use the same mode. CloudFraction is the original k = N/5.
+const float LEAF_SIZE = 0.05f;
+NormalNeighbourhoodConfig normal_neighbourhood;
+
+// Normal estimation method, the same switch as in model_predicting.cpp. IntegralImage reads the crop box into a
+// range image and takes the normals from integral images over its pixels (integral_normals.h) instead of
+// downsampling and a KdTree search. The image has one row per CygLidar D1 row (60 over its 65 degree vertical field
+// of view); for RoboSense recordings use the RangeImageConfig and IntegralImageNormalConfig defaults (16 rings, 2
+// degrees apart).
+enum class NormalMethod { KdTree, IntegralImage };
+NormalMethod normal_method = NormalMethod::KdTree;
+RangeImageConfig range_image_config = {60, 1800, -32.5f, 32.5f};
+IntegralImageNormalConfig integral_normal_config = {0.05f, 0.02f, 65.0f / 59.0f};
+RangeImage range_image; // Buffers reused across frames
+IntegralImageNormalWorkspace integral_normal_workspace;
 // ros::Publisher pub_after_downsampling_before_noise;
 // ros::Publisher pub_after_adding_noise;
 
@@ -149,21 +182,18 @@ pcl::PointCloud<pcl::PointXYZ>::Ptr combinedPassthroughFilter(const pcl::PointCl
     pass.setInputCloud(cloud);
     
     pass.setFilterFieldName("z");
-    // pass.setFilterLimits(-0.7, 0.2); // Parameters for RoboSense LiDAR
-    pass.setFilterLimits(-0.7, 0.7);
+    pass.setFilterLimits(CROP_BOX.min_z, CROP_BOX.max_z);
     pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_filtered(new pcl::PointCloud<pcl::PointXYZ>);
     pass.filter(*cloud_filtered);
 
     pass.setInputCloud(cloud_filtered);
     pass.setFilterFieldName("x");
-    // pass.setFilterLimits(1.5, 3); // Parameters for RoboSense LiDAR
-    pass.setFilterLimits(0, 2.2);
+    pass.setFilterLimits(CROP_BOX.min_x, CROP_BOX.max_x);
     pass.filter(*cloud_filtered);
 
     pass.setInputCloud(cloud_filtered);
     pass.setFilterFieldName("y");
-    // pass.setFilterLimits(-0.6, 0.6); // Parameters for RoboSense LiDAR
-    pass.setFilterLimits(-0.6, 0.6);
+    pass.setFilterLimits(CROP_BOX.min_y, CROP_BOX.max_y);
     pass.filter(*cloud_filtered);
 
     return cloud_filtered;
@@ -181,19 +211,15 @@ pcl::PointCloud<pcl::PointXYZ>::Ptr voxelGridDownsampling(const pcl::PointCloud<
     return cloud_downsampled;
 }
 
-// Parallelize Downsampling using OpenMP
+// Parallelize Downsampling using OpenMP: thread-local voxel maps merged in voxel order (cloud_filters.h)
 pcl::PointCloud<pcl::PointXYZ>::Ptr parallelVoxelGridDownsampling(const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud, float leaf_size_x, float leaf_size_y, float leaf_size_z) {
-    pcl::VoxelGrid<pcl::PointXYZ> voxel_grid;
-    
-    voxel_grid.setInputCloud(cloud);
-    voxel_grid.setLeafSize(leaf_size_x, leaf_size_y, leaf_size_z);
+    CloudSoA points;
+    cloudToSoA(*cloud, points);
 
     pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_downsampled(new pcl::PointCloud<pcl::PointXYZ>);
-    
-    #pragma omp parallel
-    {
-        voxel_grid.filter(*cloud_downsampled);
-    }
+    cloud_downsampled->header = cloud->header;
+    parallelVoxelGridDownsample(points, leaf_size_x, leaf_size_y, leaf_size_z, *cloud_downsampled);
+
     return cloud_downsampled;
 }
 
@@ -226,6 +252,46 @@ pcl::PointCloud<pcl::Normal>::Ptr computeNormals(const pcl::PointCloud<pcl::Poin
     return normals;
 }
 
+// Same as above with a k or radius neighbourhood (normal_neighbourhood.h). Points left with too few neighbours
+// by a radius search get their normal from their min_k nearest neighbours.
+pcl::PointCloud<pcl::Normal>::Ptr computeNormals(const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud, const NormalNeighbourhood& neighbourhood, int min_k) {
+    pcl::NormalEstimation<pcl::PointXYZ, pcl::Normal> ne;
+    ne.setInputCloud(cloud);
+
+    pcl::search::KdTree<pcl::PointXYZ>::Ptr tree(new pcl::search::KdTree<pcl::PointXYZ>);
+    ne.setSearchMethod(tree);
+
+    pcl::PointCloud<pcl::Normal>::Ptr normals(new pcl::PointCloud<pcl::Normal>);
+    if (neighbourhood.k <= 0 && neighbourhood.radius <= 0.0) {
+        ROS_ERROR("Invalid neighbourhood: k %d, radius %f", neighbourhood.k, neighbourhood.radius);
+        return normals;
+    }
+    setNormalNeighbourhood(ne, neighbourhood);
+    ne.compute(*normals);
+    if (neighbourhood.radius > 0.0) {
+        int filled = fillIsolatedNormals(*cloud, *tree, min_k, *normals);
+        ROS_INFO("Computed Normals: %ld (%d from the nearest neighbours)", normals->points.size(), filled);
+    } else {
+        ROS_INFO("Computed Normals: %ld", normals->points.size());
+    }
+
+    return normals;
+}
+
+// Same from the integral images of a range image (integral_normals.h). The pixels that got a normal are written to
+// cloud, so cloud and normals have the same size and no NaN normal.
+pcl::PointCloud<pcl::Normal>::Ptr computeNormals(const RangeImage& image, const IntegralImageNormalConfig& config, IntegralImageNormalWorkspace& workspace,
+                                                 pcl::PointCloud<pcl::PointXYZ>& cloud) {
+    pcl::PointCloud<pcl::Normal> organized_normals;
+    integralImageNormals(image, config, workspace, organized_normals);
+
+    pcl::PointCloud<pcl::Normal>::Ptr normals(new pcl::PointCloud<pcl::Normal>);
+    int dropped = compactNormals(image, organized_normals, cloud, *normals);
+    ROS_INFO("Computed Normals (Integral Image): %ld of %d pixels, %d without a valid window", normals->points.size(), image.filled_pixels, dropped);
+
+    return normals;
+}
+
 // Normal Visualization
 void visualizeNormals(const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud, const pcl::PointCloud<pcl::Normal>::Ptr& normals) {
     pcl::visualization::PCLVisualizer viewer("Normals Visualization");
@@ -313,8 +379,10 @@ void pointcloud_callback(const sensor_msgs::PointCloud2ConstPtr& input_msg, ros:
 {
     // Convert ROS PointCloud2 message to PCL PointCloud
     pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
-    pcl::fromROSMsg(*input_msg, *cloud);
-    ROS_INFO("Raw PointCloud: %ld points", cloud->points.size());
+    if (!use_fused_crop_voxel) {
+        pcl::fromROSMsg(*input_msg, *cloud);
+        ROS_INFO("Raw PointCloud: %ld points", cloud->points.size());
+    }
 
 
     // NOISE ADDITION FOR SIMULATING LOWER ACCURACY LIDAR >>> ONLY DONE TO ROBOSENSE LIDAR
@@ -337,22 +405,53 @@ void pointcloud_callback(const sensor_msgs::PointCloud2ConstPtr& input_msg, ros:
     // bag.write("/noisy_cloud", ros::Time::now(), noisy_cloud_msg);
     // ROS_INFO("Noisy cloud added to rosbag");
     
-    // Combined Passthrough Filtering to reduce function calls    
-    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_after_combined_passthrough = combinedPassthroughFilter(cloud);
-    publishProcessedCloud(cloud_after_combined_passthrough, pub_after_combined_passthrough, input_msg);
-    ROS_INFO("After Combined Passthough filter: %ld points", cloud_after_combined_passthrough->points.size());
-    
-    // Downsampling
-    // pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_after_downsampling = voxelGridDownsampling(cloud_after_passthrough_y, 0.13f, 0.13f, 0.05f);
-    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_after_downsampling = voxelGridDownsampling(cloud_after_combined_passthrough, 0.05f, 0.05f, 0.05f);
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_after_downsampling(new pcl::PointCloud<pcl::PointXYZ>);
+    if (normal_method == NormalMethod::IntegralImage) {
+        // Crop box applied while reading the message into the Range Image, which takes the place of the downsampling
+        buildRangeImage(*input_msg, CROP_BOX, range_image_config, range_image);
+        ROS_INFO("Range Image: %d of %d pixels filled", range_image.filled_pixels, range_image.rows * range_image.cols);
+
+        pcl::PointCloud<pcl::Normal>::Ptr cloud_normals = computeNormals(range_image, integral_normal_config, integral_normal_workspace, *cloud_after_downsampling);
+        if (cloud_normals->points.empty()) {
+            ROS_ERROR("Normal estimation failed. Skipping frame for CSV writing.");
+            return;
+        }
+        publishProcessedCloud(cloud_after_downsampling, pub_after_downsampling, input_msg);
+
+        // Save Features to CSV
+        saveFeaturesToCSV(cloud_after_downsampling, cloud_normals, file_path);
+        ROS_INFO("-----------------------------------------------------------------------------------");
+        return;
+    }
+    if (use_fused_crop_voxel) {
+        // Crop box applied while reading the message, then Voxel Grid Downsampling of the survivors
+        readPointCloud2(*input_msg, CROP_BOX, ingest_buffers);
+        ROS_INFO("Raw PointCloud: %u points, %ld inside the crop box", input_msg->width * input_msg->height, ingest_buffers.size());
+
+        pcl_conversions::toPCL(input_msg->header, cloud_after_downsampling->header);
+        voxelGridDownsample(ingest_buffers, LEAF_SIZE, LEAF_SIZE, LEAF_SIZE, *cloud_after_downsampling);
+    } else {
+        // Combined Passthrough Filtering to reduce function calls    
+        pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_after_combined_passthrough = combinedPassthroughFilter(cloud);
+        publishProcessedCloud(cloud_after_combined_passthrough, pub_after_combined_passthrough, input_msg);
+        ROS_INFO("After Combined Passthough filter: %ld points", cloud_after_combined_passthrough->points.size());
+        
+        // Downsampling
+        // pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_after_downsampling = voxelGridDownsampling(cloud_after_passthrough_y, 0.13f, 0.13f, 0.05f);
+        cloud_after_downsampling = voxelGridDownsampling(cloud_after_combined_passthrough, LEAF_SIZE, LEAF_SIZE, LEAF_SIZE);
+    }
         publishProcessedCloud(cloud_after_downsampling, pub_after_downsampling, input_msg);
     ROS_INFO("After Downsampling: %ld points", cloud_after_downsampling->points.size());
 
     // Normal Estimation and Visualization
-    int k_neighbors = std::max(10, static_cast<int>(cloud_after_downsampling->points.size() / 5));
-    ROS_INFO("Using %d neighbors for normal estimation.", k_neighbors);
+    NormalNeighbourhood neighbourhood = normalNeighbourhood(normal_neighbourhood, cloud_after_downsampling->points.size(), LEAF_SIZE);
+    if (neighbourhood.k > 0) {
+        ROS_INFO("Using %d neighbors for normal estimation.", neighbourhood.k);
+    } else {
+        ROS_INFO("Using a %.3f m radius for normal estimation.", neighbourhood.radius);
+    }
 
-    pcl::PointCloud<pcl::Normal>::Ptr cloud_normals = computeNormals(cloud_after_downsampling, k_neighbors);
+    pcl::PointCloud<pcl::Normal>::Ptr cloud_normals = computeNormals(cloud_after_downsampling, neighbourhood, normal_neighbourhood.min_k);
     if (cloud_normals->points.empty()) {
         ROS_ERROR("Normal estimation failed. Skipping frame for CSV writing.");
         return; // Skip writing to CSV if normals are empty
@@ -0,0 +1,324 @@
+#pragma once
+
+// Voxel hash neighbour search.
+//
+// The nodes build a pcl::search::KdTree for every frame, for normal estimation and MLS, on clouds that are
+// voxel grid outputs: at most one point per leaf, spread over a crop box of a few metres. VoxelHashSearch is a
+// pcl::search::Search backend for such clouds. setInputCloud sorts the points into cubic cells of a uniform
+// grid (one counting sort, the cells found through an open-addressing hash of their packed coordinates), and
+// the points of each cell are stored next to each other with their coordinates, so a query reads a few short
+// contiguous runs instead of walking a tree:
+//   radiusSearch:   the cells within the radius, i.e. the 27-cell block when the radius is at most one cell
+//   nearestKSearch: the 27-cell block first, then further shells of cells until the k-th nearest point found
+//                   is closer than the nearest unvisited cell. The result is exact, like the KdTree's.
+// With a cell edge of about the search radius (or about twice the leaf size for small k) a query visits a
+// bounded number of points, so a frame of N queries costs O(N), and the build is O(N) instead of O(N log N).
+// Queries only read the grid, so they can run in parallel (NormalEstimationOMP).
+// search_benchmark compares it with KdTree and FLANN over several cloud and leaf sizes.
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/search/search.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "voxel_key.h" // Packed cell keys and their hash
+
+// Cell edge for a search with the given radius (0 for k-nearest searches) on a cloud downsampled with leaf_size:
+// the radius itself, so a radius search reads the 27-cell block, or two leaves, so that the block around a point
+// of a surface holds a few dozen points
+inline float voxelHashCellSize(double radius, float leaf_size) {
+    return radius > 0.0 ? static_cast<float>(radius) : 2.0f * leaf_size;
+}
+
+template <typename PointT>
+class VoxelHashSearch : public pcl::search::Search<PointT> {
+public:
+    typedef pcl::search::Search<PointT> Base;
+    typedef typename Base::PointCloudConstPtr PointCloudConstPtr;
+    typedef typename Base::IndicesConstPtr IndicesConstPtr;
+
+    using Base::nearestKSearch;
+    using Base::radiusSearch;
+
+    explicit VoxelHashSearch(float cell_size, bool sorted_results = false)
+        : Base("VoxelHashSearch", sorted_results), cell_size_(cell_size), inverse_cell_(1.0f / cell_size) {}
+
+    // Takes effect with the next setInputCloud
+    void setCellSize(float cell_size) {
+        cell_size_ = cell_size;
+        inverse_cell_ = 1.0f / cell_size;
+    }
+
+    float getCellSize() const {
+        return cell_size_;
+    }
+
+    // Sorts the cloud (or its indices) into the grid. Non-finite points are left out, as in the KdTree.
+    void setInputCloud(const PointCloudConstPtr& cloud, const IndicesConstPtr& indices = IndicesConstPtr()) override {
+        this->input_ = cloud;
+        this->indices_ = indices;
+        build();
+    }
+
+    // Exact k nearest neighbours, nearest first
+    int nearestKSearch(const PointT& point, int k, std::vector<int>& k_indices, std::vector<float>& k_sqr_distances) const override {
+        k_indices.clear();
+        k_sqr_distances.clear();
+        if (k <= 0 || entries_.empty() || !std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z)) {
+            return 0;
+        }
+
+        thread_local std::vector<std::pair<float, int>> candidates;
+        candidates.clear();
+        int cx, cy, cz;
+        cellOf(point.x, point.y, point.z, cx, cy, cz);
+
+        // Shells beyond this one hold no cells of the grid
+        const int last_ring = std::max({std::abs(cx - min_cell_[0]), std::abs(cx - max_cell_[0]),
+                                        std::abs(cy - min_cell_[1]), std::abs(cy - max_cell_[1]),
+                                        std::abs(cz - min_cell_[2]), std::abs(cz - max_cell_[2])});
+        for (int ring = 0; ring <= last_ring; ++ring) {
+            visitShell(cx, cy, cz, ring, [&](int begin, int end) {
+                for (int e = begin; e < end; ++e) {
+                    candidates.emplace_back(squaredDistance(entries_[e], point), entries_[e].index);
+                }
+            });
+            // Unvisited cells are at least ring cell edges away from the query (the 27-cell block is ring 1)
+            if (ring == 0 || static_cast<int>(candidates.size()) < k) {
+                continue;
+            }
+            std::nth_element(candidates.begin(), candidates.begin() + (k - 1), candidates.end());
+            const float covered = ring * cell_size_;
+            if (candidates[k - 1].first <= covered * covered) {
+                break;
+            }
+        }
+
+        const int found = std::min(k, static_cast<int>(candidates.size()));
+        std::partial_sort(candidates.begin(), candidates.begin() + found, candidates.end());
+        k_indices.resize(found);
+        k_sqr_distances.resize(found);
+        for (int i = 0; i < found; ++i) {
+            k_indices[i] = candidates[i].second;
+            k_sqr_distances[i] = candidates[i].first;
+        }
+        return found;
+    }
+
+    // All points within radius; with max_nn > 0 only the max_nn nearest of them. Sorted by distance when
+    // sorted results are enabled (or max_nn cuts the result short).
+    int radiusSearch(const PointT& point, double radius, std::vector<int>& k_indices, std::vector<float>& k_sqr_distances,
+                     unsigned int max_nn = 0) const override {
+        k_indices.clear();
+        k_sqr_distances.clear();
+        if (radius <= 0.0 || entries_.empty() || !std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z)) {
+            return 0;
+        }
+
+        thread_local std::vector<std::pair<float, int>> candidates;
+        candidates.clear();
+        const float squared_radius = static_cast<float>(radius * radius);
+        int min_x, min_y, min_z, max_x, max_y, max_z;
+        const float r = static_cast<float>(radius);
+        cellOf(point.x - r, point.y - r, point.z - r, min_x, min_y, min_z);
+        cellOf(point.x + r, point.y + r, point.z + r, max_x, max_y, max_z);
+        min_x = std::max(min_x, min_cell_[0]); max_x = std::min(max_x, max_cell_[0]);
+        min_y = std::max(min_y, min_cell_[1]); max_y = std::min(max_y, max_cell_[1]);
+        min_z = std::max(min_z, min_cell_[2]); max_z = std::min(max_z, max_cell_[2]);
+        for (int z = min_z; z <= max_z; ++z) {
+            for (int y = min_y; y <= max_y; ++y) {
+                for (int x = min_x; x <= max_x; ++x) {
+                    const unsigned int cell = findCell(x, y, z);
+                    if (cell == NO_CELL) {
+                        continue;
+                    }
+                    for (unsigned int e = cell_begin_[cell]; e < cell_begin_[cell + 1]; ++e) {
+                        const float distance = squaredDistance(entries_[e], point);
+                        if (distance <= squared_radius) {
+                            candidates.emplace_back(distance, entries_[e].index);
+                        }
+                    }
+                }
+            }
+        }
+
+        size_t found = candidates.size();
+        if (max_nn > 0 && found > max_nn) {
+            found = max_nn;
+            std::partial_sort(candidates.begin(), candidates.begin() + found, candidates.end());
+        } else if (this->sorted_results_) {
+            std::sort(candidates.begin(), candidates.end());
+        }
+        k_indices.resize(found);
+        k_sqr_distances.resize(found);
+        for (size_t i = 0; i < found; ++i) {
+            k_indices[i] = candidates[i].second;
+            k_sqr_distances[i] = candidates[i].first;
+        }
+        return static_cast<int>(found);
+    }
+
+    // Occupied cells of the last build
+    size_t cellCount() const {
+        return cell_keys_.size();
+    }
+
+private:
+    // Point of the cloud with its coordinates, stored cell by cell
+    struct Entry {
+        float x, y, z;
+        int index;
+    };
+
+    static constexpr unsigned int NO_CELL = std::numeric_limits<unsigned int>::max();
+
+    static float squaredDistance(const Entry& entry, const PointT& point) {
+        const float dx = entry.x - point.x, dy = entry.y - point.y, dz = entry.z - point.z;
+        return dx * dx + dy * dy + dz * dz;
+    }
+
+    void cellOf(float px, float py, float pz, int& x, int& y, int& z) const {
+        // Clamped into the key range (voxel_key.h), so that far-away points and queries still get valid cells.
+        // Clamping never brings two cells further apart, so the shell bound of nearestKSearch stays exact.
+        const float limit = static_cast<float>(VOXEL_KEY_LIMIT - 1);
+        x = static_cast<int>(std::floor(std::min(std::max(px * inverse_cell_, -limit), limit)));
+        y = static_cast<int>(std::floor(std::min(std::max(py * inverse_cell_, -limit), limit)));
+        z = static_cast<int>(std::floor(std::min(std::max(pz * inverse_cell_, -limit), limit)));
+    }
+
+    unsigned int findCell(int x, int y, int z) const {
+        uint64_t key;
+        if (!packVoxelKey(x, y, z, key)) {
+            return NO_CELL;
+        }
+        uint64_t bucket = voxelKeyBucket(key, bucket_mask_);
+        while (bucket_keys_[bucket] != key) {
+            if (bucket_keys_[bucket] == EMPTY_VOXEL_KEY) {
+                return NO_CELL;
+            }
+            bucket = (bucket + 1) & bucket_mask_;
+        }
+        return bucket_slots_[bucket];
+    }
+
+    // Calls visit(begin, end) with the entry run of every occupied cell at Chebyshev distance ring from (cx, cy, cz)
+    template <typename Visit>
+    void visitShell(int cx, int cy, int cz, int ring, Visit visit) const {
+        for (int dz = -ring; dz <= ring; ++dz) {
+            const int z = cz + dz;
+            if (z < min_cell_[2] || z > max_cell_[2]) {
+                continue;
+            }
+            for (int dy = -ring; dy <= ring; ++dy) {
+                const int y = cy + dy;
+                if (y < min_cell_[1] || y > max_cell_[1]) {
+                    continue;
+                }
+                // Inside the shell only the two end cells of the row belong to it
+                const bool inner_row = std::abs(dz) < ring && std::abs(dy) < ring;
+                const int step = inner_row ? 2 * ring : 1;
+                for (int dx = -ring; dx <= ring; dx += step) {
+                    const int x = cx + dx;
+                    if (x < min_cell_[0] || x > max_cell_[0]) {
+                        continue;
+                    }
+                    const unsigned int cell = findCell(x, y, z);
+                    if (cell != NO_CELL) {
+                        visit(static_cast<int>(cell_begin_[cell]), static_cast<int>(cell_begin_[cell + 1]));
+                    }
+                }
+            }
+        }
+    }
+
+    void build() {
+        const pcl::PointCloud<PointT>& cloud = *this->input_;
+        const size_t num_indices = this->indices_ ? this->indices_->size() : cloud.points.size();
+
+        size_t capacity = 16;
+        while (capacity < 2 * num_indices) {
+            capacity *= 2;
+        }
+        bucket_mask_ = capacity - 1;
+        bucket_keys_.assign(capacity, EMPTY_VOXEL_KEY);
+        bucket_slots_.resize(capacity);
+        cell_keys_.clear();
+        cell_begin_.clear();
+        point_cells_.resize(num_indices);
+        min_cell_[0] = min_cell_[1] = min_cell_[2] = std::numeric_limits<int>::max();
+        max_cell_[0] = max_cell_[1] = max_cell_[2] = std::numeric_limits<int>::min();
+
+        // Pass 1: cell of every point and the number of points per cell
+        for (size_t i = 0; i < num_indices; ++i) {
+            const PointT& point = cloud.points[this->indices_ ? (*this->indices_)[i] : i];
+            point_cells_[i] = NO_CELL;
+            if (!std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z)) {
+                continue;
+            }
+            int x, y, z;
+            cellOf(point.x, point.y, point.z, x, y, z);
+            uint64_t key;
+            packVoxelKey(x, y, z, key); // Always in range after cellOf
+            min_cell_[0] = std::min(min_cell_[0], x); max_cell_[0] = std::max(max_cell_[0], x);
+            min_cell_[1] = std::min(min_cell_[1], y); max_cell_[1] = std::max(max_cell_[1], y);
+            min_cell_[2] = std::min(min_cell_[2], z); max_cell_[2] = std::max(max_cell_[2], z);
+
+            uint64_t bucket = voxelKeyBucket(key, bucket_mask_);
+            while (bucket_keys_[bucket] != key && bucket_keys_[bucket] != EMPTY_VOXEL_KEY) {
+                bucket = (bucket + 1) & bucket_mask_;
+            }
+            if (bucket_keys_[bucket] == EMPTY_VOXEL_KEY) {
+                bucket_keys_[bucket] = key;
+                bucket_slots_[bucket] = static_cast<unsigned int>(cell_keys_.size());
+                cell_keys_.push_back(key);
+                cell_begin_.push_back(0);
+            }
+            const unsigned int cell = bucket_slots_[bucket];
+            cell_begin_[cell]++;
+            point_cells_[i] = cell;
+        }
+
+        // Pass 2: counts to run starts, then every point into the run of its cell
+        unsigned int total = 0;
+        for (unsigned int& begin : cell_begin_) {
+            const unsigned int count = begin;
+            begin = total;
+            total += count;
+        }
+        cell_begin_.push_back(total);
+        entries_.resize(total);
+        for (size_t i = 0; i < num_indices; ++i) {
+            const unsigned int cell = point_cells_[i];
+            if (cell == NO_CELL) {
+                continue;
+            }
+            const int index = this->indices_ ? (*this->indices_)[i] : static_cast<int>(i);
+            const PointT& point = cloud.points[index];
+            entries_[cell_begin_[cell]++] = {point.x, point.y, point.z, index};
+        }
+        // The scatter advanced every start to the next run's start; shift them back
+        for (size_t cell = cell_keys_.size(); cell > 0; --cell) {
+            cell_begin_[cell] = cell_begin_[cell - 1];
+        }
+        cell_begin_[0] = 0;
+    }
+
+    float cell_size_;
+    float inverse_cell_;
+    uint64_t bucket_mask_ = 0;
+    std::vector<uint64_t> bucket_keys_;
+    std::vector<unsigned int> bucket_slots_;
+    std::vector<uint64_t> cell_keys_;
+    std::vector<unsigned int> cell_begin_;  // Run of cell c in entries_: [cell_begin_[c], cell_begin_[c + 1])
+    std::vector<unsigned int> point_cells_;
+    std::vector<Entry> entries_;
+    int min_cell_[3] = {0, 0, 0};
+    int max_cell_[3] = {-1, -1, -1};
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+// Packed voxel keys for the open-addressing voxel maps (voxel_hash_search.h, grid_outlier_removal.h,
+// range_voxel_grid.h).
+//
+// A key holds the three integer cell coordinates as 21-bit offsets, i.e. cells in [-2^20, 2^20) on every axis
+// (52 km at 5 cm) around the sensor, in the low 63 bits, so the all-ones value is free to mark empty buckets.
+// packVoxelKey refuses coordinates outside that range instead of letting them wrap into another cell's key;
+// every caller either drops such points or clamps its coordinates into the range first.
+
+#include <cstdint>
+#include <limits>
+
+const int VOXEL_KEY_BITS = 21;
+const int64_t VOXEL_KEY_LIMIT = int64_t(1) << (VOXEL_KEY_BITS - 1); // Cell coordinates lie in [-LIMIT, LIMIT)
+const uint64_t EMPTY_VOXEL_KEY = std::numeric_limits<uint64_t>::max();
+
+// True when every coordinate is at least margin cells inside the key range
+inline bool voxelKeyInRange(int64_t x, int64_t y, int64_t z, int64_t margin = 0) {
+    const int64_t low = -VOXEL_KEY_LIMIT + margin;
+    const int64_t high = VOXEL_KEY_LIMIT - margin;
+    return x >= low && x < high && y >= low && y < high && z >= low && z < high;
+}
+
+// Packs the cell coordinates into key; returns false (key untouched) when they are outside the key range
+inline bool packVoxelKey(int64_t x, int64_t y, int64_t z, uint64_t& key) {
+    if (!voxelKeyInRange(x, y, z)) {
+        return false;
+    }
+    key = (static_cast<uint64_t>(x + VOXEL_KEY_LIMIT) << (2 * VOXEL_KEY_BITS)) |
+          (static_cast<uint64_t>(y + VOXEL_KEY_LIMIT) << VOXEL_KEY_BITS) | static_cast<uint64_t>(z + VOXEL_KEY_LIMIT);
+    return true;
+}
+
+// Key of the cell (dx, dy, dz) away, by adding to the packed fields. Only valid when the cell of key was packed
+// with voxelKeyInRange(x, y, z, margin) for a margin of at least max(|dx|, |dy|, |dz|), so no field over- or
+// underflows into its neighbour.
+inline uint64_t offsetVoxelKey(uint64_t key, int64_t dx, int64_t dy, int64_t dz) {
+    return key + static_cast<uint64_t>(dx * (int64_t(1) << (2 * VOXEL_KEY_BITS)) + dy * (int64_t(1) << VOXEL_KEY_BITS) + dz);
+}
+
+// Bucket of a key in a power-of-two table (mask = size - 1)
+inline uint64_t voxelKeyBucket(uint64_t key, uint64_t mask) {
+    return ((key * 0x9E3779B97F4A7C15ull) >> 32) & mask; // Fibonacci hash
+}
@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "decision_lut.h"
+
+// Table of f(x, y) = x + 2y on a resolution^2 grid: bilinear interpolation reproduces it exactly
+std::vector<float> linearTable(int resolution) {
+    const int nodes_per_row = resolution + 1;
+    const double step = (LUT_MAX - LUT_MIN) / resolution;
+    std::vector<float> lut(nodes_per_row * nodes_per_row);
+    for (int iy = 0; iy < nodes_per_row; ++iy) {
+        for (int ix = 0; ix < nodes_per_row; ++ix) {
+            lut[iy * nodes_per_row + ix] = static_cast<float>((LUT_MIN + ix * step) + 2.0 * (LUT_MIN + iy * step));
+        }
+    }
+    return lut;
+}
+
+TEST(DecisionLUT, InterpolatesInside) {
+    const std::vector<float> lut = linearTable(8);
+    EXPECT_NEAR(interpolateDecisionLUT(lut.data(), 8, 0.3, -0.45), 0.3 - 0.9, 1e-6);
+    EXPECT_NEAR(interpolateDecisionLUT(lut.data(), 8, -1.0, -1.0), -3.0, 1e-6);
+    EXPECT_NEAR(interpolateDecisionLUT(lut.data(), 8, 1.0, 1.0), 3.0, 1e-6);
+}
+
+TEST(DecisionLUT, ClampsOutside) {
+    const std::vector<float> lut = linearTable(8);
+    EXPECT_NEAR(interpolateDecisionLUT(lut.data(), 8, 5.0, -7.0), 1.0 - 2.0, 1e-6);
+}
+
+TEST(DecisionLUT, NonFiniteNormalIsOnTheBoundary) {
+    const std::vector<float> lut = linearTable(8);
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const double inf = std::numeric_limits<double>::infinity();
+    EXPECT_EQ(interpolateDecisionLUT(lut.data(), 8, nan, 0.5), 0.0);
+    EXPECT_EQ(interpolateDecisionLUT(lut.data(), 8, 0.5, nan), 0.0);
+    EXPECT_EQ(interpolateDecisionLUT(lut.data(), 8, nan, nan), 0.0);
+    EXPECT_EQ(interpolateDecisionLUT(lut.data(), 8, inf, -inf), 0.0);
+}
+
+int main(int argc, char** argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <set>
+#include <tuple>
+#include <vector>
+
+#include "range_voxel_grid.h"
+
+typedef pcl::PointCloud<pcl::PointXYZ> Cloud;
+typedef std::tuple<int64_t, int64_t, int64_t> Cell;
+
+// Uniform points over stat_mod's x limits [0, 2.3], dense enough that every voxel next to a seam is occupied
+Cloud randomCloud(int size, float max_distance) {
+    std::mt19937 generator(11);
+    std::uniform_real_distribution<float> distance(0.0f, max_distance);
+    std::uniform_real_distribution<float> lateral(-0.3f, 0.3f);
+    Cloud cloud;
+    for (int i = 0; i < size; ++i) {
+        cloud.points.emplace_back(distance(generator), lateral(generator), lateral(generator));
+    }
+    cloud.width = static_cast<uint32_t>(cloud.points.size());
+    cloud.height = 1;
+    return cloud;
+}
+
+int bandOf(float distance, const float* starts, int num_bands) {
+    int band = 0;
+    while (band + 1 < num_bands && distance >= starts[band + 1]) {
+        band++;
+    }
+    return band;
+}
+
+// Otherwise the near band's last voxel is cut into a sliver at the seam
+TEST(RangeVoxelGrid, SeamsAreWholeLeavesOfTheNearBand) {
+    RangeVoxelConfig config;
+    float starts[MAX_RANGE_BANDS + 1];
+    rangeBandStarts(config, starts);
+    for (int band = 0; band + 1 < rangeBandCount(config); ++band) {
+        const double leaves = (starts[band + 1] - starts[band]) / rangeBandLeaf(config, band);
+        EXPECT_NEAR(leaves, std::round(leaves), 1e-4) << "band " << band;
+        EXPECT_GT(starts[band + 1], starts[band]);
+    }
+    EXPECT_FLOAT_EQ(starts[rangeBandCount(config)], config.max_distance);
+}
+
+// A cell of the coarser band's grid (anchored at the seam along x, at the sensor across) must not get a centroid
+// from both sides of the seam
+TEST(RangeVoxelGrid, AdjacentBandsShareNoCoarseCell) {
+    RangeVoxelConfig config;
+    const int num_bands = rangeBandCount(config);
+    float starts[MAX_RANGE_BANDS + 1];
+    rangeBandStarts(config, starts);
+
+    const Cloud input = randomCloud(200000, config.max_distance);
+    RangeVoxelWorkspace workspace;
+    Cloud output;
+    rangeAdaptiveVoxelDownsample(input, config, workspace, output);
+    ASSERT_GT(output.points.size(), 0u);
+
+    for (int band = 0; band + 1 < num_bands; ++band) {
+        const float coarse_leaf = rangeBandLeaf(config, band + 1);
+        std::set<Cell> near_cells, far_cells;
+        for (const pcl::PointXYZ& point : output.points) {
+            const int point_band = bandOf(point.x, starts, num_bands);
+            if (point_band != band && point_band != band + 1) {
+                continue;
+            }
+            const Cell cell(static_cast<int64_t>(std::floor((point.x - starts[band + 1]) / coarse_leaf)),
+                            static_cast<int64_t>(std::floor(point.y / coarse_leaf)),
+                            static_cast<int64_t>(std::floor(point.z / coarse_leaf)));
+            (point_band == band ? near_cells : far_cells).insert(cell);
+        }
+        for (const Cell& cell : near_cells) {
+            EXPECT_EQ(far_cells.count(cell), 0u) << "seam " << starts[band + 1] << " m";
+        }
+    }
+}
+
+// Every point inside the limits lands in exactly one band and every voxel gives exactly one output point
+TEST(RangeVoxelGrid, VoxelCountMatchesBandVoxels) {
+    RangeVoxelConfig config;
+    float starts[MAX_RANGE_BANDS + 1];
+    rangeBandStarts(config, starts);
+
+    const Cloud input = randomCloud(50000, 2.5f);
+    RangeVoxelWorkspace workspace;
+    Cloud output;
+    rangeAdaptiveVoxelDownsample(input, config, workspace, output);
+
+    int band_points = 0, band_voxels = 0;
+    for (int band = 0; band < workspace.num_bands; ++band) {
+        band_points += workspace.band_points[band];
+        band_voxels += workspace.band_voxels[band];
+    }
+    int inside = 0;
+    for (const pcl::PointXYZ& point : input.points) {
+        inside += (point.x >= config.min_distance && point.x <= config.max_distance) ? 1 : 0;
+    }
+    EXPECT_EQ(band_points, inside);
+    EXPECT_EQ(band_voxels, static_cast<int>(output.points.size()));
+    for (const pcl::PointXYZ& point : output.points) {
+        EXPECT_GE(point.x, config.min_distance);
+        EXPECT_LE(point.x, config.max_distance);
+    }
+}
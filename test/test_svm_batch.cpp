@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+
+#include <svm.h>
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "svm_batch.h"
+
+// Two-class RBF model over (normal_x, normal_y) with the shipped gamma and |coef| up to C = 100, built in memory
+class SVMBatchTest : public ::testing::Test {
+protected:
+    static const int NUM_SV = 1003; // Not a multiple of SVM_BATCH_PADDING, so the padding is exercised
+
+    void SetUp() override {
+        std::mt19937 generator(3);
+        std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+        nodes.resize(3 * NUM_SV);
+        sv_pointers.resize(NUM_SV);
+        coef.resize(NUM_SV);
+        for (int i = 0; i < NUM_SV; ++i) {
+            nodes[3 * i] = {1, uniform(generator)};
+            nodes[3 * i + 1] = {2, uniform(generator)};
+            nodes[3 * i + 2] = {-1, 0.0};
+            sv_pointers[i] = &nodes[3 * i];
+            coef[i] = (i < NUM_SV / 2 ? 100.0 : -100.0) * std::fabs(uniform(generator));
+        }
+        coef_pointer = coef.data();
+        n_sv[0] = NUM_SV / 2;
+        n_sv[1] = NUM_SV - NUM_SV / 2;
+
+        model = svm_model();
+        model.param.svm_type = C_SVC;
+        model.param.kernel_type = RBF;
+        model.param.gamma = 0.1;
+        model.nr_class = 2;
+        model.l = NUM_SV;
+        model.SV = sv_pointers.data();
+        model.sv_coef = &coef_pointer;
+        model.rho = &rho;
+        model.label = label;
+        model.nSV = n_sv;
+
+        // Regular features, the corners of the feature square and the non-finite normals the node can see
+        for (int i = 0; i < 200; ++i) {
+            normal_x.push_back(static_cast<float>(uniform(generator)));
+            normal_y.push_back(static_cast<float>(uniform(generator)));
+        }
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        const float inf = std::numeric_limits<float>::infinity();
+        const float special_x[] = {1.0f, -1.0f, nan, 0.3f, nan, inf, -inf, 0.2f, inf};
+        const float special_y[] = {1.0f, -1.0f, 0.1f, nan, nan, 0.4f, 0.5f, -inf, nan};
+        for (int i = 0; i < 9; ++i) {
+            normal_x.push_back(special_x[i]);
+            normal_y.push_back(special_y[i]);
+        }
+    }
+
+    void expectMatchesLibsvm(SVMBatchISA isa) {
+        SVMBatchModel batch;
+        ASSERT_TRUE(buildSVMBatchModel(&model, batch));
+        const int count = static_cast<int>(normal_x.size());
+        std::vector<double> decision_values(count), labels(count);
+        predictBatch(batch, normal_x.data(), normal_y.data(), count, 1, decision_values.data(), labels.data(), isa);
+
+        for (int i = 0; i < count; ++i) {
+            svm_node features[3] = {{1, normal_x[i]}, {2, normal_y[i]}, {-1, 0.0}};
+            double expected = 0.0;
+            const double expected_label = svm_predict_values(&model, features, &expected);
+            EXPECT_EQ(labels[i], expected_label) << svmBatchISAName(isa) << " at (" << normal_x[i] << ", " << normal_y[i] << ")";
+            EXPECT_EQ(labels[i], svm_predict(&model, features));
+            if (std::isnan(expected)) {
+                EXPECT_TRUE(std::isnan(decision_values[i])) << svmBatchISAName(isa) << " at (" << normal_x[i] << ", " << normal_y[i] << ")";
+            } else {
+                EXPECT_NEAR(decision_values[i], expected, 1e-9) << svmBatchISAName(isa) << " at (" << normal_x[i] << ", " << normal_y[i] << ")";
+            }
+        }
+    }
+
+    std::vector<svm_node> nodes;
+    std::vector<svm_node*> sv_pointers;
+    std::vector<double> coef;
+    double* coef_pointer = nullptr;
+    double rho = 0.37;
+    int label[2] = {1, 0};
+    int n_sv[2] = {0, 0};
+    svm_model model;
+    std::vector<float> normal_x, normal_y;
+};
+
+TEST_F(SVMBatchTest, ScalarMatchesLibsvm) {
+    expectMatchesLibsvm(SVMBatchISA::Scalar);
+}
+
+TEST_F(SVMBatchTest, AVX2MatchesLibsvm) {
+    if (detectSVMBatchISA() == SVMBatchISA::Scalar) {
+        GTEST_SKIP() << "CPU without AVX2 + FMA";
+    }
+    expectMatchesLibsvm(SVMBatchISA::AVX2);
+}
+
+TEST_F(SVMBatchTest, AVX512MatchesLibsvm) {
+    if (detectSVMBatchISA() != SVMBatchISA::AVX512) {
+        GTEST_SKIP() << "CPU without AVX-512";
+    }
+    expectMatchesLibsvm(SVMBatchISA::AVX512);
+}
@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+
+#include <pcl/pcl_base.h>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/search/kdtree.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "voxel_hash_search.h"
+
+typedef pcl::PointCloud<pcl::PointXYZ> Cloud;
+
+const float CELL_SIZE = 0.05f;
+
+// Uniform points in a 1 m cube plus a dense cluster, so that some cells are crowded and most nearly empty
+Cloud::Ptr randomCloud(int size) {
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<float> uniform(-0.5f, 0.5f);
+    std::normal_distribution<float> cluster(0.0f, 0.02f);
+    Cloud::Ptr cloud(new Cloud);
+    for (int i = 0; i < size; ++i) {
+        if (i % 4 == 0) {
+            cloud->points.emplace_back(0.2f + cluster(generator), -0.1f + cluster(generator), cluster(generator));
+        } else {
+            cloud->points.emplace_back(uniform(generator), uniform(generator), uniform(generator));
+        }
+    }
+    cloud->width = static_cast<uint32_t>(cloud->points.size());
+    cloud->height = 1;
+    return cloud;
+}
+
+// Same squared distances, nearest first, and the same points up to ties
+void expectSameKnn(pcl::search::Search<pcl::PointXYZ>& reference, pcl::search::Search<pcl::PointXYZ>& search, const Cloud& queries, int k) {
+    std::vector<int> reference_indices, indices;
+    std::vector<float> reference_distances, distances;
+    for (const pcl::PointXYZ& query : queries.points) {
+        const int reference_found = reference.nearestKSearch(query, k, reference_indices, reference_distances);
+        const int found = search.nearestKSearch(query, k, indices, distances);
+        ASSERT_EQ(found, reference_found);
+        for (int i = 0; i < found; ++i) {
+            EXPECT_NEAR(distances[i], reference_distances[i], 1e-6f);
+        }
+        // Away from the k-th distance, where ties may pick different points, the sets must agree
+        for (int i = 0; i < found; ++i) {
+            if (reference_distances[i] < reference_distances[found - 1] - 1e-6f) {
+                EXPECT_NE(std::find(indices.begin(), indices.end(), reference_indices[i]), indices.end());
+            }
+        }
+    }
+}
+
+void expectSameRadius(pcl::search::Search<pcl::PointXYZ>& reference, pcl::search::Search<pcl::PointXYZ>& search, const Cloud& queries, double radius) {
+    std::vector<int> reference_indices, indices;
+    std::vector<float> reference_distances, distances;
+    for (const pcl::PointXYZ& query : queries.points) {
+        reference.radiusSearch(query, radius, reference_indices, reference_distances);
+        search.radiusSearch(query, radius, indices, distances);
+        std::sort(reference_indices.begin(), reference_indices.end());
+        std::sort(indices.begin(), indices.end());
+        EXPECT_EQ(indices, reference_indices);
+    }
+}
+
+TEST(VoxelHashSearch, KnnWithinOneShell) {
+    Cloud::Ptr cloud = randomCloud(2000);
+    pcl::search::KdTree<pcl::PointXYZ> kdtree;
+    VoxelHashSearch<pcl::PointXYZ> voxel_hash(CELL_SIZE);
+    kdtree.setInputCloud(cloud);
+    voxel_hash.setInputCloud(cloud);
+    expectSameKnn(kdtree, voxel_hash, *cloud, 5);
+}
+
+TEST(VoxelHashSearch, KnnBeyondOneShell) {
+    // 2000 points in a 1 m cube are ~0.1 per 5 cm cell: 150 neighbours need many shells
+    Cloud::Ptr cloud = randomCloud(2000);
+    pcl::search::KdTree<pcl::PointXYZ> kdtree;
+    VoxelHashSearch<pcl::PointXYZ> voxel_hash(CELL_SIZE);
+    kdtree.setInputCloud(cloud);
+    voxel_hash.setInputCloud(cloud);
+    expectSameKnn(kdtree, voxel_hash, *cloud, 150);
+
+    // Queries off the cloud, outside its bounding box
+    Cloud outside;
+    outside.points.emplace_back(2.0f, 0.0f, 0.0f);
+    outside.points.emplace_back(-1.0f, -1.0f, 1.0f);
+    expectSameKnn(kdtree, voxel_hash, outside, 20);
+}
+
+TEST(VoxelHashSearch, KnnMoreThanTheCloud) {
+    Cloud::Ptr cloud = randomCloud(50);
+    pcl::search::KdTree<pcl::PointXYZ> kdtree;
+    VoxelHashSearch<pcl::PointXYZ> voxel_hash(CELL_SIZE);
+    kdtree.setInputCloud(cloud);
+    voxel_hash.setInputCloud(cloud);
+
+    std::vector<int> indices;
+    std::vector<float> distances;
+    EXPECT_EQ(voxel_hash.nearestKSearch(cloud->points[0], 80, indices, distances), 50);
+    expectSameKnn(kdtree, voxel_hash, *cloud, 80);
+}
+
+TEST(VoxelHashSearch, RadiusLargerThanTheCell) {
+    Cloud::Ptr cloud = randomCloud(2000);
+    pcl::search::KdTree<pcl::PointXYZ> kdtree;
+    VoxelHashSearch<pcl::PointXYZ> voxel_hash(CELL_SIZE);
+    kdtree.setInputCloud(cloud);
+    voxel_hash.setInputCloud(cloud);
+    expectSameRadius(kdtree, voxel_hash, *cloud, 0.5 * CELL_SIZE);
+    expectSameRadius(kdtree, voxel_hash, *cloud, 3.3 * CELL_SIZE);
+}
+
+TEST(VoxelHashSearch, IndexSubset) {
+    // Results are indices into the whole cloud, and only points of the subset are returned
+    Cloud::Ptr cloud = randomCloud(1000);
+    pcl::IndicesPtr subset(new std::vector<int>);
+    for (int i = 0; i < 1000; i += 3) {
+        subset->push_back(i);
+    }
+    pcl::search::KdTree<pcl::PointXYZ> kdtree;
+    VoxelHashSearch<pcl::PointXYZ> voxel_hash(CELL_SIZE);
+    kdtree.setInputCloud(cloud, subset);
+    voxel_hash.setInputCloud(cloud, subset);
+    expectSameKnn(kdtree, voxel_hash, *cloud, 30);
+    expectSameRadius(kdtree, voxel_hash, *cloud, 2.0 * CELL_SIZE);
+
+    std::vector<int> indices;
+    std::vector<float> distances;
+    voxel_hash.nearestKSearch(cloud->points[1], 30, indices, distances);
+    for (int index : indices) {
+        EXPECT_EQ(index % 3, 0);
+    }
+}
+
+int main(int argc, char** argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
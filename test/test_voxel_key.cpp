@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+#include "voxel_key.h"
+
+TEST(VoxelKey, DistinctCellsGetDistinctKeys) {
+    uint64_t a, b, c;
+    ASSERT_TRUE(packVoxelKey(1, 0, 0, a));
+    ASSERT_TRUE(packVoxelKey(0, 1, 0, b));
+    ASSERT_TRUE(packVoxelKey(0, 0, 1, c));
+    EXPECT_NE(a, b);
+    EXPECT_NE(b, c);
+    EXPECT_NE(a, c);
+}
+
+// The edge cells of the range pack; one cell further would wrap into another cell's key and is refused
+TEST(VoxelKey, RefusesCoordinatesOutsideTheRange) {
+    uint64_t key = 0;
+    EXPECT_TRUE(packVoxelKey(-VOXEL_KEY_LIMIT, VOXEL_KEY_LIMIT - 1, 0, key));
+    EXPECT_NE(key, EMPTY_VOXEL_KEY);
+
+    key = 42;
+    EXPECT_FALSE(packVoxelKey(VOXEL_KEY_LIMIT, 0, 0, key));
+    EXPECT_FALSE(packVoxelKey(0, -VOXEL_KEY_LIMIT - 1, 0, key));
+    EXPECT_FALSE(packVoxelKey(0, 0, int64_t(1) << 40, key));
+    EXPECT_EQ(key, 42u);
+
+    EXPECT_TRUE(voxelKeyInRange(VOXEL_KEY_LIMIT - 2, 0, 0, 1));
+    EXPECT_FALSE(voxelKeyInRange(VOXEL_KEY_LIMIT - 1, 0, 0, 1));
+}
+
+TEST(VoxelKey, OffsetMatchesPackingTheNeighbour) {
+    const int64_t x = -17, y = 5, z = VOXEL_KEY_LIMIT - 2;
+    uint64_t key;
+    ASSERT_TRUE(voxelKeyInRange(x, y, z, 1));
+    ASSERT_TRUE(packVoxelKey(x, y, z, key));
+    for (int dx = -1; dx <= 1; ++dx) {
+        for (int dy = -1; dy <= 1; ++dy) {
+            for (int dz = -1; dz <= 1; ++dz) {
+                uint64_t neighbour;
+                ASSERT_TRUE(packVoxelKey(x + dx, y + dy, z + dz, neighbour));
+                EXPECT_EQ(offsetVoxelKey(key, dx, dy, dz), neighbour);
+            }
+        }
+    }
+}